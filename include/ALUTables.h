@@ -0,0 +1,118 @@
+#pragma once
+#include "Binary.h"
+#include "CPU.h"
+
+namespace Processor {
+    // Entries hold the result in the high byte and F in the low byte, the layout of AF, so one load
+    // gives both.
+#define ALU_ENTRY_RESULT(entry) ((Byte)((entry) >> 8))
+#define ALU_ENTRY_FLAGS(entry) ((Byte)(entry))
+
+    // ADD/ADC and SUB/SBC/CP tables are indexed by carry in, A and the operand.
+#define ALU_BINARY_SIZE 0x20000
+#define ALU_BINARY_INDEX(a, b, carry) (((unsigned int)(carry) << 16) | ((unsigned int)(a) << 8) | (b))
+
+    // INC/DEC tables are indexed by the operand.
+#define ALU_UNARY_SIZE 0x100
+
+    // DAA is indexed by A and the N, H and C flags.
+#define ALU_DAA_SIZE 0x800
+#define ALU_DAA_INDEX(a, f) ((((unsigned int)(f) & (n | h | cy)) << 4) | (a))
+
+    enum ALU_TABLE_OP {
+        ALU_ADD, // a + b + carry
+        ALU_SUB, // a - b - carry
+        ALU_INC, // Operand + 1, the caller keeps the carry
+        ALU_DEC, // Operand - 1, the caller keeps the carry
+        ALU_DAA, // BCD adjust of A after an add or subtract
+    };
+
+    // Entry i of the table for op.
+    constexpr Word ALUEntry(ALU_TABLE_OP op, unsigned int i) {
+        int a = (i >> 8) & 0xFF;
+        int b = i & 0xFF;
+        int carry = i >> 16;
+        int result = 0;
+        int f = 0;
+
+        switch (op) {
+        case ALU_ADD:
+        result = a + b + carry;
+        f = (((a ^ b ^ result) & 0x10) << 1) | ((result >> 4) & cy);
+        break;
+        case ALU_SUB:
+        result = a - b - carry;
+        f = n | (((a ^ b ^ result) & 0x10) << 1) | ((result >> 4) & cy);
+        break;
+        case ALU_INC:
+        result = b + 1;
+        f = ((b & 0x0F) == 0x0F) ? h : 0;
+        break;
+        case ALU_DEC:
+        result = b - 1;
+        f = n | (((b & 0x0F) == 0x00) ? h : 0);
+        break;
+        case ALU_DAA: {
+            // Index bits 8-10 are C, H and N
+            bool sub = (i & 0x400) != 0;
+            bool half = (i & 0x200) != 0;
+            bool carried = (i & 0x100) != 0;
+
+            result = b;
+            f = sub ? n : 0;
+            if (sub) {
+                if (carried) {
+                    result -= 0x60;
+                }
+                if (half) {
+                    result -= 0x06;
+                }
+            }
+            else {
+                if (carried || result > 0x99) {
+                    result += 0x60;
+                    carried = true;
+                }
+                if (half || (result & 0x0F) > 0x09) {
+                    result += 0x06;
+                }
+            }
+            if (carried) {
+                f |= cy;
+            }
+            break;
+        }
+        }
+
+        if ((result & 0xFF) == 0) {
+            f |= zf;
+        }
+
+        return (Word)(((result & 0xFF) << 8) | f);
+    }
+
+    template <unsigned int N> struct ALUTable {
+        Word entry[N];
+
+        // Fill the table at compile time.
+        constexpr ALUTable(ALU_TABLE_OP op) : entry() {
+            for (unsigned int i = 0; i < N; ++i) {
+                this->entry[i] = ALUEntry(op, i);
+            }
+        }
+    };
+
+    // ADD and SUB have 0x20000 entries each, more constexpr evaluation than compilers allow by
+    // default, so they are filled from ALUEntry at static init instead.
+    struct ALUBinaryTable {
+        Word entry[ALU_BINARY_SIZE];
+
+        explicit ALUBinaryTable(ALU_TABLE_OP op);
+    };
+
+    extern const ALUBinaryTable addTable;
+    extern const ALUBinaryTable subTable;
+    extern const ALUTable<ALU_UNARY_SIZE> incTable;
+    extern const ALUTable<ALU_UNARY_SIZE> decTable;
+    extern const ALUTable<ALU_DAA_SIZE> daaTable;
+}
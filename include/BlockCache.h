@@ -0,0 +1,115 @@
+#pragma once
+#include "Binary.h"
+#include "Memory.h"
+
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+
+namespace Processor {
+    class Z80;
+
+    // Most ops decoded into one block.
+#define BLOCK_MAX_OPS 32
+
+    // Upper bound on the T-cycles a single op takes, used to bound a whole block.
+#define BLOCK_MAX_OP_CYCLES 24
+
+    // One pre-decoded instruction.
+    struct DecodedOp {
+        void (*handler)(Z80* cpu); // Handler, resolved through the CB table for CB xx
+        Word imm; // Immediate operand, zero extended for 8-bit ones
+        Byte prefix; // Opcode bytes in front of the immediate (1, or 2 for CB xx)
+        Byte op; // Opcode, the byte after the prefix for CB xx
+        Byte length; // Bytes including prefix and immediate
+    };
+
+    // Idle loop analysis of a block, see FEIGN_IDLE_LOOPS.
+    enum IDLE_LOOP_BITS {
+        IDLE_LOOP = BIT0, // Branches back to its own start, changes nothing but A-E and F, reads no timer registers
+        IDLE_LOOP_READS_HL = BIT1, // Reads (HL), so HL must not point at a timer register either
+    };
+
+    // Straight-line run of instructions. Ends at a branch, HALT/STOP, the end of a page or BLOCK_MAX_OPS.
+    struct Block {
+        Word pc; // Guest address of the first op
+        unsigned int cycles; // Upper bound on the T-cycles the whole block takes
+        std::vector<DecodedOp> ops;
+        unsigned int hits; // Times run with the whole block in budget, see FEIGN_JIT
+        void* native; // Compiled code, nullptr until the block is hot
+        Byte idle; // IDLE_LOOP_BITS
+    };
+
+    // Decoded blocks keyed by the host memory they were decoded from, so ROM code is naturally keyed
+    // by PC and bank. Blocks in RAM pages are dropped when the MMU reports a write to the page.
+    class BlockCache {
+    public:
+        BlockCache();
+        ~BlockCache();
+
+        // Set the MMU code is decoded from.
+        void SetMMU(Memory::MMU* r);
+
+        // Find or decode the block at pc. Code that can't be cached is decoded one op at a time into
+        // a scratch block that is only valid until the next call.
+        Block* Lookup(Word pc) {
+            Byte index = pc >> PAGE_SHIFT;
+            const Byte* host = this->ram->GetCodeHost(pc);
+
+            if (host != nullptr && this->hostCache[index] == host) {
+                Block* found = this->pageCache[index]->entry[pc & PAGE_MASK];
+                if (found != nullptr) {
+                    return found;
+                }
+            }
+
+            return Miss(pc, host);
+        }
+
+        // Drop every block decoded from the host page. Blocks are only freed by Collect.
+        void Invalidate(const Byte* host);
+
+        // Forget the compiled code of every block, e.g. when the code buffer is recycled.
+        void DropNative();
+
+        // Free dropped blocks. Must not be called while a block is executing.
+        void Collect() {
+            if (!this->retired.empty()) {
+                FreeRetired();
+            }
+        }
+
+    private:
+        struct CodePage {
+            CodePage() {
+                memset(this->entry, 0, sizeof(this->entry));
+            }
+
+            Block* entry[PAGE_SIZE]; // Block starting at each offset in the page
+            std::vector<Block*> blocks;
+        };
+
+        // Lookup for a block that isn't in the page cache yet.
+        Block* Miss(Word pc, const Byte* host);
+
+        void FreeRetired();
+
+        // Decode up to BLOCK_MAX_OPS ops starting at pc, stopping before end. Returns false if not even
+        // the first op fits.
+        bool Decode(Word pc, unsigned int end, unsigned int maxOps, Block& block) const;
+
+        CodePage* GetPage(const Byte* host);
+
+        Memory::MMU* ram;
+
+        std::unordered_map<const Byte*, CodePage*> pages;
+
+        // Last host page seen at each guest page, saves the map lookup while banks stay put
+        const Byte* hostCache[PAGE_COUNT];
+        CodePage* pageCache[PAGE_COUNT];
+
+        std::vector<Block*> retired;
+
+        Block scratch;
+    };
+}
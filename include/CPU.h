@@ -1,5 +1,10 @@
 #pragma once
 #include "Binary.h"
+#include "Config.h"
+#include "Scheduler.h"
+#include "BlockCache.h"
+#include "JIT.h"
+#include "Profiler.h"
 
 #include "../include/Memory.h"
 
@@ -23,6 +28,51 @@ namespace Processor {
 		};
 	};
 
+	// 8-bit register indices in opcode encoding order, 6 is (HL) and has its own handlers.
+	enum REGISTER8 {
+		REG_B = 0,
+		REG_C = 1,
+		REG_D = 2,
+		REG_E = 3,
+		REG_H = 4,
+		REG_L = 5,
+		REG_A = 7,
+	};
+
+	// 16-bit register pair indices.
+	enum REGISTER16 {
+		REG_BC,
+		REG_DE,
+		REG_HL,
+		REG_SP,
+		REG_AF,
+	};
+
+	// Kind of ALU op whose flags are still deferred.
+	enum LAZY_FLAGS_OP {
+		LAZY_NONE, // F is up to date
+		LAZY_ADD, // ADD/ADC
+		LAZY_SUB, // SUB/SBC/CP
+		LAZY_AND, // AND, operand a holds the result
+		LAZY_LOGIC, // XOR/OR, operand a holds the result
+		LAZY_INC, // INC, carry holds the preserved carry flag
+		LAZY_DEC, // DEC, carry holds the preserved carry flag
+	};
+
+	// Operands of the last flag-setting ALU op, F is computed from these on demand.
+	struct LazyFlags {
+		Byte op; // LAZY_FLAGS_OP
+		Byte a; // Left operand (A before the op)
+		Byte b; // Right operand
+		Byte carry; // Carry in (0 or 1)
+	};
+
+	// Work skipped by idle loop detection, see FEIGN_IDLE_LOOPS.
+	struct IdleLoopStats {
+		unsigned long long loops; // Times a loop was fast-forwarded
+		Timing::Cycles skipped; // T-cycles skipped
+	};
+
 	enum INTERRUPTS {
 		VBLANK = BIT0,
 		LCDC_STATUS = BIT1,
@@ -33,7 +83,7 @@ namespace Processor {
 
 	class Z80 {
 	public:
-		//typedef void (Z80::*OP_FUNC)(void); // Function pointer
+		typedef void (*OP_FUNC)(Z80* cpu); // Opcode handler
 
 		Z80();
 		~Z80();
@@ -50,8 +100,53 @@ namespace Processor {
 		// Get the last OP's T count
 		int GetT();
 
-        int GetTotalT();
+		// Get the T-cycles executed since power on
+		Timing::Cycles GetTotalT() const;
+
+		// Events run on this CPU's clock
+		Timing::Scheduler& GetScheduler();
+
+		// Set bits of IF
+		void RequestInterrupt(Byte mask);
+
+		// Have DoInterrupts look at IE/IF/IME before the next instruction
+		void CheckInterrupts();
+
+		// Recompute the pending mask after IE or IF changed, checking interrupts only if one can fire
+		void UpdateInterrupts();
+
+		// Run as a CGB: A starts out as 11h and KEY1 arms STOP to switch speed.
+		void SetCGB(bool enable);
+
+		// KEY1 (FF4D), bit 7 is the current speed and bit 0 arms a switch.
+		Byte ReadKEY1() const;
+		void WriteKEY1(Byte val);
+
+		// Let cycles T-cycles pass without running anything, e.g. while a DMA has the bus.
+		void Stall(int cycles);
+
+		bool IsHalted() const;
+
+		// Drop cached code decoded from the host page and stop replaying the current block
+		void InvalidateCode(const Byte* host);
+
+		// Stop replaying the current block after this op, e.g. because the ROM bank changed
+		void EndBlock();
+
+		// Get AF with F brought up to date, e.g. for save states
+		Word GetAF();
+
+		// Turn idle loop skipping on or off, e.g. off for accuracy runs
+		void SetIdleLoopSkip(bool enable);
+
+		const IdleLoopStats& GetIdleLoopStats() const;
+
+		void ResetIdleLoopStats();
 		
+		// Execute ops until at least cycles T-cycles have elapsed or the next scheduled event is due.
+		// A halted/stopped CPU idles instead. Returns the T-cycles executed.
+		int Run(int cycles);
+
 		// Get the next OP at PC, increment PC, and execute the OP.
 		bool DoNextOp();
         void DoInterrupts();
@@ -62,28 +157,28 @@ namespace Processor {
         /* CB Opcodes start                                                    */
         /************************************************************************/
 
-        void RLC(Byte* target_register);
+        template <REGISTER8 R> void RLC();
         void RLC_HL();
-        void RRC(Byte* target_register);
+        template <REGISTER8 R> void RRC();
         void RRC_HL();
-        void RL(Byte* target_register);
+        template <REGISTER8 R> void RL();
         void RL_HL();
-        void RR(Byte* target_register);
+        template <REGISTER8 R> void RR();
         void RR_HL();
-        void SLA(Byte* target_register);
+        template <REGISTER8 R> void SLA();
         void SLA_HL();
-        void SRA(Byte* target_register);
+        template <REGISTER8 R> void SRA();
         void SRA_HL();
-        void SWAP(Byte* target_register);
+        template <REGISTER8 R> void SWAP();
         void SWAP_HL();
-        void SRL(Byte* target_register);
+        template <REGISTER8 R> void SRL();
         void SRL_HL();
-        void BITTEST(Byte* target_register, unsigned int bit_index);
-        void BITTEST_HL(unsigned int bit_index);
-        void CLEARBIT(Byte* target_register, unsigned int bit_index);
-        void CLEARBIT_HL(unsigned int bit_index);
-        void SETBIT(Byte* target_register, unsigned int bit_index);
-        void SETBIT_HL(unsigned int bit_index);
+        template <unsigned int B, REGISTER8 R> void BITTEST();
+        template <unsigned int B> void BITTEST_HL();
+        template <unsigned int B, REGISTER8 R> void CLEARBIT();
+        template <unsigned int B> void CLEARBIT_HL();
+        template <unsigned int B, REGISTER8 R> void SETBIT();
+        template <unsigned int B> void SETBIT_HL();
 
         /************************************************************************/
         /* CB Opcodes end                                                    */
@@ -123,16 +218,16 @@ namespace Processor {
 		/************************************************************************/
 
 		// Copy a byte from a register into another registers (LD r, r)
-		 void LD_R_R(Byte* dest_register, Byte* src_register);
+		 template <REGISTER8 D, REGISTER8 S> void LD_R_R();
 
 		// Copy a byte from an immediate value into a register (LD r, n)
-		 void LD_R_N(Byte* dest_register);
+		 template <REGISTER8 D> void LD_R_N();
 
 		// Copy a byte from a memory address in HL into a register (LD r, (HL))
-		 void LD_R_HLm(Byte* dest_register);
+		 template <REGISTER8 D> void LD_R_HLm();
 
 		// Copy a byte from a register into a memory address in HL (LD (HL), r)
-		 void LD_HLm_R(Byte* src_register);
+		 template <REGISTER8 S> void LD_HLm_R();
 
 		// Copy a byte from an immediate value into a memory address in HL (LD (HL), n)
 		 void LD_HLm_N();
@@ -188,7 +283,7 @@ namespace Processor {
 		/************************************************************************/
 
 		// Read a word from an immediate value into a register (LD rr, nn) (rr may be BC,DE,HL or SP)
-		 void LD_RR_NN(Register* dest_register);
+		 template <REGISTER16 D> void LD_RR_NN();
 
 		// Write HL into SP (LD SP, HL)
 		 void LD_SP_HL();
@@ -197,10 +292,10 @@ namespace Processor {
 		 void LD_NNm_SP();
 
 		// Decrement the SP by 2 and push a register onto the stack (push rr) (rr may be BC,DE,HL,AF)
-		 void PUSH_RR(Register* src_register);
+		 template <REGISTER16 S> void PUSH_RR();
 
 		// Pop a register from the stack and increment the SP by 2 (pop rr) (rr may be BC,DE,HL,AF)
-		 void POP_RR(Register* dest_register);
+		 template <REGISTER16 D> void POP_RR();
 
 		/************************************************************************/
 		/* 16-bit Load end                                                      */
@@ -211,7 +306,7 @@ namespace Processor {
 		/************************************************************************/
 
 		// Add a register to A and store it in A (ADD A, r)
-		 void ADD_A_R(Byte* src_register);
+		 template <REGISTER8 S> void ADD_A_R();
 
 		// Add an immediate value to A and store it in A (ADD A, n)
 		 void ADD_A_N();
@@ -220,7 +315,7 @@ namespace Processor {
 		 void ADD_A_HLm();
 
 		// Add a register and the carry flag to A and store it in A (ADC A, r)
-		 void ADC_A_R(Byte* src_register);
+		 template <REGISTER8 S> void ADC_A_R();
 
 		// Add an immediate value and the carry flag to A and store it in A (ADC A, n)
 		 void ADC_A_N();
@@ -229,7 +324,7 @@ namespace Processor {
 		 void ADC_A_HLm();
 
 		// Subtract a register from A and store it in A (SUB r)
-		 void SUB_A_R(Byte* src_register);
+		 template <REGISTER8 S> void SUB_A_R();
 
 		// Subtract an immediate value from A and store it in A (SUB n)
 		 void SUB_A_N();
@@ -238,7 +333,7 @@ namespace Processor {
 		 void SUB_A_HLm();
 
 		// Subtract a register and the carry flag from A and store it in A (SBC A, r)
-		 void SBC_A_R(Byte* src_register);
+		 template <REGISTER8 S> void SBC_A_R();
 
 		// Subtract an immediate value and the carry flag from A and store it in A (SBC A, n)
 		 void SBC_A_N();
@@ -247,7 +342,7 @@ namespace Processor {
 		 void SBC_A_HLm();
 
 		// Binary AND a register and A (AND r)
-		 void AND_A_R(Byte* src_register);
+		 template <REGISTER8 S> void AND_A_R();
 
 		// Binary AND an immediate value and A (AND n)
 		 void AND_A_N();
@@ -256,7 +351,7 @@ namespace Processor {
 		 void AND_A_HLm();
 
 		// Binary XOR a register and A (XOR r)
-		 void XOR_A_R(Byte* src_register);
+		 template <REGISTER8 S> void XOR_A_R();
 
 		// Binary XOR an immediate value and A (XOR n)
 		 void XOR_A_N();
@@ -265,7 +360,7 @@ namespace Processor {
 		 void XOR_A_HLm();
 
 		// Binary OR a register and A (OR r)
-		 void OR_A_R(Byte* src_register);
+		 template <REGISTER8 S> void OR_A_R();
 
 		// Binary OR an immediate value and A (OR n)
 		 void OR_A_N();
@@ -274,7 +369,7 @@ namespace Processor {
 		 void OR_A_HLm();
 
 		// Binary compare a register and A (CMP r)
-		 void CP_A_R(Byte* src_register);
+		 template <REGISTER8 S> void CP_A_R();
 
 		// Binary compare an immediate value and A (CMP n)
 		 void CP_A_N();
@@ -283,13 +378,13 @@ namespace Processor {
 		 void CP_A_HLm();
 
 		// Increment sd_register and store it in sd_register (INC r)
-		 void INC_R(Byte* sd_register);
+		 template <REGISTER8 R> void INC_R();
 
 		// Increment the value at memory address in HL and store it at memory address in HL (INC r)
 		 void INC_HLm();
 
 		// Decrement sd_register and store it in sd_register (INC r)
-		 void DEC_R(Byte* sd_register);
+		 template <REGISTER8 R> void DEC_R();
 
 		// Decrement the value at memory address in HL and store it at memory address in HL (INC r)
 		 void DEC_HLm();
@@ -309,16 +404,16 @@ namespace Processor {
 		/************************************************************************/
 
 		// Add a register to HL and store it in HL (ADD HL, RR)
-		 void ADD_HL_RR(Register* src_register);
+		 template <REGISTER16 S> void ADD_HL_RR();
 
 		// Add a signed value to SP and store it in SP (ADD SP, dd)
 		 void ADD_SP_dd();
 
 		// Increment a register and store in to the same one (INC RR)
-		 void INC_RR(Register* sd_register);
+		 template <REGISTER16 R> void INC_RR();
 
 		// Decrement a register and store in to the same one (DEC RR)
-		 void DEC_RR(Register* sd_register);
+		 template <REGISTER16 R> void DEC_RR();
 
 		// Store the value of SP plus a signed value into HL (LD HL, SP+dd)
 		 void LD_HL_SPdd();
@@ -354,55 +449,159 @@ namespace Processor {
 		 void JP_HL();
 
 		// Jump PC to memory address in immediate value if flag is set (JP f, nn)
-		 void JP_F_NN(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void JP_F_NN();
 
 		// Jump PC to memory address in immediate value if flag is not set (JP f, nn)
-		 void JP_NOTF_NN(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void JP_NOTF_NN();
 
 		 void JR_PCdd();
 
-		 void JR_F_PCdd(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void JR_F_PCdd();
 
-		 void JR_NOTF_PCdd(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void JR_NOTF_PCdd();
 
 		// Call PC to memory address in immediate value (CALL nn)
 		 void CALL_NN();
 
 		// Call PC to memory address in immediate value if flag is set (CALL f, nn)
-		 void CALL_F_NN(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void CALL_F_NN();
 
 		// Call PC to memory address in immediate value if flag is not set (CALL f, nn)
-		 void CALL_NOTF_NN(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void CALL_NOTF_NN();
 
 		// Return (RET)
 		 void RET();
 
 		// Returns if the flag is set (RET f)
-		 void RET_F(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void RET_F();
 
 		// Returns if the flag is not set (RET f)
-		 void RET_NOTF(FLAGS_REGISTER flag);
+		 template <FLAGS_REGISTER F> void RET_NOTF();
 
 		// Enable all interrupts and return (RETI)
 		 void RETI();
 
 		// Reset and move PC to nextPC (RST n)
-		 void RST_N(Word nextPC);
+		 template <Word N> void RST_N();
 		/************************************************************************/
 		/* Jump and Call end                                                    */
 		/************************************************************************/
 
 	private:
+		// Read F, computing it first if an ALU op deferred it
+		Byte GetF();
+
+		// Overwrite F, dropping any deferred flags
+		void SetF(Byte f);
+
+		// Carry flag as 0 or 1, without materializing the rest of F
+		Byte CarryIn();
+
+		// 8-bit ALU cores shared by the register, immediate and (HL) forms. Results go to A (or target for INC/DEC).
+		void ADD8(Byte value, Byte carry);
+		void SUB8(Byte value, Byte carry, bool store); // store is false for CP
+		void AND8(Byte value);
+		void XOR8(Byte value);
+		void OR8(Byte value);
+		void INC8(Byte& target);
+		void DEC8(Byte& target);
+
+#if FEIGN_LAZY_FLAGS
+		// Record an ALU op so F can be computed later
+		void DeferFlags(Byte op, Byte a, Byte b, Byte carry);
+
+		// Compute F from the deferred op
+		Byte LazyF() const;
+
+		LazyFlags lazy;
+#endif
+#if !FEIGN_LAZY_FLAGS
+		// Store flags computed eagerly
+		void EagerFlags(Byte f);
+#endif
+
+#if FEIGN_BLOCK_CACHE && FEIGN_IDLE_LOOPS
+		// Registers an idle loop iteration must leave unchanged
+		struct IdleSnapshot {
+			Word af, bc, de, hl, sp;
+		};
+
+		void TakeIdleSnapshot(IdleSnapshot& snapshot);
+
+		// block just ran one iteration of iterT/iterM cycles from the state in before. If that changed
+		// nothing, skip the iterations that would run before the budget or the next event. Returns the
+		// T-cycles skipped.
+		int SkipIdleLoop(const Block* block, const IdleSnapshot& before, int executed, int cycles, Timing::Cycles iterT, Timing::Cycles iterM);
+#endif
+
+		// Let time pass while halted/stopped, up to cycles or the next event. Returns the T-cycles idled.
+		int Idle(int cycles);
+
+		// Immediate operand of the op being executed, from the decoded block when the block cache is on
+#if FEIGN_BLOCK_CACHE
+		Byte Imm8() const { return (Byte)this->imm; }
+		Word Imm16() const { return this->imm; }
+#else
+		Byte Imm8() const { return this->ram->ReadByte(this->PC); }
+		Word Imm16() const { return this->ram->ReadWord(this->PC); }
+#endif
+
+		// Resolve a register index to the register itself at compile time.
+		template <REGISTER8 R> Byte& Reg();
+		template <REGISTER16 R> Register& Reg16();
+
 		Register AF, BC, DE, HL, SP; // 16-bit 2-part general registers. We are using shorts to allow carry checks
 		Word PC; // 16-bit special registers
 		int M, T; // Clocks
-		int total_M, total_T; // Total execution time
+		Timing::Cycles total_M, total_T; // Total execution time
 		bool IME; // Interrupt Master Enable
+		Byte pending; // IE & IF, the interrupts requested and enabled
 		bool halt; // If processing is halted
 		bool stop; // If stopped
+		bool cgb; // Running as a CGB
+		bool speedArmed; // KEY1 bit 0, the next STOP switches speed
 
 		Memory::MMU* ram;
 
 		unsigned int numInstructions;
+
+		Timing::Scheduler events;
+
+#if FEIGN_BLOCK_CACHE
+		BlockCache blocks;
+		Word imm; // Immediate of the op being replayed
+		bool blockDirty; // Set when the current block must not be replayed any further
+#endif
+#if FEIGN_JIT
+		Recompiler jit;
+#endif
+#if FEIGN_PROFILE
+		Profiler profiler;
+#endif
+
+		bool idleSkip;
+		IdleLoopStats idleStats;
+
+		friend class BlockCache;
+		friend class Recompiler;
+		friend class FlagsTest;
+
+		// Handler tables built from Opcodes.h
+		static const OP_FUNC opTable[256];
+		static const OP_FUNC cbTable[256];
 	};
+
+	template <> inline Byte& Z80::Reg<REG_B>() { return this->BC.first; }
+	template <> inline Byte& Z80::Reg<REG_C>() { return this->BC.last; }
+	template <> inline Byte& Z80::Reg<REG_D>() { return this->DE.first; }
+	template <> inline Byte& Z80::Reg<REG_E>() { return this->DE.last; }
+	template <> inline Byte& Z80::Reg<REG_H>() { return this->HL.first; }
+	template <> inline Byte& Z80::Reg<REG_L>() { return this->HL.last; }
+	template <> inline Byte& Z80::Reg<REG_A>() { return this->AF.first; }
+
+	template <> inline Register& Z80::Reg16<REG_BC>() { return this->BC; }
+	template <> inline Register& Z80::Reg16<REG_DE>() { return this->DE; }
+	template <> inline Register& Z80::Reg16<REG_HL>() { return this->HL; }
+	template <> inline Register& Z80::Reg16<REG_SP>() { return this->SP; }
+	template <> inline Register& Z80::Reg16<REG_AF>() { return this->AF; }
 }
\ No newline at end of file
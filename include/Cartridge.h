@@ -1,53 +1,46 @@
 #pragma once
+#include "Binary.h"
+
+#include "ROMStore.h"
 
 #include <string>
-#include <fstream>
+#include <cstring>
+#include <memory>
 
+// ROM image shared through the ROMStore. Nothing is copied, the MMU's bank pointers aim straight
+// into the mapped image, so the Cartridge has to outlive the MMU using it.
 class Cartridge {
 public:
-	Cartridge() : buffer(nullptr), fsize(0), badHeaderChecksum(false) { }
-	~Cartridge() {
-		if (this->buffer != nullptr) {
-			delete[] this->buffer;
-		}
-	}
+	Cartridge() : buffer(nullptr), fsize(0), badHeaderChecksum(false), badGlobalChecksum(false) { }
 
 	// Load a ROM image from file. Return true on successful load and header checksum pass.
 	bool LoadFromFile(const std::string& fname) {
-		std::ifstream file(fname, std::ios::binary);
-
-		// Move to the end of the file to get the size.
-		file.seekg(0, std::ios::end);
-
-		// Save the size.
-		this->fsize = (unsigned int)file.tellg();
-
-		// Move to the beginning of the file and copy it to the internal buffer.
-		file.seekg(0);
-
-		if (this->fsize > 0) {
-			this->buffer = new Byte[this->fsize];
-
-			for (unsigned int i = 0; i < this->fsize; ++i) {
-				this->buffer[i] = file.get();
-			}
+		this->badHeaderChecksum = false;
+		this->badGlobalChecksum = false;
+
+		this->image = Memory::ROMStore::Acquire(fname);
+		if (this->image == nullptr) {
+			this->buffer = nullptr;
+			this->fsize = 0;
+			return false;
+		}
 
-			// Make sure the ROM image is at least as large as the header before trying to parse it.
-			if (this->fsize > 0x014F) {
-				ParseHeader();
-			}
-			else {
-				return false;
-			}
+		this->buffer = this->image->GetData();
+		this->fsize = this->image->GetSize();
 
-			if (this->badHeaderChecksum) {
-				return false;
-			}
+		// Make sure the ROM image is at least as large as the header before trying to parse it.
+		if (this->fsize > 0x014F) {
+			ParseHeader();
+		}
+		else {
+			return false;
+		}
 
-			return true;
+		if (this->badHeaderChecksum) {
+			return false;
 		}
 
-		return false;
+		return true;
 	}
 
 	// Parse the header information from the image.
@@ -71,7 +64,7 @@ public:
 		this->romCheckseum = (this->buffer[0x014E] << 8) + this->buffer[0x014F];
 
 		// Compute the header checksum.
-		char csum = 0;
+		Byte csum = 0;
 		for (int i = 0x0134; i <= 0x014C; ++i) {
 			csum = csum - this->buffer[i] - 1;
 		}
@@ -81,8 +74,16 @@ public:
 			this->badHeaderChecksum = true;
 		}
 
+		// Global checksum, the sum of every byte except the checksum itself. The hardware ignores it,
+		// so a mismatch is only reported.
+		Word gsum = this->image->GetSum() - this->buffer[0x014E] - this->buffer[0x014F];
+
+		if (gsum != this->romCheckseum) {
+			this->badGlobalChecksum = true;
+		}
+
 		// If this is a color gboy ROM chop the title length.
-		if ((this->cgb == 0x80) || (this->cgb == 0xC0)) {
+		if (IsCGB()) {
 			this->title[11] = 0; this->title[12] = 0; this->title[13] = 0;
 			this->title[14] = 0; this->title[15] = 0;
 		}
@@ -92,7 +93,8 @@ public:
 		return (unsigned int)this->fsize;
 	}
 
-	unsigned char* GetBuffer() const {
+	// Mapped image, read-only.
+	const Byte* GetBuffer() const {
 		return this->buffer;
 	}
 
@@ -104,10 +106,25 @@ public:
 		return this->cartType;
 	}
 
+	// The header asks for CGB features, whether or not it also runs on a DMG.
+	bool IsCGB() const {
+		return (this->cgb == 0x80) || (this->cgb == 0xC0);
+	}
 
+	// External RAM size in bytes from the header code.
+	unsigned int GetRAMSize() const {
+		static const unsigned int sizes[6] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+		return (this->ramSize < 6) ? sizes[this->ramSize] : 0;
+	}
+
+	bool HasValidGlobalChecksum() const {
+		return !this->badGlobalChecksum;
+	}
 
 private:
-	Byte* buffer;
+	std::shared_ptr<const Memory::ROMImage> image;
+
+	const Byte* buffer; // Image data
 	unsigned int fsize; // File size of the image.
 	Byte ninLogo[48]; // Nin* logo
 	char title[16]; // Internal title of the ROM.
@@ -126,5 +143,6 @@ private:
 
 	Byte headerChecksum; // CHecksum of the header (verified).
 	bool badHeaderChecksum; // True if the computed header checksum doesn't match the supplied one.
-	Word romCheckseum; // Checksum of the whole ROM minus the checksum bytes (not verified).
+	Word romCheckseum; // Checksum of the whole ROM minus the checksum bytes (verified, not enforced).
+	bool badGlobalChecksum; // True if the computed global checksum doesn't match romCheckseum.
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+// Build configuration. Override any of these from the compiler command line.
+
+// Opcode dispatch engines for Processor::Z80.
+#define FEIGN_DISPATCH_SWITCH 0 // Portable 256-case switch.
+#define FEIGN_DISPATCH_TABLE 1 // Handler table, one indirect call per opcode.
+#define FEIGN_DISPATCH_THREADED 2 // Computed goto, every handler jumps straight to the next opcode's handler (GCC/Clang).
+
+#ifndef FEIGN_DISPATCH
+#if defined(__GNUC__)
+#define FEIGN_DISPATCH FEIGN_DISPATCH_THREADED
+#else
+#define FEIGN_DISPATCH FEIGN_DISPATCH_SWITCH
+#endif
+#endif
+
+#if (FEIGN_DISPATCH == FEIGN_DISPATCH_THREADED) && !defined(__GNUC__)
+#error "FEIGN_DISPATCH_THREADED needs the labels as values extension (GCC/Clang)"
+#endif
+
+// Lazy flag evaluation. ALU ops record their operands and F is only computed when something reads it.
+#ifndef FEIGN_LAZY_FLAGS
+#define FEIGN_LAZY_FLAGS 1
+#endif
+
+// Decoded basic-block cache. Guest code is decoded once into blocks of pre-resolved handlers and
+// immediates which are replayed on later visits. Replaces the FEIGN_DISPATCH engine when enabled.
+#ifndef FEIGN_BLOCK_CACHE
+#define FEIGN_BLOCK_CACHE 1
+#endif
+
+// Idle loop skipping. Blocks that branch back to themselves, only read memory and leave the registers
+// as they found them are fast-forwarded to the next scheduled event, which is the earliest anything
+// they poll can change. Needs FEIGN_BLOCK_CACHE, can also be turned off at run time for accuracy runs.
+#ifndef FEIGN_IDLE_LOOPS
+#define FEIGN_IDLE_LOOPS 1
+#endif
+
+// x86-64 recompiler for hot blocks from the block cache. The interpreter stays the reference, ops the
+// recompiler doesn't translate are run by calling their interpreter handler.
+#ifndef FEIGN_JIT
+#define FEIGN_JIT 0
+#endif
+
+#if FEIGN_JIT
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "FEIGN_JIT needs an x86-64 host"
+#endif
+#if !FEIGN_BLOCK_CACHE || !FEIGN_LAZY_FLAGS
+#error "FEIGN_JIT needs FEIGN_BLOCK_CACHE and FEIGN_LAZY_FLAGS"
+#endif
+#endif
+
+// SIMD kernels for tile decoding and scanline composition. FEIGN_SIMD_NONE builds the portable scalar
+// code only, which is also what the kernels are checked against.
+#define FEIGN_SIMD_NONE 0
+#define FEIGN_SIMD_SSE2 1 // Any x86-64 host
+
+#ifndef FEIGN_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FEIGN_SIMD FEIGN_SIMD_SSE2
+#else
+#define FEIGN_SIMD FEIGN_SIMD_NONE
+#endif
+#endif
+
+// Opcode profiler. Counts executions and T-cycles of every opcode and CB opcode and times one op in
+// every PROFILE_SAMPLE_INTERVAL on the host clock, the report is printed when the CPU is destroyed.
+// Without it the interpreter makes no timing calls at all.
+#ifndef FEIGN_PROFILE
+#define FEIGN_PROFILE 0
+#endif
+
+#if FEIGN_PROFILE && FEIGN_JIT
+#error "FEIGN_PROFILE counts ops in the interpreter, compiled blocks would be missed. Build without FEIGN_JIT."
+#endif
+
+// OAM DMA copied one byte per M-cycle as the hardware does, instead of all 160 at once when it starts.
+// The CPU is locked out of the bus for the same 160 M-cycles either way. Only matters to code that
+// watches OAM fill in, e.g. a PPU reading sprites mid-transfer.
+#ifndef FEIGN_DMA_EXACT
+#define FEIGN_DMA_EXACT 0
+#endif
@@ -1,21 +1,36 @@
 #pragma once
 
+#include <cstring>
+
 class Emulator {
 public:
 	Emulator(void) : InitialPC(0) {
+		memset(Unmapped, 0xFF, sizeof(Unmapped));
+		MapMemory(0, 0x10000, nullptr, nullptr);
 	}
 
 	~Emulator(void) {
 	}
 
-	// TODO: Implement paged memory access
+	// Read through the page table.
 	inline char ReadMemory(unsigned int Address) {
-		return Memory[Address];
+		return ReadPages[(Address >> 8) & 0xFF][Address & 0xFF];
 	}
 
-	// TODO: Implement paged memory access
+	// Write through the page table. Writes to read-only pages are dropped.
 	inline void WriteMemory(unsigned int Address, char Value) {
-		Memory[Address] = Value;
+		char* page = WritePages[(Address >> 8) & 0xFF];
+		if (page != nullptr) {
+			page[Address & 0xFF] = Value;
+		}
+	}
+
+	// Point the 256 byte pages covering [Address, Address + Size) at host memory.
+	void MapMemory(unsigned int Address, unsigned int Size, char* Read, char* Write) {
+		for (unsigned int i = 0; i < (Size >> 8); ++i) {
+			ReadPages[((Address >> 8) + i) & 0xFF] = (Read != nullptr) ? Read + (i << 8) : Unmapped;
+			WritePages[((Address >> 8) + i) & 0xFF] = (Write != nullptr) ? Write + (i << 8) : nullptr;
+		}
 	}
 
 protected:
@@ -26,6 +41,10 @@ protected:
 
 	char* Memory;
 
+	char* ReadPages[256];
+	char* WritePages[256];
+	char Unmapped[256];
+
 	int* Cycles;
 	bool ExitRequired;
 
@@ -3,8 +3,12 @@
 #include "Video.h"
 #include "Memory.h"
 #include "CPU.h"
+#include "Timer.h"
 #include "Cartridge.h"
 
+#include <climits>
+#include <iostream>
+
 // Main memory and video memory are the same size at 8k
 #define MEMORY_SIZE 8192
 
@@ -17,20 +21,57 @@ using std::chrono::nanoseconds;
 using std::chrono::high_resolution_clock;
 using std::chrono::duration;
 
+// Why a batch run returned.
+enum RUN_STOP_REASON {
+	RUN_STOP_BUDGET, // The cycle budget ran out
+	RUN_STOP_VBLANK, // The PPU entered VBlank
+	RUN_STOP_FRAME, // The PPU finished a whole frame including VBlank
+};
+
+// Outcome of RunCycles/RunFrame/RunUntilVBlank.
+struct RunResult {
+	Timing::Cycles cycles; // T-cycles executed
+	unsigned int frames; // Frames finished (VBlank entries)
+	RUN_STOP_REASON reason;
+};
+
 class GBoy {
 public:
-	GBoy() {
+	// Frames are drawn in format, see GetScreen.
+	GBoy(Video::PIXEL_FORMAT format = Video::PIXEL_RGBA8888) : MainVideo(format), titleStart(0) {
 	}
 
-	~GBoy() { }
+	~GBoy() {
+		ReportIdleLoops();
+	}
 
 	// Load a ROM image from file.
 	void LoadROMImage(std::string fname) {
-		Cartridge cart;
+		Cartridge& cart = this->MainCartridge;
+
+		// The old image must not be unmapped while the MMU still points into it
+		this->MainMemory.MapROM(nullptr, 0);
+
 		cart.LoadFromFile(fname);
 		std::cout << "Loaded ROM title: " << cart.GetTitle() << std::endl;
-		this->MainMemory.AllocateROM(cart.GetSize(), cart.GetBuffer());
-		this->MainMemory.SetCatridgeType(cart.GetType());
+		if (!cart.HasValidGlobalChecksum()) {
+			std::cout << "Global checksum mismatch" << std::endl;
+		}
+
+		// Idle loop statistics are kept per ROM
+		ReportIdleLoops();
+		this->title = cart.GetTitle();
+		this->titleStart = this->MainCPU.GetTotalT();
+		this->MainCPU.ResetIdleLoopStats();
+
+		// Bank pointers aim straight into the mapped image
+		this->MainMemory.MapROM(cart.GetBuffer(), cart.GetSize());
+		this->MainMemory.SetCatridgeType(cart.GetType(), cart.GetRAMSize());
+
+		// CGB ROMs get the CGB registers, VRAM bank and colours
+		this->MainMemory.SetCGB(cart.IsCGB());
+		this->MainVideo.SetCGB(cart.IsCGB());
+		this->MainCPU.SetCGB(cart.IsCGB());
 
 		/*if (cart.LoadFromFile(fname)) {
 			std::cout << "Loaded ROM title: " << cart.GetTitle() << std::endl;
@@ -39,28 +80,138 @@ public:
 		}*/
 
 		// Set the initial PC to be after BIOS.
-		this->MainCPU.SetMMU(&this->MainMemory);
 		this->MainMemory.SetCPU(&this->MainCPU);
+		this->MainMemory.SetTimer(&this->MainTimer);
+		this->MainTimer.SetCPU(&this->MainCPU);
+		this->MainCPU.SetMMU(&this->MainMemory);
 		this->MainVideo.SetCPU(&this->MainCPU);
 		this->MainVideo.SetRAM(&this->MainMemory);
 		this->MainCPU.SetPC(0x100);
 	}
 
+	// Run for clocks T-cycles. Returns false if the CPU ended up halted or stopped.
 	bool Update(unsigned int clocks) {
-		bool exit = false;
-		exit =  this->MainCPU.DoNextOp();
-		this->MainVideo.Step();
-        this->MainCPU.DoInterrupts();
+		RunCycles(clocks);
+
+		return !this->MainCPU.IsHalted();
+	}
+
+	// Run for cycles T-cycles.
+	RunResult RunCycles(Timing::Cycles cycles) {
+		return Run(cycles, Video::PPU_STEP_NONE);
+	}
+
+	// Run until the PPU finishes the current frame, VBlank included, so back to back calls stay in phase.
+	RunResult RunFrame() {
+		return Run(CYCLES_PER_FRAME * 2, Video::PPU_STEP_FRAME);
+	}
+
+	// Run until the PPU enters VBlank, i.e. a new image is ready.
+	RunResult RunUntilVBlank() {
+		return Run(CYCLES_PER_FRAME * 2, Video::PPU_STEP_VBLANK);
+	}
 
-		return exit;
+	// Turn idle loop skipping on or off, off gives exact instruction by instruction emulation.
+	void SetIdleLoopSkip(bool enable) {
+		this->MainCPU.SetIdleLoopSkip(enable);
+	}
+
+	// The last frame drawn, 160x144 pixels in the format the emulator was created with.
+	const Byte* GetScreen() const {
+		return this->MainVideo.GetScreen();
+	}
+
+	// Draw 1 in every n frames, none if n is 0. Timing and interrupts are the same whatever n is.
+	void SetFrameSkip(unsigned int n) {
+		this->MainVideo.SetFrameSkip(n);
+	}
+
+	// Print how much time idle loop skipping saved on the current ROM.
+	void ReportIdleLoops() const {
+		const Processor::IdleLoopStats& stats = this->MainCPU.GetIdleLoopStats();
+		Timing::Cycles total = this->MainCPU.GetTotalT() - this->titleStart;
+
+		if (stats.loops == 0 || total == 0) {
+			return;
+		}
+
+		std::cout << "Idle loops in " << this->title << ": " << stats.loops << " skipped, " << stats.skipped << " of "
+			<< total << " T-cycles (" << (stats.skipped * 100 / total) << "%)" << std::endl;
+	}
+
+	// Fire the events that have come due on the CPU clock. Returns the PPU_STEP_RESULT bits of any PPU steps.
+	int DispatchEvents() {
+		Timing::Scheduler& events = this->MainCPU.GetScheduler();
+		Timing::EVENT_TYPE type;
+		Timing::Cycles when;
+		int ppu = Video::PPU_STEP_NONE;
+
+		while (events.PopDue(this->MainCPU.GetTotalT(), type, when)) {
+			switch (type) {
+			case Timing::EVENT_PPU_MODE:
+			ppu |= this->MainVideo.Step(when);
+			break;
+			case Timing::EVENT_TIMER_OVERFLOW:
+			this->MainTimer.Overflow(when);
+			break;
+			case Timing::EVENT_OAM_DMA:
+			this->MainMemory.StepDMA(when);
+			break;
+			case Timing::EVENT_HDMA:
+			this->MainMemory.StepHDMA(when);
+			break;
+			case Timing::EVENT_INTERRUPT_CHECK:
+			this->MainCPU.DoInterrupts();
+			break;
+			default:
+			break;
+			}
+		}
+
+		return ppu;
 	}
 private:
+	// Run the CPU a slice at a time, each slice ending at the next event, until budget T-cycles have passed
+	// or a PPU step in stopOn has happened.
+	RunResult Run(Timing::Cycles budget, int stopOn) {
+		RunResult result = { 0, 0, RUN_STOP_BUDGET };
+		Timing::Cycles start = this->MainCPU.GetTotalT();
+
+		while (result.cycles < budget) {
+			Timing::Cycles left = budget - result.cycles;
+
+			this->MainCPU.Run((left > INT_MAX) ? INT_MAX : (int)left);
+			int ppu = DispatchEvents();
+
+			result.cycles = this->MainCPU.GetTotalT() - start;
+
+			if (ppu & Video::PPU_STEP_VBLANK) {
+				++result.frames;
+			}
+
+			if (ppu & stopOn) {
+				result.reason = (stopOn == Video::PPU_STEP_VBLANK) ? RUN_STOP_VBLANK : RUN_STOP_FRAME;
+				break;
+			}
+		}
+
+		return result;
+	}
+
+	// Declared first so the mapped image outlives the MMU pointing into it
+	Cartridge MainCartridge;
+
 	Memory::MMU MainMemory;
 
 	Processor::Z80 MainCPU;
 
 	Video::DMG MainVideo;
 
+	Timing::Timer MainTimer;
+
+	std::string title; // Title of the loaded ROM
+	Timing::Cycles titleStart; // Clock when it was loaded
+
 	high_resolution_clock::time_point start;
 	high_resolution_clock::time_point end;
 };
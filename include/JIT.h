@@ -0,0 +1,72 @@
+#pragma once
+#include "Binary.h"
+#include "Config.h"
+#include "BlockCache.h"
+
+#include <cstddef>
+
+namespace Processor {
+    class Z80;
+
+    // Times a block runs in the interpreter before it is compiled.
+#define JIT_HOT_THRESHOLD 16
+
+    // Size of the executable code buffer. When it fills up all compiled code is dropped.
+#define JIT_CODE_SIZE (16 * 1024 * 1024)
+
+    // Compiled block. Runs the whole block and returns the T-cycles it took.
+    typedef int (*NATIVE_BLOCK)(Z80* cpu);
+
+    // Translates hot blocks into x86-64 code. Guest A/B/C/D/E/H/L live in host registers for the whole
+    // block and flag-setting ops only write the lazy flags record, exactly as the interpreter does.
+    // Memory accesses go through the MMU page tables with a call into the MMU for unmapped pages. Ops
+    // without a translation call their interpreter handler.
+    //
+    // Compiled blocks only run when the whole block fits before the next scheduled event, so they
+    // account cycles but never check deadlines. They exit early when a write drops cached code.
+    class Recompiler {
+    public:
+        Recompiler();
+        ~Recompiler();
+
+        // Set the CPU whose blocks are compiled.
+        void SetCPU(Z80* p);
+
+        // Compile block and set block.native. Returns false when the code buffer is full.
+        bool Compile(Block& block);
+
+        // Throw away all compiled code. Blocks still pointing at it must be dropped first.
+        void Reset();
+
+    private:
+        // Offsets of the Z80 state generated code touches, relative to the Z80 object.
+        struct Offsets {
+            int reg[8]; // Indexed by REGISTER8
+            int pc;
+            int imm;
+            int m;
+            int t;
+            int totalM;
+            int totalT;
+            int numInstructions;
+            int blockDirty;
+            int lazyOp;
+            int lazyA;
+            int lazyB;
+            int lazyCarry;
+        };
+
+        // Called from generated code.
+        static Byte ReadThunk(Memory::MMU* mmu, Word address);
+        static void WriteThunk(Memory::MMU* mmu, Word address, Byte val);
+        static Byte CarryInThunk(Z80* cpu);
+
+        friend class Translator;
+
+        Z80* cpu;
+        Offsets off;
+
+        Byte* code;
+        size_t used;
+    };
+}
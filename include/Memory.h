@@ -1,13 +1,65 @@
 #pragma once
 #include "Binary.h"
+#include "Config.h"
+#include "Scheduler.h"
+
+#include <vector>
 
 namespace Processor {
     class Z80;
 }
 
+namespace Timing {
+    class Timer;
+}
+
+namespace Video {
+    class TileCache;
+    class SpriteIndex;
+}
+
 namespace Memory {
+    // The address space is split into 256 pages of 256 bytes each.
+#define PAGE_SHIFT 8
+#define PAGE_SIZE 0x100
+#define PAGE_MASK 0xFF
+#define PAGE_COUNT 0x100
+
+    // Memory bank controller families, selected from the cartridge type at load time.
+    enum MBC_TYPE {
+        MBC_NONE, // 32k ROM, optionally 8k RAM
+        MBC_1, // Up to 2M ROM and 32k RAM
+        MBC_2, // Up to 256k ROM, 512x4 bits of built-in RAM
+        MBC_3, // Up to 2M ROM and 32k RAM, real time clock
+        MBC_5, // Up to 8M ROM and 128k RAM
+    };
+
+    // MBC3 real time clock registers, selected as RAM banks 08-0C.
+    enum RTC_REGISTERS {
+        RTC_S, // Seconds
+        RTC_M, // Minutes
+        RTC_H, // Hours
+        RTC_DL, // Low 8 bits of the day counter
+        RTC_DH, // Bit 0: day counter bit 8, bit 6: halt, bit 7: day counter carry
+        RTC_COUNT,
+    };
+
+    // The clock runs off the CPU clock, counting whole seconds since base.
     struct RTC {
+        Byte live[RTC_COUNT];
+        Byte latched[RTC_COUNT]; // What the CPU reads
+        Byte latch; // Last value written to the latch register
+        unsigned long long base; // T-cycle timestamp live was last brought up to date at
+    };
+
+    // IO register handlers, see MMU::MapIO. device is whatever was passed to MapIO.
+    typedef Byte (*IO_READ)(void* device, Word address);
+    typedef void (*IO_WRITE)(void* device, Word address, Byte val);
 
+    struct IOHandler {
+        IO_READ read; // Works out the value read, nullptr returns the last byte written
+        IO_WRITE write; // Told about each write after the byte is stored, may be nullptr
+        void* device;
     };
 
     class MMU {
@@ -18,91 +70,241 @@ namespace Memory {
         // Set the CPU pointer.
         void SetCPU(Processor::Z80* p);
 
-        // Allocate the ROM buffer and optionally copy data into it.
-        void AllocateROM(unsigned int size, unsigned char* data = nullptr);
+        // Set the timer backing DIV/TIMA/TMA/TAC.
+        void SetTimer(Timing::Timer* t);
 
-        // Read a byte of memory at address.
-        Byte ReadByte(Word& address) {
-            if (address < 0x4000) {
-                return this->_rom[address];
-            }
-            else if (address < 0x8000) {
-                return this->_rom[((this->rombank - 1) * 0x4000) + address];
+        // Set the tile cache to report tile data writes (8000-97FF) to.
+        void SetTileCache(Video::TileCache* t);
+
+        // Set the sprite index to report OAM (FE00-FE9F) and LCDC.OBJ_SIZE changes to.
+        void SetSpriteIndex(Video::SpriteIndex* s);
+
+        // Start an OAM DMA from source << 8 to FE00-FE9F, as a write to FF46 does. The CPU is locked out
+        // of everything but the IO page and HRAM for the 160 M-cycles it takes.
+        void StartDMA(Byte source);
+
+        // The DMA event came due. Copies the next byte with FEIGN_DMA_EXACT, else ends the transfer.
+        void StepDMA(Timing::Cycles when);
+
+        // Run as a CGB, with a second VRAM bank and HDMA. Selects VRAM bank 0 and stops any HDMA.
+        void SetCGB(bool enable);
+
+        // VBK (FF4F), the VRAM bank the CPU sees at 8000-9FFF.
+        void SetVRAMBank(Byte bank);
+
+        Byte GetVRAMBank() const {
+            return this->vramBank;
+        }
+
+        // Start a CGB VRAM DMA of blocks 16-byte blocks from source to dest (8000-9FF0), as a write to
+        // HDMA5 does. A general purpose DMA copies everything at once and stalls the CPU for it, an
+        // HBlank DMA copies one block per EVENT_HDMA. Starting a general purpose DMA while an HBlank DMA
+        // runs stops the HBlank DMA instead.
+        void StartHDMA(Word source, Word dest, unsigned int blocks, bool hblank);
+
+        // The HDMA event came due at the start of HBlank, copy the next block.
+        void StepHDMA(Timing::Cycles when);
+
+        bool IsHDMAActive() const {
+            return this->hdmaActive;
+        }
+
+        // HDMA5 read, the blocks left minus one, bit 7 set unless an HBlank DMA is running. FF when done.
+        Byte GetHDMAStatus() const {
+            if (this->hdmaBlocks == 0) {
+                return 0xFF;
             }
-            else {
-                return this->ram[address - 0x8000];
+            return (this->hdmaActive ? 0x00 : BIT7) | ((this->hdmaBlocks - 1) & 0x7F);
+        }
+
+        // Hand reads and/or writes of the IO register at address (FF00-FFFF) to a device, so it can
+        // compute the value on demand and react to changes instead of polling the register.
+        void MapIO(Word address, IO_READ read, IO_WRITE write, void* device);
+
+        // Allocate the ROM buffer and optionally copy data into it.
+        void AllocateROM(unsigned int size, const unsigned char* data = nullptr);
+
+        // Use data as the ROM without copying it, e.g. a mapped image. data must outlive the MMU.
+        void MapROM(const Byte* data, unsigned int size);
+
+        // Select the memory bank controller for the cartridge type and allocate ramSize bytes of
+        // external RAM (MBC2 has its own).
+        void SetCatridgeType(Byte type, unsigned int ramSize = 0);
+
+        // Read a byte of memory at address through the page table. Pages without a host pointer (IO) take the slow path.
+        Byte ReadByte(Word address) const {
+            const Byte* page = this->readPage[address >> PAGE_SHIFT];
+            if (page != nullptr) {
+                return page[address & PAGE_MASK];
             }
+            return ReadControl(address);
         }
 
         // Read a word at address. Computed by add address to (address+1 << 8)
-        Word ReadWord(Word& address) {
-            if (address < 0x4000) {
-                return ((Word)this->_rom[address] + ((Word)this->_rom[address + 1] << 8));
-            }
-            else if (address < 0x8000) {
-                return ((Word)this->_rom[((this->rombank - 1) * 0x4000) + address] + ((Word)this->_rom[((this->rombank - 1) * 0x4000) + address + 1] << 8));
-            }
-            else {
-                return ((Word)this->ram[address - 0x8000] + ((Word)this->ram[address - 0x8000 + 1] << 8));
-            }
+        Word ReadWord(Word address) const {
+            return ((Word)ReadByte(address) + ((Word)ReadByte(address + 1) << 8));
         }
 
-        // Read a byte of memory at address.
-        Byte ReadByte(Word&& address) {
-            if (address < 0x4000) {
-                return this->_rom[address];
-            }
-            else if (address < 0x8000) {
-                return this->_rom[((this->rombank - 1) * 0x4000) + address];
-            }
-            else {
-                if ((address > 0xE000) && (address < 0xFE00)) {
-                    return this->ram[address - 0x9000];
-                }
-                return this->ram[address - 0x8000];
+        // Write a byte at address. Pages without a direct host pointer (ROM/MBC registers, IO) take the slow path.
+        void WriteByte(const Word& address, const Byte& val) {
+            Byte* page = this->writePage[address >> PAGE_SHIFT];
+            if (page != nullptr) {
+                page[address & PAGE_MASK] = val;
+                return;
             }
+            WriteControl(address, val);
         }
 
-        // Read a word at address. Computed by add address to (address+1 << 8)
-        Word ReadWord(Word&& address) {
-            if (address < 0x4000) {
-                return ((Word)this->_rom[address] + ((Word)this->_rom[address + 1] << 8));
+        // Write a word at address. The low byte is written at address, and the high byte is written at address+1
+        void WriteWord(const Word& address, const Word& val) {
+            WriteByte(address, val & 0xFF);
+            WriteByte(address + 1, (val >> 8) & 0xFF);
+        }
+
+        // Read VRAM (in bank) or OAM for the PPU, which has its own bus and isn't locked out by DMA.
+        Byte ReadVideo(Word address, unsigned int bank = 0) const {
+            return (bank ? this->vram1 : this->ram)[address - 0x8000];
+        }
+
+        // Page tables, for generated code that accesses memory without calling ReadByte/WriteByte.
+        const Byte* const* GetReadPages() const {
+            return this->readPage;
+        }
+
+        Byte* const* GetWritePages() const {
+            return this->writePage;
+        }
+
+        // Host memory backing the page at address if code there may be cached (ROM, WRAM, HRAM), else nullptr.
+        const Byte* GetCodeHost(Word address) const {
+            if (address < 0x8000) {
+                const Byte* page = this->readPage[address >> PAGE_SHIFT];
+                return (page != unmapped) ? page : nullptr;
             }
-            else if (address < 0x8000) {
-                return ((Word)this->_rom[((this->rombank - 1) * 0x4000) + address] + ((Word)this->_rom[((this->rombank - 1) * 0x4000) + address + 1] << 8));
+            if (address >= 0xC000 && address < 0xE000) {
+                const Byte* page = this->readPage[address >> PAGE_SHIFT];
+                return (page != unmapped) ? page : nullptr;
             }
-            else {
-                return ((Word)this->ram[address - 0x8000] + ((Word)this->ram[address - 0x8000 + 1] << 8));
+            if (address >= 0xFF80 && address < 0xFFFF) {
+                return &this->ram[0xFF00 - 0x8000];
             }
+            return nullptr;
         }
 
-        // Write a byte at address.
-        void WriteByte(const Word& address, const Byte& val);
+        // Report the next write to the page at address (or its echo) to the CPU so cached code from it is dropped.
+        void WatchCode(Word address);
+    private:
+        // Handle reads from pages that have no host pointer, i.e. the IO registers.
+        Byte ReadControl(Word address) const;
 
-        // Write a word at address. The low byte is written at address, and the high byte is written at address+1
-        void WriteWord(const Word& address, const Word& val);
+        // Handle writes to pages that have no host pointer, e.g. the MBC registers in the ROM area.
+        void WriteControl(const Word& address, const Byte& val);
+
+        // Handle writes to the IO page (FF00-FFFF).
+        void WriteIO(Word address, Byte val);
+
+        // Handle writes to the MBC registers (0000-7FFF) and to external RAM pages that aren't
+        // directly writable (A000-BFFF). One instantiation per MBC_TYPE, picked once at load time.
+        template <MBC_TYPE M> void WriteMBC(Word address, Byte val);
+
+        // Bring the RTC registers up to date with the CPU clock.
+        void UpdateRTC();
+
+        // Point the page table entries covering [address, address + size) at host memory.
+        void MapPages(Word address, unsigned int size, const Byte* read, Byte* write);
+
+        // The page table to change. While DMA runs that's the copy the lock puts back.
+        const Byte** MappedRead() {
+            return this->dmaActive ? this->lockedRead : this->readPage;
+        }
+
+        Byte** MappedWrite() {
+            return this->dmaActive ? this->lockedWrite : this->writePage;
+        }
+
+        // Release the ROM if the MMU owns it.
+        void FreeROM();
+
+        // Repoint the ROM pages at the currently selected banks.
+        void MapROMBanks();
+
+        // Repoint the external RAM pages (A000-BFFF) at the selected bank, or unmap them.
+        void MapRAMBank();
+
+        // Copy length bytes from source, read through the page table the CPU had before any DMA lock,
+        // to dest in OAM or the selected VRAM bank. Tiles and sprites written are marked dirty.
+        void CopyBlock(Word dest, Word source, unsigned int length);
+
+        // Host memory behind 8000-9FFF in the selected VRAM bank.
+        Byte* GetVRAMHost() {
+            return this->vramBank ? this->vram1 : this->ram;
+        }
+
+        // Point 8000-9FFF at the selected VRAM bank.
+        void MapVRAMBank();
+
+        // Point every page but FF00-FFFF at nothing while DMA runs, and put them back after.
+        void LockBus();
+        void UnlockBus();
+
+        // Send writes to page through WriteControl until it is written.
+        void WatchPage(Byte page);
+        void UnwatchPage(Byte page);
+
+        // Page table. Each entry holds the host memory backing a PAGE_SIZE block of the address space.
+        const Byte* readPage[PAGE_COUNT]; // nullptr means the read is handled by ReadControl
+        Byte* writePage[PAGE_COUNT]; // nullptr means the write is handled by WriteControl
+
+        // Backing for pages with nothing mapped (reads return 0xFF).
+        static Byte unmapped[PAGE_SIZE];
+
+        // Pages holding cached code, with the write pointer they had before they were watched.
+        bool codeWatch[PAGE_COUNT];
+        Byte* watchedWrite[PAGE_COUNT];
 
-        void SetCatridgeType(Byte type);
-    private:
         Byte _bios[256];
-        Byte* _rom; // Swappable
+        const Byte* _rom; // Swappable
+        bool romOwned; // _rom was allocated by AllocateROM
         //Byte* mem;
         Byte ram[0x8000];
+        Byte vram1[0x2000]; // CGB VRAM bank 1
 
         bool _inbios;
 
         unsigned int ROMSize;
 
         Processor::Z80* cpu;
+        Timing::Timer* timer;
+        Video::TileCache* tiles;
+        Video::SpriteIndex* sprites;
+
+        IOHandler io[PAGE_SIZE]; // FF00-FFFF
 
-        Word romOffset;
-        Word ramOffset;
+        bool dmaActive; // The bus is locked, the page table entries below are the real ones
+        Word dmaSource; // Address of the first byte copied
+        unsigned int dmaIndex; // Next byte to copy with FEIGN_DMA_EXACT
+        const Byte* lockedRead[PAGE_COUNT];
+        Byte* lockedWrite[PAGE_COUNT];
+
+        bool cgb;
+        Byte vramBank; // VBK
+        bool hdmaActive; // An HBlank DMA is running
+        Word hdmaSource; // Next block to copy
+        Word hdmaDest;
+        unsigned int hdmaBlocks; // Blocks left
 
         Byte cartType;
+        MBC_TYPE mbc;
+        void (MMU::*writeMBC)(Word address, Byte val); // WriteMBC<mbc>
 
-        int rombank; // Selected ROM bank
-        int rambank; // Selected RAM bank
+        int rombank; // Selected ROM bank at 4000-7FFF
+        int rombank0; // Selected ROM bank at 0000-3FFF, MBC1 mode 1 only
+        int rambank; // Selected RAM bank, or RTC register for MBC3
+        int bankHigh; // MBC1 2-bit register, upper ROM bank bits or RAM bank
         bool ramOn; // RAM enabled
-        Byte mode; // ROM/RAM expansion mode
+        Byte mode; // MBC1 banking mode
+
+        std::vector<Byte> extRam; // External cartridge RAM, every bank
+        RTC rtc;
     };
 }
\ No newline at end of file
@@ -0,0 +1,556 @@
+#pragma once
+
+// Opcode tables for Processor::Z80. Each entry is OP(opcode, handler call) where the call is made
+// through a Z80* named cpu. The dispatch engines in CPU.cpp expand these into a switch, a handler
+// table or computed goto labels, so every engine decodes from the same list.
+//
+// Register and bit operands are template arguments taken from the opcode encoding (bits 3-5 select
+// the destination/bit, bits 0-2 the source), so each entry instantiates straight-line code.
+
+#define Z80_OPCODES(OP) \
+    /* 00-0F */ \
+    OP(0x00, cpu->NOP()) \
+    OP(0x01, cpu->LD_RR_NN<REG_BC>()) \
+    OP(0x02, cpu->LD_BCm_A()) \
+    OP(0x03, cpu->INC_RR<REG_BC>()) \
+    OP(0x04, cpu->INC_R<REG_B>()) \
+    OP(0x05, cpu->DEC_R<REG_B>()) \
+    OP(0x06, cpu->LD_R_N<REG_B>()) \
+    OP(0x07, cpu->RLCA()) \
+    OP(0x08, cpu->LD_NNm_SP()) \
+    OP(0x09, cpu->ADD_HL_RR<REG_BC>()) \
+    OP(0x0A, cpu->LD_A_BCm()) \
+    OP(0x0B, cpu->DEC_RR<REG_BC>()) \
+    OP(0x0C, cpu->INC_R<REG_C>()) \
+    OP(0x0D, cpu->DEC_R<REG_C>()) \
+    OP(0x0E, cpu->LD_R_N<REG_C>()) \
+    OP(0x0F, cpu->RRCA()) \
+    /* 10-1F */ \
+    OP(0x10, cpu->STOP()) \
+    OP(0x11, cpu->LD_RR_NN<REG_DE>()) \
+    OP(0x12, cpu->LD_DEm_A()) \
+    OP(0x13, cpu->INC_RR<REG_DE>()) \
+    OP(0x14, cpu->INC_R<REG_D>()) \
+    OP(0x15, cpu->DEC_R<REG_D>()) \
+    OP(0x16, cpu->LD_R_N<REG_D>()) \
+    OP(0x17, cpu->RLA()) \
+    OP(0x18, cpu->JR_PCdd()) \
+    OP(0x19, cpu->ADD_HL_RR<REG_DE>()) \
+    OP(0x1A, cpu->LD_A_DEm()) \
+    OP(0x1B, cpu->DEC_RR<REG_DE>()) \
+    OP(0x1C, cpu->INC_R<REG_E>()) \
+    OP(0x1D, cpu->DEC_R<REG_E>()) \
+    OP(0x1E, cpu->LD_R_N<REG_E>()) \
+    OP(0x1F, cpu->RRA()) \
+    /* 20-2F */ \
+    OP(0x20, cpu->JR_NOTF_PCdd<zf>()) \
+    OP(0x21, cpu->LD_RR_NN<REG_HL>()) \
+    OP(0x22, cpu->LDInc_HLm_A()) \
+    OP(0x23, cpu->INC_RR<REG_HL>()) \
+    OP(0x24, cpu->INC_R<REG_H>()) \
+    OP(0x25, cpu->DEC_R<REG_H>()) \
+    OP(0x26, cpu->LD_R_N<REG_H>()) \
+    OP(0x27, cpu->DAA()) \
+    OP(0x28, cpu->JR_F_PCdd<zf>()) \
+    OP(0x29, cpu->ADD_HL_RR<REG_HL>()) \
+    OP(0x2A, cpu->LDInc_A_HLm()) \
+    OP(0x2B, cpu->DEC_RR<REG_HL>()) \
+    OP(0x2C, cpu->INC_R<REG_L>()) \
+    OP(0x2D, cpu->DEC_R<REG_L>()) \
+    OP(0x2E, cpu->LD_R_N<REG_L>()) \
+    OP(0x2F, cpu->CPL()) \
+    /* 30-3F */ \
+    OP(0x30, cpu->JR_NOTF_PCdd<cy>()) \
+    OP(0x31, cpu->LD_RR_NN<REG_SP>()) \
+    OP(0x32, cpu->LDDec_HLm_A()) \
+    OP(0x33, cpu->INC_RR<REG_SP>()) \
+    OP(0x34, cpu->INC_HLm()) \
+    OP(0x35, cpu->DEC_HLm()) \
+    OP(0x36, cpu->LD_HLm_N()) \
+    OP(0x37, cpu->SCF()) \
+    OP(0x38, cpu->JR_F_PCdd<cy>()) \
+    OP(0x39, cpu->ADD_HL_RR<REG_SP>()) \
+    OP(0x3A, cpu->LDDec_A_HLm()) \
+    OP(0x3B, cpu->DEC_RR<REG_SP>()) \
+    OP(0x3C, cpu->INC_R<REG_A>()) \
+    OP(0x3D, cpu->DEC_R<REG_A>()) \
+    OP(0x3E, cpu->LD_R_N<REG_A>()) \
+    OP(0x3F, cpu->CCF()) \
+    /* 40-4F */ \
+    OP(0x40, cpu->LD_R_R<REG_B, REG_B>()) \
+    OP(0x41, cpu->LD_R_R<REG_B, REG_C>()) \
+    OP(0x42, cpu->LD_R_R<REG_B, REG_D>()) \
+    OP(0x43, cpu->LD_R_R<REG_B, REG_E>()) \
+    OP(0x44, cpu->LD_R_R<REG_B, REG_H>()) \
+    OP(0x45, cpu->LD_R_R<REG_B, REG_L>()) \
+    OP(0x46, cpu->LD_R_HLm<REG_B>()) \
+    OP(0x47, cpu->LD_R_R<REG_B, REG_A>()) \
+    OP(0x48, cpu->LD_R_R<REG_C, REG_B>()) \
+    OP(0x49, cpu->LD_R_R<REG_C, REG_C>()) \
+    OP(0x4A, cpu->LD_R_R<REG_C, REG_D>()) \
+    OP(0x4B, cpu->LD_R_R<REG_C, REG_E>()) \
+    OP(0x4C, cpu->LD_R_R<REG_C, REG_H>()) \
+    OP(0x4D, cpu->LD_R_R<REG_C, REG_L>()) \
+    OP(0x4E, cpu->LD_R_HLm<REG_C>()) \
+    OP(0x4F, cpu->LD_R_R<REG_C, REG_A>()) \
+    /* 50-5F */ \
+    OP(0x50, cpu->LD_R_R<REG_D, REG_B>()) \
+    OP(0x51, cpu->LD_R_R<REG_D, REG_C>()) \
+    OP(0x52, cpu->LD_R_R<REG_D, REG_D>()) \
+    OP(0x53, cpu->LD_R_R<REG_D, REG_E>()) \
+    OP(0x54, cpu->LD_R_R<REG_D, REG_H>()) \
+    OP(0x55, cpu->LD_R_R<REG_D, REG_L>()) \
+    OP(0x56, cpu->LD_R_HLm<REG_D>()) \
+    OP(0x57, cpu->LD_R_R<REG_D, REG_A>()) \
+    OP(0x58, cpu->LD_R_R<REG_E, REG_B>()) \
+    OP(0x59, cpu->LD_R_R<REG_E, REG_C>()) \
+    OP(0x5A, cpu->LD_R_R<REG_E, REG_D>()) \
+    OP(0x5B, cpu->LD_R_R<REG_E, REG_E>()) \
+    OP(0x5C, cpu->LD_R_R<REG_E, REG_H>()) \
+    OP(0x5D, cpu->LD_R_R<REG_E, REG_L>()) \
+    OP(0x5E, cpu->LD_R_HLm<REG_E>()) \
+    OP(0x5F, cpu->LD_R_R<REG_E, REG_A>()) \
+    /* 60-6F */ \
+    OP(0x60, cpu->LD_R_R<REG_H, REG_B>()) \
+    OP(0x61, cpu->LD_R_R<REG_H, REG_C>()) \
+    OP(0x62, cpu->LD_R_R<REG_H, REG_D>()) \
+    OP(0x63, cpu->LD_R_R<REG_H, REG_E>()) \
+    OP(0x64, cpu->LD_R_R<REG_H, REG_H>()) \
+    OP(0x65, cpu->LD_R_R<REG_H, REG_L>()) \
+    OP(0x66, cpu->LD_R_HLm<REG_H>()) \
+    OP(0x67, cpu->LD_R_R<REG_H, REG_A>()) \
+    OP(0x68, cpu->LD_R_R<REG_L, REG_B>()) \
+    OP(0x69, cpu->LD_R_R<REG_L, REG_C>()) \
+    OP(0x6A, cpu->LD_R_R<REG_L, REG_D>()) \
+    OP(0x6B, cpu->LD_R_R<REG_L, REG_E>()) \
+    OP(0x6C, cpu->LD_R_R<REG_L, REG_H>()) \
+    OP(0x6D, cpu->LD_R_R<REG_L, REG_L>()) \
+    OP(0x6E, cpu->LD_R_HLm<REG_L>()) \
+    OP(0x6F, cpu->LD_R_R<REG_L, REG_A>()) \
+    /* 70-7F */ \
+    OP(0x70, cpu->LD_HLm_R<REG_B>()) \
+    OP(0x71, cpu->LD_HLm_R<REG_C>()) \
+    OP(0x72, cpu->LD_HLm_R<REG_D>()) \
+    OP(0x73, cpu->LD_HLm_R<REG_E>()) \
+    OP(0x74, cpu->LD_HLm_R<REG_H>()) \
+    OP(0x75, cpu->LD_HLm_R<REG_L>()) \
+    OP(0x76, cpu->HALT()) \
+    OP(0x77, cpu->LD_HLm_R<REG_A>()) \
+    OP(0x78, cpu->LD_R_R<REG_A, REG_B>()) \
+    OP(0x79, cpu->LD_R_R<REG_A, REG_C>()) \
+    OP(0x7A, cpu->LD_R_R<REG_A, REG_D>()) \
+    OP(0x7B, cpu->LD_R_R<REG_A, REG_E>()) \
+    OP(0x7C, cpu->LD_R_R<REG_A, REG_H>()) \
+    OP(0x7D, cpu->LD_R_R<REG_A, REG_L>()) \
+    OP(0x7E, cpu->LD_R_HLm<REG_A>()) \
+    OP(0x7F, cpu->LD_R_R<REG_A, REG_A>()) \
+    /* 80-8F */ \
+    OP(0x80, cpu->ADD_A_R<REG_B>()) \
+    OP(0x81, cpu->ADD_A_R<REG_C>()) \
+    OP(0x82, cpu->ADD_A_R<REG_D>()) \
+    OP(0x83, cpu->ADD_A_R<REG_E>()) \
+    OP(0x84, cpu->ADD_A_R<REG_H>()) \
+    OP(0x85, cpu->ADD_A_R<REG_L>()) \
+    OP(0x86, cpu->ADD_A_HLm()) \
+    OP(0x87, cpu->ADD_A_R<REG_A>()) \
+    OP(0x88, cpu->ADC_A_R<REG_B>()) \
+    OP(0x89, cpu->ADC_A_R<REG_C>()) \
+    OP(0x8A, cpu->ADC_A_R<REG_D>()) \
+    OP(0x8B, cpu->ADC_A_R<REG_E>()) \
+    OP(0x8C, cpu->ADC_A_R<REG_H>()) \
+    OP(0x8D, cpu->ADC_A_R<REG_L>()) \
+    OP(0x8E, cpu->ADC_A_HLm()) \
+    OP(0x8F, cpu->ADC_A_R<REG_A>()) \
+    /* 90-9F */ \
+    OP(0x90, cpu->SUB_A_R<REG_B>()) \
+    OP(0x91, cpu->SUB_A_R<REG_C>()) \
+    OP(0x92, cpu->SUB_A_R<REG_D>()) \
+    OP(0x93, cpu->SUB_A_R<REG_E>()) \
+    OP(0x94, cpu->SUB_A_R<REG_H>()) \
+    OP(0x95, cpu->SUB_A_R<REG_L>()) \
+    OP(0x96, cpu->SUB_A_HLm()) \
+    OP(0x97, cpu->SUB_A_R<REG_A>()) \
+    OP(0x98, cpu->SBC_A_R<REG_B>()) \
+    OP(0x99, cpu->SBC_A_R<REG_C>()) \
+    OP(0x9A, cpu->SBC_A_R<REG_D>()) \
+    OP(0x9B, cpu->SBC_A_R<REG_E>()) \
+    OP(0x9C, cpu->SBC_A_R<REG_H>()) \
+    OP(0x9D, cpu->SBC_A_R<REG_L>()) \
+    OP(0x9E, cpu->SBC_A_HLm()) \
+    OP(0x9F, cpu->SBC_A_R<REG_A>()) \
+    /* A0-AF */ \
+    OP(0xA0, cpu->AND_A_R<REG_B>()) \
+    OP(0xA1, cpu->AND_A_R<REG_C>()) \
+    OP(0xA2, cpu->AND_A_R<REG_D>()) \
+    OP(0xA3, cpu->AND_A_R<REG_E>()) \
+    OP(0xA4, cpu->AND_A_R<REG_H>()) \
+    OP(0xA5, cpu->AND_A_R<REG_L>()) \
+    OP(0xA6, cpu->AND_A_HLm()) \
+    OP(0xA7, cpu->AND_A_R<REG_A>()) \
+    OP(0xA8, cpu->XOR_A_R<REG_B>()) \
+    OP(0xA9, cpu->XOR_A_R<REG_C>()) \
+    OP(0xAA, cpu->XOR_A_R<REG_D>()) \
+    OP(0xAB, cpu->XOR_A_R<REG_E>()) \
+    OP(0xAC, cpu->XOR_A_R<REG_H>()) \
+    OP(0xAD, cpu->XOR_A_R<REG_L>()) \
+    OP(0xAE, cpu->XOR_A_HLm()) \
+    OP(0xAF, cpu->XOR_A_R<REG_A>()) \
+    /* B0-BF */ \
+    OP(0xB0, cpu->OR_A_R<REG_B>()) \
+    OP(0xB1, cpu->OR_A_R<REG_C>()) \
+    OP(0xB2, cpu->OR_A_R<REG_D>()) \
+    OP(0xB3, cpu->OR_A_R<REG_E>()) \
+    OP(0xB4, cpu->OR_A_R<REG_H>()) \
+    OP(0xB5, cpu->OR_A_R<REG_L>()) \
+    OP(0xB6, cpu->OR_A_HLm()) \
+    OP(0xB7, cpu->OR_A_R<REG_A>()) \
+    OP(0xB8, cpu->CP_A_R<REG_B>()) \
+    OP(0xB9, cpu->CP_A_R<REG_C>()) \
+    OP(0xBA, cpu->CP_A_R<REG_D>()) \
+    OP(0xBB, cpu->CP_A_R<REG_E>()) \
+    OP(0xBC, cpu->CP_A_R<REG_H>()) \
+    OP(0xBD, cpu->CP_A_R<REG_L>()) \
+    OP(0xBE, cpu->CP_A_HLm()) \
+    OP(0xBF, cpu->CP_A_R<REG_A>()) \
+    /* C0-CF */ \
+    OP(0xC0, cpu->RET_NOTF<zf>()) \
+    OP(0xC1, cpu->POP_RR<REG_BC>()) \
+    OP(0xC2, cpu->JP_NOTF_NN<zf>()) \
+    OP(0xC3, cpu->JP_NN()) \
+    OP(0xC4, cpu->CALL_NOTF_NN<zf>()) \
+    OP(0xC5, cpu->PUSH_RR<REG_BC>()) \
+    OP(0xC6, cpu->ADD_A_N()) \
+    OP(0xC7, cpu->RST_N<0x00>()) \
+    OP(0xC8, cpu->RET_F<zf>()) \
+    OP(0xC9, cpu->RET()) \
+    OP(0xCA, cpu->JP_F_NN<zf>()) \
+    OP(0xCB, cpu->DoCBOp()) \
+    OP(0xCC, cpu->CALL_F_NN<zf>()) \
+    OP(0xCD, cpu->CALL_NN()) \
+    OP(0xCE, cpu->ADC_A_N()) \
+    OP(0xCF, cpu->RST_N<0x08>()) \
+    /* D0-DF */ \
+    OP(0xD0, cpu->RET_NOTF<cy>()) \
+    OP(0xD1, cpu->POP_RR<REG_DE>()) \
+    OP(0xD2, cpu->JP_NOTF_NN<cy>()) \
+    OP(0xD3, cpu->NOP()) \
+    OP(0xD4, cpu->CALL_NOTF_NN<cy>()) \
+    OP(0xD5, cpu->PUSH_RR<REG_DE>()) \
+    OP(0xD6, cpu->SUB_A_N()) \
+    OP(0xD7, cpu->RST_N<0x10>()) \
+    OP(0xD8, cpu->RET_F<cy>()) \
+    OP(0xD9, cpu->RETI()) \
+    OP(0xDA, cpu->JP_F_NN<cy>()) \
+    OP(0xDB, cpu->NOP()) \
+    OP(0xDC, cpu->CALL_F_NN<cy>()) \
+    OP(0xDD, cpu->NOP()) \
+    OP(0xDE, cpu->SBC_A_N()) \
+    OP(0xDF, cpu->RST_N<0x18>()) \
+    /* E0-EF */ \
+    OP(0xE0, cpu->LD_IONm_A()) \
+    OP(0xE1, cpu->POP_RR<REG_HL>()) \
+    OP(0xE2, cpu->LD_IOCm_A()) \
+    OP(0xE3, cpu->NOP()) \
+    OP(0xE4, cpu->NOP()) \
+    OP(0xE5, cpu->PUSH_RR<REG_HL>()) \
+    OP(0xE6, cpu->AND_A_N()) \
+    OP(0xE7, cpu->RST_N<0x20>()) \
+    OP(0xE8, cpu->ADD_SP_dd()) \
+    OP(0xE9, cpu->JP_HL()) \
+    OP(0xEA, cpu->LD_NNm_A()) \
+    OP(0xEB, cpu->NOP()) \
+    OP(0xEC, cpu->NOP()) \
+    OP(0xED, cpu->NOP()) \
+    OP(0xEE, cpu->XOR_A_N()) \
+    OP(0xEF, cpu->RST_N<0x28>()) \
+    /* F0-FF */ \
+    OP(0xF0, cpu->LD_A_IONm()) \
+    OP(0xF1, cpu->POP_RR<REG_AF>()) \
+    OP(0xF2, cpu->LD_A_IOCm()) \
+    OP(0xF3, cpu->DI()) \
+    OP(0xF4, cpu->NOP()) \
+    OP(0xF5, cpu->PUSH_RR<REG_AF>()) \
+    OP(0xF6, cpu->OR_A_N()) \
+    OP(0xF7, cpu->RST_N<0x30>()) \
+    OP(0xF8, cpu->LD_HL_SPdd()) \
+    OP(0xF9, cpu->LD_SP_HL()) \
+    OP(0xFA, cpu->LD_A_NNm()) \
+    OP(0xFB, cpu->EI()) \
+    OP(0xFC, cpu->NOP()) \
+    OP(0xFD, cpu->NOP()) \
+    OP(0xFE, cpu->CP_A_N()) \
+    OP(0xFF, cpu->RST_N<0x38>())
+
+#define Z80_CB_OPCODES(OP) \
+    /* 00-0F */ \
+    OP(0x00, cpu->RLC<REG_B>()) \
+    OP(0x01, cpu->RLC<REG_C>()) \
+    OP(0x02, cpu->RLC<REG_D>()) \
+    OP(0x03, cpu->RLC<REG_E>()) \
+    OP(0x04, cpu->RLC<REG_H>()) \
+    OP(0x05, cpu->RLC<REG_L>()) \
+    OP(0x06, cpu->RLC_HL()) \
+    OP(0x07, cpu->RLC<REG_A>()) \
+    OP(0x08, cpu->RRC<REG_B>()) \
+    OP(0x09, cpu->RRC<REG_C>()) \
+    OP(0x0A, cpu->RRC<REG_D>()) \
+    OP(0x0B, cpu->RRC<REG_E>()) \
+    OP(0x0C, cpu->RRC<REG_H>()) \
+    OP(0x0D, cpu->RRC<REG_L>()) \
+    OP(0x0E, cpu->RRC_HL()) \
+    OP(0x0F, cpu->RRC<REG_A>()) \
+    /* 10-1F */ \
+    OP(0x10, cpu->RL<REG_B>()) \
+    OP(0x11, cpu->RL<REG_C>()) \
+    OP(0x12, cpu->RL<REG_D>()) \
+    OP(0x13, cpu->RL<REG_E>()) \
+    OP(0x14, cpu->RL<REG_H>()) \
+    OP(0x15, cpu->RL<REG_L>()) \
+    OP(0x16, cpu->RL_HL()) \
+    OP(0x17, cpu->RL<REG_A>()) \
+    OP(0x18, cpu->RR<REG_B>()) \
+    OP(0x19, cpu->RR<REG_C>()) \
+    OP(0x1A, cpu->RR<REG_D>()) \
+    OP(0x1B, cpu->RR<REG_E>()) \
+    OP(0x1C, cpu->RR<REG_H>()) \
+    OP(0x1D, cpu->RR<REG_L>()) \
+    OP(0x1E, cpu->RR_HL()) \
+    OP(0x1F, cpu->RR<REG_A>()) \
+    /* 20-2F */ \
+    OP(0x20, cpu->SLA<REG_B>()) \
+    OP(0x21, cpu->SLA<REG_C>()) \
+    OP(0x22, cpu->SLA<REG_D>()) \
+    OP(0x23, cpu->SLA<REG_E>()) \
+    OP(0x24, cpu->SLA<REG_H>()) \
+    OP(0x25, cpu->SLA<REG_L>()) \
+    OP(0x26, cpu->SLA_HL()) \
+    OP(0x27, cpu->SLA<REG_A>()) \
+    OP(0x28, cpu->SRA<REG_B>()) \
+    OP(0x29, cpu->SRA<REG_C>()) \
+    OP(0x2A, cpu->SRA<REG_D>()) \
+    OP(0x2B, cpu->SRA<REG_E>()) \
+    OP(0x2C, cpu->SRA<REG_H>()) \
+    OP(0x2D, cpu->SRA<REG_L>()) \
+    OP(0x2E, cpu->SRA_HL()) \
+    OP(0x2F, cpu->SRA<REG_A>()) \
+    /* 30-3F */ \
+    OP(0x30, cpu->SWAP<REG_B>()) \
+    OP(0x31, cpu->SWAP<REG_C>()) \
+    OP(0x32, cpu->SWAP<REG_D>()) \
+    OP(0x33, cpu->SWAP<REG_E>()) \
+    OP(0x34, cpu->SWAP<REG_H>()) \
+    OP(0x35, cpu->SWAP<REG_L>()) \
+    OP(0x36, cpu->SWAP_HL()) \
+    OP(0x37, cpu->SWAP<REG_A>()) \
+    OP(0x38, cpu->SRL<REG_B>()) \
+    OP(0x39, cpu->SRL<REG_C>()) \
+    OP(0x3A, cpu->SRL<REG_D>()) \
+    OP(0x3B, cpu->SRL<REG_E>()) \
+    OP(0x3C, cpu->SRL<REG_H>()) \
+    OP(0x3D, cpu->SRL<REG_L>()) \
+    OP(0x3E, cpu->SRL_HL()) \
+    OP(0x3F, cpu->SRL<REG_A>()) \
+    /* 40-4F */ \
+    OP(0x40, cpu->BITTEST<0, REG_B>()) \
+    OP(0x41, cpu->BITTEST<0, REG_C>()) \
+    OP(0x42, cpu->BITTEST<0, REG_D>()) \
+    OP(0x43, cpu->BITTEST<0, REG_E>()) \
+    OP(0x44, cpu->BITTEST<0, REG_H>()) \
+    OP(0x45, cpu->BITTEST<0, REG_L>()) \
+    OP(0x46, cpu->BITTEST_HL<0>()) \
+    OP(0x47, cpu->BITTEST<0, REG_A>()) \
+    OP(0x48, cpu->BITTEST<1, REG_B>()) \
+    OP(0x49, cpu->BITTEST<1, REG_C>()) \
+    OP(0x4A, cpu->BITTEST<1, REG_D>()) \
+    OP(0x4B, cpu->BITTEST<1, REG_E>()) \
+    OP(0x4C, cpu->BITTEST<1, REG_H>()) \
+    OP(0x4D, cpu->BITTEST<1, REG_L>()) \
+    OP(0x4E, cpu->BITTEST_HL<1>()) \
+    OP(0x4F, cpu->BITTEST<1, REG_A>()) \
+    /* 50-5F */ \
+    OP(0x50, cpu->BITTEST<2, REG_B>()) \
+    OP(0x51, cpu->BITTEST<2, REG_C>()) \
+    OP(0x52, cpu->BITTEST<2, REG_D>()) \
+    OP(0x53, cpu->BITTEST<2, REG_E>()) \
+    OP(0x54, cpu->BITTEST<2, REG_H>()) \
+    OP(0x55, cpu->BITTEST<2, REG_L>()) \
+    OP(0x56, cpu->BITTEST_HL<2>()) \
+    OP(0x57, cpu->BITTEST<2, REG_A>()) \
+    OP(0x58, cpu->BITTEST<3, REG_B>()) \
+    OP(0x59, cpu->BITTEST<3, REG_C>()) \
+    OP(0x5A, cpu->BITTEST<3, REG_D>()) \
+    OP(0x5B, cpu->BITTEST<3, REG_E>()) \
+    OP(0x5C, cpu->BITTEST<3, REG_H>()) \
+    OP(0x5D, cpu->BITTEST<3, REG_L>()) \
+    OP(0x5E, cpu->BITTEST_HL<3>()) \
+    OP(0x5F, cpu->BITTEST<3, REG_A>()) \
+    /* 60-6F */ \
+    OP(0x60, cpu->BITTEST<4, REG_B>()) \
+    OP(0x61, cpu->BITTEST<4, REG_C>()) \
+    OP(0x62, cpu->BITTEST<4, REG_D>()) \
+    OP(0x63, cpu->BITTEST<4, REG_E>()) \
+    OP(0x64, cpu->BITTEST<4, REG_H>()) \
+    OP(0x65, cpu->BITTEST<4, REG_L>()) \
+    OP(0x66, cpu->BITTEST_HL<4>()) \
+    OP(0x67, cpu->BITTEST<4, REG_A>()) \
+    OP(0x68, cpu->BITTEST<5, REG_B>()) \
+    OP(0x69, cpu->BITTEST<5, REG_C>()) \
+    OP(0x6A, cpu->BITTEST<5, REG_D>()) \
+    OP(0x6B, cpu->BITTEST<5, REG_E>()) \
+    OP(0x6C, cpu->BITTEST<5, REG_H>()) \
+    OP(0x6D, cpu->BITTEST<5, REG_L>()) \
+    OP(0x6E, cpu->BITTEST_HL<5>()) \
+    OP(0x6F, cpu->BITTEST<5, REG_A>()) \
+    /* 70-7F */ \
+    OP(0x70, cpu->BITTEST<6, REG_B>()) \
+    OP(0x71, cpu->BITTEST<6, REG_C>()) \
+    OP(0x72, cpu->BITTEST<6, REG_D>()) \
+    OP(0x73, cpu->BITTEST<6, REG_E>()) \
+    OP(0x74, cpu->BITTEST<6, REG_H>()) \
+    OP(0x75, cpu->BITTEST<6, REG_L>()) \
+    OP(0x76, cpu->BITTEST_HL<6>()) \
+    OP(0x77, cpu->BITTEST<6, REG_A>()) \
+    OP(0x78, cpu->BITTEST<7, REG_B>()) \
+    OP(0x79, cpu->BITTEST<7, REG_C>()) \
+    OP(0x7A, cpu->BITTEST<7, REG_D>()) \
+    OP(0x7B, cpu->BITTEST<7, REG_E>()) \
+    OP(0x7C, cpu->BITTEST<7, REG_H>()) \
+    OP(0x7D, cpu->BITTEST<7, REG_L>()) \
+    OP(0x7E, cpu->BITTEST_HL<7>()) \
+    OP(0x7F, cpu->BITTEST<7, REG_A>()) \
+    /* 80-8F */ \
+    OP(0x80, cpu->CLEARBIT<0, REG_B>()) \
+    OP(0x81, cpu->CLEARBIT<0, REG_C>()) \
+    OP(0x82, cpu->CLEARBIT<0, REG_D>()) \
+    OP(0x83, cpu->CLEARBIT<0, REG_E>()) \
+    OP(0x84, cpu->CLEARBIT<0, REG_H>()) \
+    OP(0x85, cpu->CLEARBIT<0, REG_L>()) \
+    OP(0x86, cpu->CLEARBIT_HL<0>()) \
+    OP(0x87, cpu->CLEARBIT<0, REG_A>()) \
+    OP(0x88, cpu->CLEARBIT<1, REG_B>()) \
+    OP(0x89, cpu->CLEARBIT<1, REG_C>()) \
+    OP(0x8A, cpu->CLEARBIT<1, REG_D>()) \
+    OP(0x8B, cpu->CLEARBIT<1, REG_E>()) \
+    OP(0x8C, cpu->CLEARBIT<1, REG_H>()) \
+    OP(0x8D, cpu->CLEARBIT<1, REG_L>()) \
+    OP(0x8E, cpu->CLEARBIT_HL<1>()) \
+    OP(0x8F, cpu->CLEARBIT<1, REG_A>()) \
+    /* 90-9F */ \
+    OP(0x90, cpu->CLEARBIT<2, REG_B>()) \
+    OP(0x91, cpu->CLEARBIT<2, REG_C>()) \
+    OP(0x92, cpu->CLEARBIT<2, REG_D>()) \
+    OP(0x93, cpu->CLEARBIT<2, REG_E>()) \
+    OP(0x94, cpu->CLEARBIT<2, REG_H>()) \
+    OP(0x95, cpu->CLEARBIT<2, REG_L>()) \
+    OP(0x96, cpu->CLEARBIT_HL<2>()) \
+    OP(0x97, cpu->CLEARBIT<2, REG_A>()) \
+    OP(0x98, cpu->CLEARBIT<3, REG_B>()) \
+    OP(0x99, cpu->CLEARBIT<3, REG_C>()) \
+    OP(0x9A, cpu->CLEARBIT<3, REG_D>()) \
+    OP(0x9B, cpu->CLEARBIT<3, REG_E>()) \
+    OP(0x9C, cpu->CLEARBIT<3, REG_H>()) \
+    OP(0x9D, cpu->CLEARBIT<3, REG_L>()) \
+    OP(0x9E, cpu->CLEARBIT_HL<3>()) \
+    OP(0x9F, cpu->CLEARBIT<3, REG_A>()) \
+    /* A0-AF */ \
+    OP(0xA0, cpu->CLEARBIT<4, REG_B>()) \
+    OP(0xA1, cpu->CLEARBIT<4, REG_C>()) \
+    OP(0xA2, cpu->CLEARBIT<4, REG_D>()) \
+    OP(0xA3, cpu->CLEARBIT<4, REG_E>()) \
+    OP(0xA4, cpu->CLEARBIT<4, REG_H>()) \
+    OP(0xA5, cpu->CLEARBIT<4, REG_L>()) \
+    OP(0xA6, cpu->CLEARBIT_HL<4>()) \
+    OP(0xA7, cpu->CLEARBIT<4, REG_A>()) \
+    OP(0xA8, cpu->CLEARBIT<5, REG_B>()) \
+    OP(0xA9, cpu->CLEARBIT<5, REG_C>()) \
+    OP(0xAA, cpu->CLEARBIT<5, REG_D>()) \
+    OP(0xAB, cpu->CLEARBIT<5, REG_E>()) \
+    OP(0xAC, cpu->CLEARBIT<5, REG_H>()) \
+    OP(0xAD, cpu->CLEARBIT<5, REG_L>()) \
+    OP(0xAE, cpu->CLEARBIT_HL<5>()) \
+    OP(0xAF, cpu->CLEARBIT<5, REG_A>()) \
+    /* B0-BF */ \
+    OP(0xB0, cpu->CLEARBIT<6, REG_B>()) \
+    OP(0xB1, cpu->CLEARBIT<6, REG_C>()) \
+    OP(0xB2, cpu->CLEARBIT<6, REG_D>()) \
+    OP(0xB3, cpu->CLEARBIT<6, REG_E>()) \
+    OP(0xB4, cpu->CLEARBIT<6, REG_H>()) \
+    OP(0xB5, cpu->CLEARBIT<6, REG_L>()) \
+    OP(0xB6, cpu->CLEARBIT_HL<6>()) \
+    OP(0xB7, cpu->CLEARBIT<6, REG_A>()) \
+    OP(0xB8, cpu->CLEARBIT<7, REG_B>()) \
+    OP(0xB9, cpu->CLEARBIT<7, REG_C>()) \
+    OP(0xBA, cpu->CLEARBIT<7, REG_D>()) \
+    OP(0xBB, cpu->CLEARBIT<7, REG_E>()) \
+    OP(0xBC, cpu->CLEARBIT<7, REG_H>()) \
+    OP(0xBD, cpu->CLEARBIT<7, REG_L>()) \
+    OP(0xBE, cpu->CLEARBIT_HL<7>()) \
+    OP(0xBF, cpu->CLEARBIT<7, REG_A>()) \
+    /* C0-CF */ \
+    OP(0xC0, cpu->SETBIT<0, REG_B>()) \
+    OP(0xC1, cpu->SETBIT<0, REG_C>()) \
+    OP(0xC2, cpu->SETBIT<0, REG_D>()) \
+    OP(0xC3, cpu->SETBIT<0, REG_E>()) \
+    OP(0xC4, cpu->SETBIT<0, REG_H>()) \
+    OP(0xC5, cpu->SETBIT<0, REG_L>()) \
+    OP(0xC6, cpu->SETBIT_HL<0>()) \
+    OP(0xC7, cpu->SETBIT<0, REG_A>()) \
+    OP(0xC8, cpu->SETBIT<1, REG_B>()) \
+    OP(0xC9, cpu->SETBIT<1, REG_C>()) \
+    OP(0xCA, cpu->SETBIT<1, REG_D>()) \
+    OP(0xCB, cpu->SETBIT<1, REG_E>()) \
+    OP(0xCC, cpu->SETBIT<1, REG_H>()) \
+    OP(0xCD, cpu->SETBIT<1, REG_L>()) \
+    OP(0xCE, cpu->SETBIT_HL<1>()) \
+    OP(0xCF, cpu->SETBIT<1, REG_A>()) \
+    /* D0-DF */ \
+    OP(0xD0, cpu->SETBIT<2, REG_B>()) \
+    OP(0xD1, cpu->SETBIT<2, REG_C>()) \
+    OP(0xD2, cpu->SETBIT<2, REG_D>()) \
+    OP(0xD3, cpu->SETBIT<2, REG_E>()) \
+    OP(0xD4, cpu->SETBIT<2, REG_H>()) \
+    OP(0xD5, cpu->SETBIT<2, REG_L>()) \
+    OP(0xD6, cpu->SETBIT_HL<2>()) \
+    OP(0xD7, cpu->SETBIT<2, REG_A>()) \
+    OP(0xD8, cpu->SETBIT<3, REG_B>()) \
+    OP(0xD9, cpu->SETBIT<3, REG_C>()) \
+    OP(0xDA, cpu->SETBIT<3, REG_D>()) \
+    OP(0xDB, cpu->SETBIT<3, REG_E>()) \
+    OP(0xDC, cpu->SETBIT<3, REG_H>()) \
+    OP(0xDD, cpu->SETBIT<3, REG_L>()) \
+    OP(0xDE, cpu->SETBIT_HL<3>()) \
+    OP(0xDF, cpu->SETBIT<3, REG_A>()) \
+    /* E0-EF */ \
+    OP(0xE0, cpu->SETBIT<4, REG_B>()) \
+    OP(0xE1, cpu->SETBIT<4, REG_C>()) \
+    OP(0xE2, cpu->SETBIT<4, REG_D>()) \
+    OP(0xE3, cpu->SETBIT<4, REG_E>()) \
+    OP(0xE4, cpu->SETBIT<4, REG_H>()) \
+    OP(0xE5, cpu->SETBIT<4, REG_L>()) \
+    OP(0xE6, cpu->SETBIT_HL<4>()) \
+    OP(0xE7, cpu->SETBIT<4, REG_A>()) \
+    OP(0xE8, cpu->SETBIT<5, REG_B>()) \
+    OP(0xE9, cpu->SETBIT<5, REG_C>()) \
+    OP(0xEA, cpu->SETBIT<5, REG_D>()) \
+    OP(0xEB, cpu->SETBIT<5, REG_E>()) \
+    OP(0xEC, cpu->SETBIT<5, REG_H>()) \
+    OP(0xED, cpu->SETBIT<5, REG_L>()) \
+    OP(0xEE, cpu->SETBIT_HL<5>()) \
+    OP(0xEF, cpu->SETBIT<5, REG_A>()) \
+    /* F0-FF */ \
+    OP(0xF0, cpu->SETBIT<6, REG_B>()) \
+    OP(0xF1, cpu->SETBIT<6, REG_C>()) \
+    OP(0xF2, cpu->SETBIT<6, REG_D>()) \
+    OP(0xF3, cpu->SETBIT<6, REG_E>()) \
+    OP(0xF4, cpu->SETBIT<6, REG_H>()) \
+    OP(0xF5, cpu->SETBIT<6, REG_L>()) \
+    OP(0xF6, cpu->SETBIT_HL<6>()) \
+    OP(0xF7, cpu->SETBIT<6, REG_A>()) \
+    OP(0xF8, cpu->SETBIT<7, REG_B>()) \
+    OP(0xF9, cpu->SETBIT<7, REG_C>()) \
+    OP(0xFA, cpu->SETBIT<7, REG_D>()) \
+    OP(0xFB, cpu->SETBIT<7, REG_E>()) \
+    OP(0xFC, cpu->SETBIT<7, REG_H>()) \
+    OP(0xFD, cpu->SETBIT<7, REG_L>()) \
+    OP(0xFE, cpu->SETBIT_HL<7>()) \
+    OP(0xFF, cpu->SETBIT<7, REG_A>())
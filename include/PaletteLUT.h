@@ -0,0 +1,67 @@
+#pragma once
+#include "Binary.h"
+#include "PixelKernels.h"
+
+namespace Video {
+    // DMG palette registers, in register order from BGP.
+    enum DMG_PALETTES {
+        PALETTE_BG, // BGP
+        PALETTE_OBJ0, // OBP0
+        PALETTE_OBJ1, // OBP1
+        PALETTE_COUNT,
+    };
+
+    // CGB colour palettes, 8 for the BG then 8 for sprites, kept after the DMG ones.
+#define CGB_PALETTES 8
+#define PALETTE_CGB_BG PALETTE_COUNT
+#define PALETTE_CGB_OBJ (PALETTE_CGB_BG + CGB_PALETTES)
+#define PALETTE_TOTAL (PALETTE_CGB_OBJ + CGB_PALETTES)
+
+    // Final pixel values of every colour index of every palette, in the framebuffer format. The MMU
+    // passes BGP/OBP0/OBP1 and CGB palette data writes on, so a palette is only looked up again when
+    // it changes.
+    class PaletteLUT {
+    public:
+        PaletteLUT(PIXEL_FORMAT f);
+
+        PIXEL_FORMAT GetFormat() const {
+            return this->format;
+        }
+
+        unsigned int GetPixelSize() const {
+            return this->size;
+        }
+
+        // palette (DMG_PALETTES) was set to val.
+        void SetRegister(int palette, Byte val) {
+            for (int i = 0; i < 4; i++) {
+                this->colors[palette][i] = this->shades[(val >> (i * 2)) & 0x03];
+            }
+        }
+
+        // Colour index (0-3) of palette (PALETTE_CGB_BG/OBJ + 0-7) was set to the 15-bit CGB colour rgb.
+        // PIXEL_INDEXED8 has no room for colours and keeps the index.
+        void SetColor(int palette, int index, Word rgb) {
+            Byte r = rgb & 0x1F;
+            Byte g = (rgb >> 5) & 0x1F;
+            Byte b = (rgb >> 10) & 0x1F;
+
+            this->colors[palette][index] = Pack((r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2), index);
+        }
+
+        // The pixel value of each colour index 0-3 of palette.
+        const unsigned int* Get(int palette) const {
+            return this->colors[palette];
+        }
+
+    private:
+        // The pixel value of an 8-bit per channel colour, or index for PIXEL_INDEXED8.
+        unsigned int Pack(Byte r, Byte g, Byte b, int index) const;
+
+        PIXEL_FORMAT format;
+        unsigned int size; // Bytes per pixel
+
+        unsigned int shades[4]; // The four DMG shades, lightest first
+        unsigned int colors[PALETTE_TOTAL][4];
+    };
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Binary.h"
+#include "Config.h"
+
+#include <cstring>
+
+namespace Video {
+    // Framebuffer pixel formats, picked when the PPU is created.
+    enum PIXEL_FORMAT {
+        PIXEL_INDEXED8, // 1 byte, the shade 0-3 (0 is lightest)
+        PIXEL_RGB565, // 2 bytes, native endian
+        PIXEL_RGBA8888, // 4 bytes, R G B A in memory order
+    };
+
+    // Bytes per pixel of format.
+    inline unsigned int GetPixelSize(PIXEL_FORMAT format) {
+        switch (format) {
+        case PIXEL_INDEXED8:
+        return 1;
+        case PIXEL_RGB565:
+        return 2;
+        default:
+        return 4;
+        }
+    }
+
+    // Store one size byte pixel. color holds it in the low bits, as the palette LUTs do.
+    inline void StorePixel(Byte* out, unsigned int color, unsigned int size) {
+        if (size == 1) {
+            *out = (Byte)color;
+        }
+        else if (size == 2) {
+            unsigned short pixel = (unsigned short)color;
+            memcpy(out, &pixel, sizeof(pixel));
+        }
+        else {
+            memcpy(out, &color, sizeof(color));
+        }
+    }
+
+    // Decode rows of 2bpp tile data, 2 bytes (low plane, high plane) per row, into 8 colour indices
+    // (0-3) per row, leftmost pixel first.
+    void DecodeRows(const Byte* data, Byte* out, unsigned int rows);
+
+    // Look up count colour indices in colors and write one size byte (1, 2 or 4) pixel each to out.
+    void ComposePixels(const Byte* indices, const unsigned int colors[4], Byte* out, unsigned int count, unsigned int size);
+
+    // Portable versions of the above. The SIMD kernels must match them bit for bit.
+    void DecodeRowsScalar(const Byte* data, Byte* out, unsigned int rows);
+    void ComposePixelsScalar(const Byte* indices, const unsigned int colors[4], Byte* out, unsigned int count, unsigned int size);
+}
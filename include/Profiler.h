@@ -0,0 +1,57 @@
+#pragma once
+#include "Binary.h"
+
+#include <ostream>
+
+namespace Processor {
+    // One op in this many is timed on the host clock.
+#define PROFILE_SAMPLE_INTERVAL 1024
+
+    // Totals for one opcode.
+    struct OpProfile {
+        unsigned long long count; // Times executed
+        unsigned long long cycles; // T-cycles taken
+        unsigned long long samples; // Times timed on the host clock
+        unsigned long long sampledNs; // Host nanoseconds over those samples
+    };
+
+    // Per-CPU opcode profile, see FEIGN_PROFILE. Flat arrays indexed by opcode, so recording an op is
+    // two adds and a countdown.
+    class Profiler {
+    public:
+        Profiler();
+
+        // A new run of ops starts, whatever happened since the last op isn't an op's time.
+        void StartRun() {
+            this->timing = false;
+        }
+
+        // The op (a CB op if cb) just finished after taking cycles T-cycles.
+        void Record(bool cb, Byte op, int cycles) {
+            OpProfile& entry = (cb ? this->cbOps : this->ops)[op];
+
+            ++entry.count;
+            entry.cycles += cycles;
+
+            if (--this->countdown == 0) {
+                Sample(entry);
+            }
+        }
+
+        // Write the ops sorted by T-cycles taken, most first.
+        void Report(std::ostream& out) const;
+
+    private:
+        // Read the host clock. Every other call starts timing the next op, the one after that stops and
+        // charges the time to entry.
+        void Sample(OpProfile& entry);
+
+        OpProfile ops[256];
+        OpProfile cbOps[256];
+
+        unsigned int countdown; // Ops until the next clock read
+        bool timing; // The next op is being timed
+        unsigned long long sampleStart; // Host clock when it started, in nanoseconds
+        unsigned long long overhead; // Nanoseconds one clock read adds to a sample
+    };
+}
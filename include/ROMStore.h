@@ -0,0 +1,67 @@
+#pragma once
+#include "Binary.h"
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace Memory {
+    // Read-only ROM image mapped from a file. Immutable once created, so any number of emulator
+    // instances can read it at the same time.
+    class ROMImage {
+    public:
+        ~ROMImage();
+
+        const Byte* GetData() const {
+            return this->data;
+        }
+
+        unsigned int GetSize() const {
+            return this->size;
+        }
+
+        // 64-bit FNV-1a of the whole image, the ROMStore key.
+        unsigned long long GetHash() const {
+            return this->hash;
+        }
+
+        // Sum of every byte in the image, for the cartridge's global checksum.
+        Word GetSum() const {
+            return this->sum;
+        }
+
+    private:
+        ROMImage();
+
+        // Map the whole file read-only and hash it. Returns false if the file can't be mapped.
+        bool Map(const std::string& fname);
+
+        friend class ROMStore;
+
+        const Byte* data;
+        unsigned int size;
+        unsigned long long hash;
+        Word sum;
+#if defined(_WIN32)
+        HANDLE mapping;
+#endif
+    };
+
+    // Process-wide store of ROM images keyed by content hash. Loading a ROM that is already held by
+    // another instance, from any path, returns the same image, so ROM memory is paid once per host
+    // however many emulators run it. Images are released with their last user.
+    class ROMStore {
+    public:
+        // Map fname and return the shared image with its contents, nullptr if it can't be read.
+        static std::shared_ptr<const ROMImage> Acquire(const std::string& fname);
+
+    private:
+        static std::mutex lock;
+        static std::unordered_map<unsigned long long, std::weak_ptr<const ROMImage>> images;
+    };
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+namespace Timing {
+    // Monotonic timestamp in T-cycles since power on.
+    typedef unsigned long long Cycles;
+
+    // Deadline of an empty scheduler.
+#define CYCLES_NEVER 0xFFFFFFFFFFFFFFFFULL
+
+    // Events the scheduler knows about. At most one of each type is pending at a time.
+    // Events due on the same cycle fire in this order.
+    enum EVENT_TYPE {
+        EVENT_PPU_MODE, // The PPU reaches the end of its current mode
+        EVENT_TIMER_OVERFLOW, // TIMA wraps around
+        EVENT_OAM_DMA, // OAM DMA copies its next byte or releases the bus
+        EVENT_HDMA, // HBlank started with a CGB HBlank DMA running, copy its next 16 bytes
+        EVENT_INTERRUPT_CHECK, // IE, IF or IME changed, look for an interrupt to service
+        EVENT_COUNT,
+    };
+
+    // Min-heap of pending events keyed on their timestamp. The CPU runs until the earliest deadline
+    // instead of polling every component after each instruction.
+    //
+    // Timestamps are CPU T-cycles. Parts clocked from the 4.19MHz base clock instead, like the PPU, time
+    // their events with After, so CGB double speed only changes how those convert and the CPU doesn't
+    // have to know about it.
+    class Scheduler {
+    public:
+        Scheduler() : count(0), deadline(CYCLES_NEVER), speedShift(0), fence(0), fenceFlag(nullptr) {
+            for (int i = 0; i < EVENT_COUNT; ++i) {
+                this->slot[i] = -1;
+            }
+        }
+
+        // Schedule type to fire at when, replacing any pending event of the same type.
+        void Schedule(EVENT_TYPE type, Cycles when) {
+            int i = this->slot[type];
+
+            if (i < 0) {
+                i = this->count++;
+                this->heap[i].type = type;
+                this->slot[type] = i;
+            }
+
+            if (when < this->fence) {
+                *this->fenceFlag = true;
+            }
+
+            this->heap[i].when = when;
+            SiftUp(i);
+            SiftDown(this->slot[type]);
+
+            this->deadline = this->heap[0].when;
+        }
+
+        // Drop a pending event of type, if any.
+        void Cancel(EVENT_TYPE type) {
+            int i = this->slot[type];
+            if (i < 0) {
+                return;
+            }
+
+            Remove(i);
+        }
+
+        bool IsScheduled(EVENT_TYPE type) const {
+            return this->slot[type] >= 0;
+        }
+
+        // Until the next call, scheduling an event due before until sets *flag. The CPU fences off a
+        // block it runs without deadline checks so anything landing inside it stops the block.
+        void Fence(Cycles until, bool* flag) {
+            this->fence = until;
+            this->fenceFlag = flag;
+        }
+
+        // Run the CPU at twice the base clock (CGB double speed) or at the base clock.
+        void SetDoubleSpeed(bool enable) {
+            this->speedShift = enable ? 1 : 0;
+        }
+
+        bool IsDoubleSpeed() const {
+            return this->speedShift != 0;
+        }
+
+        // Timestamp cycles of the base clock after when.
+        Cycles After(Cycles when, Cycles cycles) const {
+            return when + (cycles << this->speedShift);
+        }
+
+        // Timestamp of the earliest pending event.
+        Cycles GetDeadline() const {
+            return this->deadline;
+        }
+
+        // Pop the earliest event if it is due at now. Returns false when nothing is due.
+        bool PopDue(Cycles now, EVENT_TYPE& type, Cycles& when) {
+            if (this->deadline > now) {
+                return false;
+            }
+
+            type = this->heap[0].type;
+            when = this->heap[0].when;
+            Remove(0);
+
+            return true;
+        }
+
+    private:
+        struct Event {
+            Cycles when;
+            EVENT_TYPE type;
+        };
+
+        // Order by timestamp, then by type so same-cycle events fire deterministically.
+        bool Before(int a, int b) const {
+            if (this->heap[a].when != this->heap[b].when) {
+                return this->heap[a].when < this->heap[b].when;
+            }
+            return this->heap[a].type < this->heap[b].type;
+        }
+
+        void Swap(int a, int b) {
+            Event temp = this->heap[a];
+            this->heap[a] = this->heap[b];
+            this->heap[b] = temp;
+
+            this->slot[this->heap[a].type] = a;
+            this->slot[this->heap[b].type] = b;
+        }
+
+        void SiftUp(int i) {
+            while (i > 0) {
+                int parent = (i - 1) >> 1;
+                if (!Before(i, parent)) {
+                    break;
+                }
+                Swap(i, parent);
+                i = parent;
+            }
+        }
+
+        void SiftDown(int i) {
+            for (;;) {
+                int first = i;
+                int left = (i << 1) + 1;
+                int right = left + 1;
+
+                if (left < this->count && Before(left, first)) {
+                    first = left;
+                }
+                if (right < this->count && Before(right, first)) {
+                    first = right;
+                }
+                if (first == i) {
+                    break;
+                }
+                Swap(i, first);
+                i = first;
+            }
+        }
+
+        void Remove(int i) {
+            EVENT_TYPE type = this->heap[i].type;
+
+            --this->count;
+            if (i != this->count) {
+                EVENT_TYPE moved = this->heap[this->count].type;
+
+                Swap(i, this->count);
+                SiftUp(i);
+                SiftDown(this->slot[moved]);
+            }
+            this->slot[type] = -1;
+
+            this->deadline = (this->count > 0) ? this->heap[0].when : CYCLES_NEVER;
+        }
+
+        Event heap[EVENT_COUNT];
+        int slot[EVENT_COUNT]; // Heap index of each event type, -1 when not scheduled
+        int count;
+        Cycles deadline; // Cached heap[0].when
+        int speedShift; // 1 in double speed, base clock cycles are 2 CPU T-cycles
+        Cycles fence; // Events due before this set *fenceFlag, 0 when nothing is fenced
+        bool* fenceFlag;
+    };
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "Binary.h"
+
+namespace Video {
+    // OAM holds 40 sprites of 4 bytes at FE00-FE9F.
+#define OAM_START 0xFE00
+#define OAM_END 0xFEA0
+#define OAM_SPRITES 40
+
+    // Visible lines, and the most sprites drawn on one of them.
+#define SCREEN_LINES 144
+#define SPRITES_PER_LINE 10
+
+    // The sprites on each line, already in drawing priority order. The MMU marks the index dirty on
+    // OAM writes and on LCDC.OBJ_SIZE changes, and it is rebuilt the next time a line is fetched, so
+    // OAM is scanned once per change instead of once per line.
+    class SpriteIndex {
+    public:
+        SpriteIndex();
+
+        // Read sprites from oam, the host memory behind FE00-FE9F.
+        void SetOAM(const Byte* o);
+
+        // OAM was written.
+        void MarkDirty() {
+            this->dirty = true;
+        }
+
+        // Sprites are height (8 or 16) lines tall.
+        void SetHeight(int h) {
+            if (h != this->height) {
+                this->height = h;
+                this->dirty = true;
+            }
+        }
+
+        int GetHeight() const {
+            return this->height;
+        }
+
+        // On a CGB OAM order alone decides priority, X doesn't.
+        void SetCGB(bool enable) {
+            this->cgb = enable;
+            this->dirty = true;
+        }
+
+        // The OAM numbers of the sprites on line, highest priority first. count is set to how many.
+        const Byte* GetLine(int line, int& count) {
+            if (this->dirty) {
+                Rebuild();
+            }
+            count = this->counts[line];
+            return this->lists[line];
+        }
+
+    private:
+        // Bucket the first SPRITES_PER_LINE sprites of each line in OAM order, then sort each bucket by X
+        // unless this is a CGB.
+        void Rebuild();
+
+        Byte lists[SCREEN_LINES][SPRITES_PER_LINE];
+        Byte counts[SCREEN_LINES];
+        bool dirty;
+        int height;
+        bool cgb;
+
+        const Byte* oam;
+    };
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "Binary.h"
+
+#include <cstring>
+
+namespace Video {
+    // Tile data lives at 8000-97FF, 384 tiles of 16 bytes. A CGB has a second VRAM bank with 384 more,
+    // cached after the first bank's.
+#define TILE_DATA_START 0x8000
+#define TILE_DATA_END 0x9800
+#define TILE_COUNT 384
+#define TILE_BANKS 2
+
+    // Words in the dirty bitmap, one bit per tile.
+#define TILE_DIRTY_WORDS ((TILE_COUNT * TILE_BANKS + 63) / 64)
+
+    // Tile data decoded from 2bpp planes into one colour index (0-3) per pixel. The MMU marks a tile
+    // dirty on every write to its 16 bytes and dirty tiles are decoded again before the next line is
+    // drawn, so tiles that don't change are never decoded twice.
+    class TileCache {
+    public:
+        TileCache();
+
+        // Decode from the host memory behind 8000-9FFF in each VRAM bank, bank1 may be nullptr. Every
+        // tile is decoded again.
+        void SetVRAM(const Byte* bank0, const Byte* bank1 = nullptr);
+
+        // A byte of tile data at address (8000-97FF) in VRAM bank was written.
+        void MarkDirty(Word address, unsigned int bank = 0) {
+            unsigned int tile = bank * TILE_COUNT + ((address - TILE_DATA_START) >> 4);
+
+            this->dirty[tile >> 6] |= 1ULL << (tile & 63);
+            this->anyDirty = true;
+        }
+
+        // Decode the tiles written since the last call.
+        void Refresh() {
+            if (this->anyDirty) {
+                DecodeDirty();
+            }
+        }
+
+        // The 8 colour indices of row (0-7) of tile, which is past TILE_COUNT for bank 1. Only valid
+        // after Refresh.
+        const Byte* GetRow(unsigned int tile, unsigned int row) const {
+            return this->pixels[tile][row];
+        }
+
+    private:
+        // Decode every tile marked dirty and clear the marks.
+        void DecodeDirty();
+
+        // Decode the 16 bytes of tile into pixels.
+        void DecodeTile(unsigned int tile);
+
+        Byte pixels[TILE_COUNT * TILE_BANKS][8][8];
+
+        unsigned long long dirty[TILE_DIRTY_WORDS];
+        bool anyDirty;
+
+        const Byte* vram[TILE_BANKS];
+    };
+}
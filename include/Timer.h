@@ -0,0 +1,120 @@
+#pragma once
+#include "Binary.h"
+#include "Scheduler.h"
+#include "CPU.h"
+
+namespace Timing {
+    enum TIMER_IO_REGISTERS {
+        DIV = 0xFF04, // Divider, counts up at 16384Hz, writing resets it (R/W)
+        TIMA = 0xFF05, // Timer counter (R/W)
+        TMA = 0xFF06, // Timer modulo, reloaded into TIMA on overflow (R/W)
+        TAC = 0xFF07, // Timer control (R/W)
+    };
+
+    enum TAC_BITS {
+        TAC_CLOCK_SELECT = BIT0 | BIT1, // 0-1
+        TAC_ENABLE = BIT2, // 2
+    };
+
+    // DIV and TIMA are worked out from the cycle counter when read, so the only event the timer
+    // needs is the TIMA overflow.
+    class Timer {
+    public:
+        Timer() : cpu(nullptr), divBase(0), timaStart(0), timaBase(0), tma(0), tac(0) {
+        }
+
+        // Set the CPU pointer.
+        void SetCPU(Processor::Z80* p) {
+            this->cpu = p;
+        }
+
+        // Read one of the timer registers.
+        Byte Read(Word address) const {
+            Cycles now = this->cpu->GetTotalT();
+
+            switch (address) {
+            case DIV:
+            return (Byte)((now - this->divBase) >> 8);
+            case TIMA:
+            return GetTIMA(now);
+            case TMA:
+            return this->tma;
+            case TAC:
+            return this->tac | 0xF8;
+            default:
+            return 0xFF;
+            }
+        }
+
+        // Write one of the timer registers and move the overflow event to match.
+        void Write(Word address, Byte val) {
+            Cycles now = this->cpu->GetTotalT();
+
+            switch (address) {
+            case DIV:
+            this->divBase = now;
+            break;
+            case TIMA:
+            this->timaBase = val;
+            this->timaStart = now;
+            break;
+            case TMA:
+            this->tma = val;
+            break;
+            case TAC:
+            // Fold the increments so far into the base before the rate changes
+            this->timaBase = GetTIMA(now);
+            this->timaStart = now;
+            this->tac = val & (TAC_ENABLE | TAC_CLOCK_SELECT);
+            break;
+            default:
+            break;
+            }
+
+            ScheduleOverflow();
+        }
+
+        // EVENT_TIMER_OVERFLOW handler. Reload TIMA from TMA and raise the timer interrupt.
+        void Overflow(Cycles when) {
+            this->timaBase = this->tma;
+            this->timaStart = when;
+
+            this->cpu->RequestInterrupt(Processor::TIMER_OVERFLOW);
+
+            ScheduleOverflow();
+        }
+
+    private:
+        // T-cycles per TIMA increment for the selected clock.
+        Cycles GetPeriod() const {
+            static const Cycles periods[4] = { 1024, 16, 64, 256 };
+            return periods[this->tac & TAC_CLOCK_SELECT];
+        }
+
+        Byte GetTIMA(Cycles now) const {
+            if (!(this->tac & TAC_ENABLE)) {
+                return this->timaBase;
+            }
+            return (Byte)(this->timaBase + (now - this->timaStart) / GetPeriod());
+        }
+
+        void ScheduleOverflow() {
+            Scheduler& events = this->cpu->GetScheduler();
+
+            if (this->tac & TAC_ENABLE) {
+                events.Schedule(EVENT_TIMER_OVERFLOW, this->timaStart + (256 - this->timaBase) * GetPeriod());
+            }
+            else {
+                events.Cancel(EVENT_TIMER_OVERFLOW);
+            }
+        }
+
+        Processor::Z80* cpu;
+
+        Cycles divBase; // When DIV was last reset
+        Cycles timaStart; // When TIMA last held timaBase
+        Byte timaBase;
+        Byte tma;
+        Byte tac;
+    };
+}
@@ -2,7 +2,10 @@
 #include "Binary.h"
 #include "Memory.h"
 #include "CPU.h"
-#include <windows.h>
+#include "TileCache.h"
+#include "PixelKernels.h"
+#include "SpriteIndex.h"
+#include "PaletteLUT.h"
 
 namespace Video {
     // Resolution is 256x256 giving us 65536 pixels.
@@ -11,6 +14,20 @@ namespace Video {
 // Tiles are 16 bytes in size
 #define TILESIZE 16
 
+// T-cycles per scanline and per frame (154 lines including VBlank)
+#define CYCLES_PER_LINE 456
+#define CYCLES_PER_FRAME (CYCLES_PER_LINE * 154)
+
+// Tiles a scanline can touch, 20 plus one more when the fine scroll splits them
+#define LINE_TILES 21
+
+    // What a call to DMG::Step completed.
+    enum PPU_STEP_RESULT {
+        PPU_STEP_NONE = 0,
+        PPU_STEP_VBLANK = BIT0, // Entered VBlank, the frame image is finished
+        PPU_STEP_FRAME = BIT1, // Left VBlank, the next frame starts at line 0
+    };
+
     enum VIDEO_IO_REGISTERS {
         // Drawing related registers
         LCDC = 0xFF40, // LCD Control (R/W)
@@ -90,15 +107,44 @@ namespace Video {
         FLAG_OBJ_TO_BG = 0x80000000, // 4.7
     };
 
+    // CGB BG map attributes, kept in VRAM bank 1 at the same offset as the tile number.
+    enum BG_MAP_ATTRIBUTES {
+        BG_PALETTE_NUM = 0x07, // 0-2
+        BG_TILE_VRAM_BANK = BIT3, // 3
+        BG_X_FLIP = BIT5, // 5
+        BG_Y_FLIP = BIT6, // 6
+        BG_PRIORITY = BIT7, // 7
+    };
+
+    // CGB palette index registers (BGPI/OBPI).
+    enum PALETTE_INDEX_BITS {
+        PALETTE_INDEX_ADDRESS = 0x3F, // 0-5
+        PALETTE_INDEX_INCREMENT = BIT7, // 7
+    };
+
+    // Bytes of CGB palette memory for the BG and again for sprites, 8 palettes of 4 15-bit colours.
+#define CGB_PALETTE_RAM_SIZE 64
+
     class DMG {
     public:
-        DMG(void) {
-            this->screen = new char[92160];
+        // Frames are drawn in format, see GetScreen.
+        DMG(PIXEL_FORMAT format = PIXEL_RGBA8888) : palettes(format) {
+            this->screen = new Byte[160 * SCREEN_LINES * this->palettes.GetPixelSize()];
             this->line = 0;
             this->mode = 0;
-            this->modeclock = 0;
+            this->lyc = 0;
+            this->statSelect = 0;
             this->scx = 0;
             this->scy = 0;
+            this->wy = 0;
+            this->wx = 0;
+            this->windowLine = 0;
+            this->frameSkip = 1;
+            this->frameCount = 0;
+            this->render = true;
+            this->cgb = false;
+            memset(this->paletteIndex, 0, sizeof(this->paletteIndex));
+            memset(this->paletteRAM, 0xFF, sizeof(this->paletteRAM));
             this->lcdc = LCD_DISPLAY_ENABLE | BKGD_WND_TILE_DATA_SELECT | BKGD_DISPLAY_ENABLE;
         }
 
@@ -108,12 +154,32 @@ namespace Video {
 
         void SetRAM(Memory::MMU* r) {
             this->ram = r;
+            this->ram->SetTileCache(&this->tiles);
+            this->ram->SetSpriteIndex(&this->sprites);
+
+            // Registers the PPU reacts to or computes
+            this->ram->MapIO(LCDC, nullptr, &WriteLCDC, this);
+            this->ram->MapIO(STAT, &ReadSTAT, &WriteSTAT, this);
+            this->ram->MapIO(LY, &ReadLY, nullptr, this);
+            this->ram->MapIO(LYC, nullptr, &WriteLYC, this);
+            this->ram->MapIO(DMA, nullptr, &WriteDMA, this);
+
+            // CGB only registers, plain bytes on a DMG
+            bool cgb = this->cgb;
+            this->ram->MapIO(VBK, cgb ? &ReadVBK : nullptr, cgb ? &WriteVBK : nullptr, this);
+            this->ram->MapIO(HMDA5, cgb ? &ReadHDMA5 : nullptr, cgb ? &WriteHDMA5 : nullptr, this);
+            for (Word address = BGPI; address <= OBPD; address += 2) {
+                this->ram->MapIO(address, cgb ? &ReadPaletteIndex : nullptr, cgb ? &WritePaletteIndex : nullptr, this);
+                this->ram->MapIO(address + 1, cgb ? &ReadPaletteData : nullptr, cgb ? &WritePaletteData : nullptr, this);
+            }
+            this->ram->MapIO(BGP, nullptr, &WritePalette, this);
+            this->ram->MapIO(OBP0, nullptr, &WritePalette, this);
+            this->ram->MapIO(OPB1, nullptr, &WritePalette, this);
 
             // Store the current state in registers
             this->ram->WriteByte(LCDC, this->lcdc);
             this->ram->WriteByte(SCX, this->scx);
             this->ram->WriteByte(SCY, this->scy);
-            this->ram->WriteByte(LY, this->line);
             this->ram->WriteByte(BGP, 0xFC);
             this->ram->WriteByte(OBP0, 0xFF);
             this->ram->WriteByte(OPB1, 0xFF);
@@ -121,24 +187,144 @@ namespace Video {
             this->ram->WriteByte(WX, 0x00);
         }
 
-        // Set the CPU pointer.
+        // Set the CPU pointer and start the mode sequence on its clock.
         void SetCPU(Processor::Z80* p) {
             this->cpu = p;
+
+            Timing::Scheduler& events = this->cpu->GetScheduler();
+            events.Schedule(Timing::EVENT_PPU_MODE, events.After(this->cpu->GetTotalT(), 204));
+        }
+
+        // Draw as a CGB: BG map attributes, colour palettes and sprite priority by OAM order. Call before
+        // SetRAM, which maps the CGB registers.
+        void SetCGB(bool enable) {
+            this->cgb = enable;
+            this->sprites.SetCGB(enable);
+
+            // Palette memory starts out white
+            memset(this->paletteIndex, 0, sizeof(this->paletteIndex));
+            memset(this->paletteRAM, 0xFF, sizeof(this->paletteRAM));
+            for (int palette = PALETTE_CGB_BG; palette < PALETTE_TOTAL; palette++) {
+                for (int i = 0; i < 4; i++) {
+                    this->palettes.SetColor(palette, i, 0x7FFF);
+                }
+            }
+        }
+
+        // The last frame drawn, 160x144 pixels of the format given at construction, rows top to bottom.
+        const Byte* GetScreen() const {
+            return this->screen;
+        }
+
+        PIXEL_FORMAT GetPixelFormat() const {
+            return this->palettes.GetFormat();
+        }
+
+        // Draw 1 in every n frames, none if n is 0. Skipped frames keep the exact mode timing and
+        // interrupts, only the pixel work is dropped. Takes effect from the next frame.
+        void SetFrameSkip(unsigned int n) {
+            this->frameSkip = n;
         }
 
-        Word GetTileData(int tileID, int row) {
-            unsigned int offset = ((this->lcdc & BKGD_WND_TILE_DATA_SELECT) ? TILEPALLET1 : TILEPALLET2);
-            // If LCDCONT.BKGD_WND_TILE_DATA_SELECT is 0 add an offset of 0x8FFF.
-            Word ret = this->ram->ReadWord(offset + tileID * TILESIZE + row * 2);
-            return ret;
+        // Tile cache index of a tile number from the BG/window map. With LCDCONT.BKGD_WND_TILE_DATA_SELECT
+        // clear the number is signed and relative to 0x9000.
+        unsigned int GetTileIndex(Byte tileID) const {
+            if (this->lcdc & BKGD_WND_TILE_DATA_SELECT) {
+                return tileID;
+            }
+            return (unsigned int)(256 + (signed char)tileID);
         }
 
+        // Draw the current line: background, window, then sprites.
         void UpdateScreen() {
             this->scx = this->ram->ReadByte(SCX);
             this->scy = this->ram->ReadByte(SCY);
-            this->pallet = this->ram->ReadByte(BGP);
+            this->wy = this->ram->ReadByte(WY);
+            this->wx = this->ram->ReadByte(WX);
+
+            // Decode whatever tile data changed since the last line
+            this->tiles.Refresh();
+
+            // BG and window colour indices, with room either side for tiles that straddle the edges. On a
+            // CGB attributes holds the map attributes of every pixel at the same offsets.
+            Byte indices[8 + LINE_TILES * 8 + 8];
+            Byte attributes[8 + LINE_TILES * 8 + 8];
+            Byte* bg = &indices[8 + (this->scx & 7)];
+            Byte* attrs = &attributes[8 + (this->scx & 7)];
+
+            // A CGB always draws the BG, BKGD_DISPLAY_ENABLE only takes its priority over sprites away
+            if ((this->lcdc & BKGD_DISPLAY_ENABLE) || this->cgb) {
+                DrawBackground(&indices[8], &attributes[8]);
+                DrawWindow(bg, attrs);
+            }
+            else {
+                // Blank BG, sprites are still drawn over it
+                memset(bg, 0, 160);
+            }
+
+            unsigned int size = this->palettes.GetPixelSize();
+            Byte* out = &this->screen[this->line * 160 * size];
+
+            if (this->cgb) {
+                ComposeCGB(bg, attrs, out);
+            }
+            else {
+                ComposePixels(bg, this->palettes.Get(PALETTE_BG), out, 160, size);
+            }
+
+            if (this->lcdc & OBJ_DISPLAY_ENABLE) {
+                DrawSprites(bg, attrs, out);
+            }
+        }
+
+        // Copy the colour indices of row of the tile at map entry address to dest. On a CGB the entry's
+        // attributes pick the bank and flips, and are copied to attrs for each pixel.
+        void FetchTile(Word address, int row, Byte* dest, Byte* attrs) {
+            unsigned int tile = GetTileIndex(this->ram->ReadVideo(address));
 
-            int yoffs = (this->lcdc & BKGD_TILEMAP_DISPLAY_SELECT) ? 0x1C00 : 0x1800;
+            if (!this->cgb) {
+                memcpy(dest, this->tiles.GetRow(tile, row), 8);
+                return;
+            }
+
+            Byte flags = this->ram->ReadVideo(address, 1);
+            if (flags & BG_TILE_VRAM_BANK) {
+                tile += TILE_COUNT;
+            }
+
+            const Byte* pixels = this->tiles.GetRow(tile, (flags & BG_Y_FLIP) ? 7 - row : row);
+            if (flags & BG_X_FLIP) {
+                for (int x = 0; x < 8; x++) {
+                    dest[x] = pixels[7 - x];
+                }
+            }
+            else {
+                memcpy(dest, pixels, 8);
+            }
+            memset(attrs, flags, 8);
+        }
+
+        // Compose the line in runs of pixels sharing a CGB BG palette.
+        void ComposeCGB(const Byte* bg, const Byte* attrs, Byte* out) {
+            unsigned int size = this->palettes.GetPixelSize();
+
+            for (int x = 0; x < 160;) {
+                int palette = attrs[x] & BG_PALETTE_NUM;
+                int run = 1;
+
+                while (x + run < 160 && (attrs[x + run] & BG_PALETTE_NUM) == palette) {
+                    run++;
+                }
+
+                ComposePixels(&bg[x], this->palettes.Get(PALETTE_CGB_BG + palette), &out[x * size], run, size);
+                x += run;
+            }
+        }
+
+        // Gather the colour indices of the LINE_TILES tiles the line touches from the BG map, the line
+        // itself starts at the fine scroll offset into dest. attrs gets the CGB attributes likewise.
+        void DrawBackground(Byte* dest, Byte* attrs) {
+            int yoffs = (this->lcdc & BKGD_TILEMAP_DISPLAY_SELECT) ? BGMAP2_START : BGMAP1_START;
 
             // Which line of tiles to use in the map
             yoffs += (((this->line + this->scy) & 255) >> 3) << 5;
@@ -149,130 +335,281 @@ namespace Video {
             // Which line of pixels to use in the tiles
             int row = (this->line + this->scy) & 7;
 
-            // Where in the tileline to start
-            int column = this->scx & 7;
-
-            int canvasoffs = this->line * 160 * 4;
-
-            // Read tile index from the background map
-            Byte tile = this->ram->ReadByte(yoffs + xoffs);
-
-            int color[4] = { this->pallet & 0x03, this->pallet & 0x0C, this->pallet & 0x30, this->pallet & 0xC0 };
-
-            Word tileData[8] = { GetTileData(tile, 0),
-                GetTileData(tile, 1),
-                GetTileData(tile, 2),
-                GetTileData(tile, 3),
-                GetTileData(tile, 4),
-                GetTileData(tile, 5),
-                GetTileData(tile, 6),
-                GetTileData(tile, 7) };
-
-            for (int i = 0; i < 160; i++) {
-                // Plot the pixel to canvas
-                this->screen[canvasoffs + 0] = color[0];
-                this->screen[canvasoffs + 1] = color[0];
-                this->screen[canvasoffs + 2] = color[0];
-                this->screen[canvasoffs + 3] = color[0];
-                canvasoffs += 4;
-
-                // When this tile ends, read another
-                column++;
-                if (column == 8) {
-                    column = 0;
-                    xoffs = (xoffs + 1) & 0x1F;
-                    tile = this->ram->ReadByte(yoffs + xoffs);
-                    tileData[0] = GetTileData(tile, 0);
-                    tileData[1] = GetTileData(tile, 1);
-                    tileData[2] = GetTileData(tile, 2);
-                    tileData[3] = GetTileData(tile, 3);
-                    tileData[4] = GetTileData(tile, 4);
-                    tileData[5] = GetTileData(tile, 5);
-                    tileData[6] = GetTileData(tile, 6);
-                    tileData[7] = GetTileData(tile, 7);
-                }
+            for (int i = 0; i < LINE_TILES; i++) {
+                FetchTile(yoffs + ((xoffs + i) & 0x1F), row, &dest[i * 8], &attrs[i * 8]);
             }
         }
 
-        void Step() {
-            this->lcdc = this->ram->ReadByte(LCDC);
-            static int lastT = 0;
-            this->modeclock += this->cpu->GetTotalT() - lastT;
-            lastT = this->cpu->GetTotalT();
+        // Cover bg from WX-7 to the right edge with the window. The window has its own line counter
+        // that only advances on lines it is drawn on.
+        void DrawWindow(Byte* bg, Byte* attrs) {
+            if (!(this->lcdc & WND_DISPLAY_ENABLE) || this->line < this->wy || this->wx > 166) {
+                return;
+            }
 
-            switch (this->mode) {
-            case MODE_FLAG_HBLANK:
-            if (this->modeclock >= 204) {
-                this->line++;
-
-                if (this->line == 143) {
-                    Byte interrupts = this->ram->ReadByte(0xFFFF);
-                    if (interrupts & Processor::INTERRUPTS::VBLANK) {
-                        Byte interruptsFlag = this->ram->ReadByte(0xFF0F);
-                        this->ram->WriteByte(0xFF0F, interruptsFlag |= Processor::INTERRUPTS::VBLANK);
+            int yoffs = (this->lcdc & WND_TILEMAP_DISPLAY_SELECT) ? BGMAP2_START : BGMAP1_START;
+            yoffs += (this->windowLine >> 3) << 5;
+            int row = this->windowLine & 7;
+
+            // WX below 7 starts the window left of the screen, bg has room for that
+            for (int x = this->wx - 7, i = 0; x < 160; x += 8, i++) {
+                FetchTile(yoffs + i, row, &bg[x], &attrs[x]);
+            }
+
+            this->windowLine++;
+        }
+
+        // Draw the sprites on the line over the composed pixels in out. bg holds the BG/window colour
+        // indices, sprites flagged FLAG_OBJ_TO_BG only show over index 0. On a CGB so do all sprites over
+        // BG tiles with BG_PRIORITY in attrs, unless BKGD_DISPLAY_ENABLE is clear.
+        void DrawSprites(const Byte* bg, const Byte* attrs, Byte* out) {
+            int height = this->sprites.GetHeight();
+            int count = 0;
+            const Byte* list = this->sprites.GetLine(this->line, count);
+
+            if (count == 0) {
+                return;
+            }
+
+            unsigned int size = this->palettes.GetPixelSize();
+
+            // Pixels already claimed by a sprite of higher priority, even one hidden behind the BG
+            bool taken[160];
+            memset(taken, 0, sizeof(taken));
+
+            for (int i = 0; i < count; i++) {
+                Word entry = OAM_TABLE + list[i] * 4;
+                unsigned int sprite = this->ram->ReadVideo(entry) | (this->ram->ReadVideo(entry + 1) << 8) |
+                    (this->ram->ReadVideo(entry + 2) << 16) | ((unsigned int)this->ram->ReadVideo(entry + 3) << 24);
+                int x = (int)((sprite & X_POSITION) >> 8) - 8;
+                int row = this->line - ((int)(sprite & Y_POSITION) - 16);
+                unsigned int tile = (sprite & TILEPATTERN_NUMBER) >> 16;
+
+                if (sprite & FLAG_Y_FLIP) {
+                    row = height - 1 - row;
+                }
+                // 8x16 sprites ignore bit 0 of the tile number
+                if (height == 16) {
+                    tile = (tile & 0xFE) + (row >> 3);
+                }
+
+                const unsigned int* palette;
+                if (this->cgb) {
+                    palette = this->palettes.Get(PALETTE_CGB_OBJ + ((sprite >> 24) & 0x07));
+                    if (sprite & FLAG_TILE_VRAM_BANK) {
+                        tile += TILE_COUNT;
                     }
-                    this->mode = MODE_FLAG_VBLANK;
-                    this->ram->WriteByte(STAT, 0xFF & (MODE_FLAG_HBLANK | MODE1_VBLANK));
                 }
                 else {
-                    this->mode = MODE_FLAG_OAM_SEARCH;
-                    this->ram->WriteByte(STAT, 0xFF & (MODE_FLAG_OAM_SEARCH | MODE2_OAM));
+                    palette = this->palettes.Get((sprite & FLAG_PALETTE_NUM) ? PALETTE_OBJ1 : PALETTE_OBJ0);
+                }
+
+                const Byte* pixels = this->tiles.GetRow(tile, row & 7);
+
+                for (int px = 0; px < 8; px++) {
+                    int sx = x + px;
+                    Byte index = pixels[(sprite & FLAG_X_FLIP) ? (7 - px) : px];
+
+                    if (sx < 0 || sx >= 160 || index == 0 || taken[sx]) {
+                        continue;
+                    }
+                    taken[sx] = true;
+
+                    bool behind = (sprite & FLAG_OBJ_TO_BG) != 0;
+                    if (this->cgb) {
+                        // BKGD_DISPLAY_ENABLE clear puts every sprite on top
+                        behind = (behind || (attrs[sx] & BG_PRIORITY)) && (this->lcdc & BKGD_DISPLAY_ENABLE);
+                    }
+                    if (behind && bg[sx] != 0) {
+                        continue;
+                    }
+                    StorePixel(&out[sx * size], palette[index], size);
                 }
-                this->ram->WriteByte(LY, this->line);
-                this->modeclock -= 204;
+            }
+        }
+
+        // EVENT_PPU_MODE handler. Move to the next mode and schedule the end of it. Returns PPU_STEP_RESULT bits.
+        int Step(Timing::Cycles when) {
+            int length = 0; // T-cycles the new mode lasts
+            int result = PPU_STEP_NONE;
+
+            switch (this->mode) {
+            case MODE_FLAG_HBLANK:
+            this->line++;
+
+            if (this->line == SCREEN_LINES) {
+                this->cpu->RequestInterrupt(Processor::INTERRUPTS::VBLANK);
+                this->mode = MODE_FLAG_VBLANK;
+                length = CYCLES_PER_LINE;
+                result = PPU_STEP_VBLANK;
+            }
+            else {
+                this->mode = MODE_FLAG_OAM_SEARCH;
+                length = 80;
             }
             break;
             case MODE_FLAG_VBLANK:
-            if (this->modeclock >= 456) {
-                this->line++;
-
-                if (this->line > 153) {
-                    // Restart scanning modes
-                    this->mode = MODE_FLAG_OAM_SEARCH;
-                    this->ram->WriteByte(STAT, 0xFF & (MODE_FLAG_OAM_SEARCH | MODE2_OAM));
-                    this->line = 0;
-                }
-                this->ram->WriteByte(LY, this->line);
-                this->modeclock -= 456;
+            this->line++;
+            length = CYCLES_PER_LINE;
+
+            if (this->line > 153) {
+                // Restart scanning modes
+                this->mode = MODE_FLAG_OAM_SEARCH;
+                this->line = 0;
+                this->windowLine = 0;
+                length = 80;
+
+                this->frameCount++;
+                this->render = (this->frameSkip != 0) && (this->frameCount % this->frameSkip == 0);
+                result = PPU_STEP_FRAME;
             }
             break;
             case MODE_FLAG_OAM_SEARCH:
-            if (this->modeclock >= 80) {
-                this->mode = MODE_FLAG_LCD_TRANSFER;
-                this->ram->WriteByte(STAT, 0xFF & MODE_FLAG_LCD_TRANSFER);
-                this->modeclock -= 80;
-            }
+            this->mode = MODE_FLAG_LCD_TRANSFER;
+            length = 172;
             break;
             case MODE_FLAG_LCD_TRANSFER:
-            if (this->modeclock >= 172) {
-                this->mode = MODE_FLAG_HBLANK;
-                this->ram->WriteByte(STAT, 0xFF & (MODE_FLAG_HBLANK | MODE0_HBLANK));
-                this->modeclock -= 172;
+            this->mode = MODE_FLAG_HBLANK;
+            length = 204;
 
+            if (this->render) {
                 UpdateScreen();
             }
+
+            // The HBlank DMA copies its next block at the start of every HBlank
+            if (this->cgb && this->ram->IsHDMAActive()) {
+                this->cpu->GetScheduler().Schedule(Timing::EVENT_HDMA, when);
+            }
             break;
             default:
             break;
             }
-            this->ram->WriteByte(STAT, this->lcdc);
+
+            // Mode lengths are in base clock cycles, the scheduler turns them into CPU cycles
+            Timing::Scheduler& events = this->cpu->GetScheduler();
+            events.Schedule(Timing::EVENT_PPU_MODE, events.After(when, length));
+
+            return result;
         }
 
 
     private:
-        char* screen;
+        // IO register handlers, see Memory::MMU::MapIO.
+        static void WriteLCDC(void* device, Word address, Byte val) {
+            DMG* dmg = (DMG*)device;
+
+            dmg->lcdc = val;
+            dmg->sprites.SetHeight((val & OBJ_SIZE) ? 16 : 8);
+        }
+
+        // Mode and coincidence come from the PPU state, bits 3-6 are what was last written.
+        static Byte ReadSTAT(void* device, Word address) {
+            DMG* dmg = (DMG*)device;
+
+            return 0x80 | dmg->statSelect | ((dmg->line == dmg->lyc) ? COINCIDENCE_FLAG : 0) | dmg->mode;
+        }
+
+        static void WriteSTAT(void* device, Word address, Byte val) {
+            ((DMG*)device)->statSelect = val & (MODE0_HBLANK | MODE1_VBLANK | MODE2_OAM | LYC_IS_LY_COINCIDENCE);
+        }
+
+        static Byte ReadLY(void* device, Word address) {
+            return ((DMG*)device)->line;
+        }
+
+        static void WriteLYC(void* device, Word address, Byte val) {
+            ((DMG*)device)->lyc = val;
+        }
+
+        static void WriteDMA(void* device, Word address, Byte val) {
+            ((DMG*)device)->ram->StartDMA(val);
+        }
+
+        static void WritePalette(void* device, Word address, Byte val) {
+            ((DMG*)device)->palettes.SetRegister(address - BGP, val);
+        }
+
+        static Byte ReadVBK(void* device, Word address) {
+            return 0xFE | ((DMG*)device)->ram->GetVRAMBank();
+        }
+
+        static void WriteVBK(void* device, Word address, Byte val) {
+            ((DMG*)device)->ram->SetVRAMBank(val);
+        }
+
+        static Byte ReadHDMA5(void* device, Word address) {
+            return ((DMG*)device)->ram->GetHDMAStatus();
+        }
+
+        // Source and destination come from HDMA1-4, the low 4 bits are ignored and the destination is
+        // always in VRAM.
+        static void WriteHDMA5(void* device, Word address, Byte val) {
+            Memory::MMU* ram = ((DMG*)device)->ram;
+            Word source = ((ram->ReadByte(HMDA1) << 8) | ram->ReadByte(HMDA2)) & 0xFFF0;
+            Word dest = 0x8000 | (((ram->ReadByte(HMDA3) << 8) | ram->ReadByte(HMDA4)) & 0x1FF0);
+
+            ram->StartHDMA(source, dest, (val & 0x7F) + 1, (val & BIT7) != 0);
+        }
 
-        char tiles[512][8][8];
+        // BGPI/BGPD and OBPI/OBPD work the same on their own palette memory, 0 for the BG and 1 for sprites.
+        static Byte ReadPaletteIndex(void* device, Word address) {
+            return 0x40 | ((DMG*)device)->paletteIndex[(address - BGPI) >> 1];
+        }
+
+        static void WritePaletteIndex(void* device, Word address, Byte val) {
+            ((DMG*)device)->paletteIndex[(address - BGPI) >> 1] = val & (PALETTE_INDEX_ADDRESS | PALETTE_INDEX_INCREMENT);
+        }
+
+        static Byte ReadPaletteData(void* device, Word address) {
+            DMG* dmg = (DMG*)device;
+            int which = (address - BGPD) >> 1;
+
+            return dmg->paletteRAM[which][dmg->paletteIndex[which] & PALETTE_INDEX_ADDRESS];
+        }
+
+        static void WritePaletteData(void* device, Word address, Byte val) {
+            DMG* dmg = (DMG*)device;
+            int which = (address - BGPD) >> 1;
+            Byte& index = dmg->paletteIndex[which];
+            int offset = index & PALETTE_INDEX_ADDRESS;
+
+            dmg->paletteRAM[which][offset] = val;
+
+            // Colours are 2 bytes, low byte first
+            const Byte* color = &dmg->paletteRAM[which][offset & ~1];
+            dmg->palettes.SetColor((which ? PALETTE_CGB_OBJ : PALETTE_CGB_BG) + (offset >> 3), (offset >> 1) & 0x03, color[0] | (color[1] << 8));
+
+            if (index & PALETTE_INDEX_INCREMENT) {
+                index = PALETTE_INDEX_INCREMENT | ((offset + 1) & PALETTE_INDEX_ADDRESS);
+            }
+        }
+
+        Byte* screen;
+
+        TileCache tiles; // Decoded tile data, kept up to date by the MMU
+        SpriteIndex sprites; // Sprites on each line, kept up to date by the MMU
+        PaletteLUT palettes; // Final pixel values of BGP/OBP0/OBP1 and the CGB palettes, kept up to date by the MMU
 
         Memory::MMU* ram;
         Processor::Z80* cpu;
 
         Byte mode;
-        int modeclock;
         Byte line;
+        Byte lyc;
+        Byte statSelect; // STAT interrupt select bits 3-6
         Byte lcdc;
         Byte scy;
         Byte scx;
-        Byte pallet;
+        Byte wy;
+        Byte wx;
+        Byte windowLine; // Window line drawn next
+
+        unsigned int frameSkip; // Draw 1 in this many frames, 0 for none
+        unsigned int frameCount; // Frames started
+        bool render; // Draw the current frame
+
+        bool cgb; // Draw as a CGB
+        Byte paletteIndex[2]; // BGPI and OBPI
+        Byte paletteRAM[2][CGB_PALETTE_RAM_SIZE]; // BG and sprite palette memory, read through BGPD/OBPD
     };
 }
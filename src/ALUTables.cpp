@@ -0,0 +1,25 @@
+#include "../include/ALUTables.h"
+
+namespace Processor {
+    ALUBinaryTable::ALUBinaryTable(ALU_TABLE_OP op) {
+        for (unsigned int i = 0; i < ALU_BINARY_SIZE; ++i) {
+            this->entry[i] = ALUEntry(op, i);
+        }
+    }
+
+    const ALUBinaryTable addTable(ALU_ADD);
+    const ALUBinaryTable subTable(ALU_SUB);
+    constexpr ALUTable<ALU_UNARY_SIZE> incTable(ALU_INC);
+    constexpr ALUTable<ALU_UNARY_SIZE> decTable(ALU_DEC);
+    constexpr ALUTable<ALU_DAA_SIZE> daaTable(ALU_DAA);
+
+    // Spot checks of the cases that are easy to get wrong.
+    static_assert(ALUEntry(ALU_ADD, ALU_BINARY_INDEX(0x0F, 0x01, 0)) == 0x1020, "ADD 0F+01 sets H only");
+    static_assert(ALUEntry(ALU_ADD, ALU_BINARY_INDEX(0xFF, 0x00, 1)) == 0x00B0, "ADC FF+00+1 sets Z, H and C");
+    static_assert(ALUEntry(ALU_SUB, ALU_BINARY_INDEX(0x10, 0x01, 0)) == 0x0F60, "SUB 10-01 sets N and H");
+    static_assert(ALUEntry(ALU_SUB, ALU_BINARY_INDEX(0x00, 0x00, 1)) == 0xFF70, "SBC 00-00-1 sets N, H and C");
+    static_assert(ALUEntry(ALU_SUB, ALU_BINARY_INDEX(0x3C, 0x3C, 0)) == 0x00C0, "CP of equal values sets Z and N");
+    static_assert(incTable.entry[0xFF] == 0x00A0, "INC FF sets Z and H");
+    static_assert(decTable.entry[0x01] == 0x00C0, "DEC 01 sets Z and N");
+    static_assert(daaTable.entry[ALU_DAA_INDEX(0x9A, 0)] == 0x0090, "DAA 9A gives 00 with Z and C");
+}
@@ -0,0 +1,270 @@
+#include "../include/BlockCache.h"
+
+#include "../include/CPU.h"
+#include "../include/Timer.h"
+
+namespace Processor {
+    // Op length in bytes (including the CB prefix) and whether the op ends a block.
+#define OP_LENGTH 0x03
+#define OP_END 0x04
+
+    static const Byte opInfo[256] = {
+        /* 00 */ 1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,
+        /* 10 */ 1 | OP_END, 3, 1, 1, 1, 1, 2, 1, 2 | OP_END, 1, 1, 1, 1, 1, 2, 1,
+        /* 20 */ 2 | OP_END, 3, 1, 1, 1, 1, 2, 1, 2 | OP_END, 1, 1, 1, 1, 1, 2, 1,
+        /* 30 */ 2 | OP_END, 3, 1, 1, 1, 1, 2, 1, 2 | OP_END, 1, 1, 1, 1, 1, 2, 1,
+        /* 40 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* 50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* 60 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* 70 */ 1, 1, 1, 1, 1, 1, 1 | OP_END, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* 80 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* 90 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* A0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* B0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* C0 */ 1 | OP_END, 1, 3 | OP_END, 3 | OP_END, 3 | OP_END, 1, 2, 1 | OP_END, 1 | OP_END, 1 | OP_END, 3 | OP_END, 2, 3 | OP_END, 3 | OP_END, 2, 1 | OP_END,
+        /* D0 */ 1 | OP_END, 1, 3 | OP_END, 1, 3 | OP_END, 1, 2, 1 | OP_END, 1 | OP_END, 1 | OP_END, 3 | OP_END, 1, 3 | OP_END, 1, 2, 1 | OP_END,
+        /* E0 */ 2, 1, 1, 1, 1, 1, 2, 1 | OP_END, 2, 1 | OP_END, 3, 1, 1, 1, 2, 1 | OP_END,
+        /* F0 */ 2, 1, 1, 1, 1, 1, 2, 1 | OP_END, 2, 1, 3, 1, 1, 1, 2, 1 | OP_END,
+    };
+
+    // Whether op can be part of an idle loop: it may only read memory and write A-E and F. Adds
+    // IDLE_LOOP_READS_HL to idle for reads of (HL). DIV and TIMA count without scheduled events, so
+    // loops polling them are left alone.
+    static bool IsIdleOp(const DecodedOp& op, Byte& idle) {
+        Byte code = op.op;
+
+        if (op.prefix == 2) {
+            // BIT b, r
+            if (code < 0x40 || code >= 0x80) {
+                return false;
+            }
+            if ((code & 0x07) == 0x06) {
+                idle |= IDLE_LOOP_READS_HL;
+            }
+            return true;
+        }
+
+        // LD r, r' / LD r, (HL) with r not H, L or (HL)
+        if (code >= 0x40 && code < 0x80) {
+            int dst = (code >> 3) & 7;
+            if (dst == REG_H || dst == REG_L || dst == 6) {
+                return false;
+            }
+            if ((code & 0x07) == 0x06) {
+                idle |= IDLE_LOOP_READS_HL;
+            }
+            return true;
+        }
+
+        // ALU A, r / ALU A, (HL)
+        if (code >= 0x80 && code < 0xC0) {
+            if ((code & 0x07) == 0x06) {
+                idle |= IDLE_LOOP_READS_HL;
+            }
+            return true;
+        }
+
+        switch (code) {
+        case 0x00: // NOP
+        case 0x04: case 0x05: case 0x06: case 0x0C: case 0x0D: case 0x0E: // INC/DEC/LD B and C
+        case 0x14: case 0x15: case 0x16: case 0x1C: case 0x1D: case 0x1E: // INC/DEC/LD D and E
+        case 0x3C: case 0x3D: case 0x3E: // INC/DEC/LD A
+        case 0x07: case 0x0F: case 0x17: case 0x1F: // Rotates of A
+        case 0x2F: case 0x37: case 0x3F: // CPL, SCF, CCF
+        case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: // ALU A, n
+        return true;
+        case 0xF0: // LDH A, (n)
+        return op.imm != (Timing::DIV & 0xFF) && op.imm != (Timing::TIMA & 0xFF);
+        case 0xFA: // LD A, (nn)
+        return op.imm != Timing::DIV && op.imm != Timing::TIMA;
+        default:
+        return false;
+        }
+    }
+
+    // Work out the IDLE_LOOP_BITS of a decoded block.
+    static Byte ClassifyIdle(const Block& block) {
+        Byte idle = IDLE_LOOP;
+        Word address = block.pc;
+        size_t last = block.ops.size() - 1;
+
+        for (size_t i = 0; i < last; ++i) {
+            if (!IsIdleOp(block.ops[i], idle)) {
+                return 0;
+            }
+            address += block.ops[i].length;
+        }
+
+        // Must end in a jump back to the start
+        const DecodedOp& branch = block.ops[last];
+        Word next = address + branch.length;
+
+        switch (branch.op) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR (cc), e
+        return (Word)(next + (signed char)branch.imm) == block.pc ? idle : 0;
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: // JP (cc), nn
+        return branch.imm == block.pc ? idle : 0;
+        default:
+        return 0;
+        }
+    }
+
+    BlockCache::BlockCache() : ram(nullptr) {
+        memset(this->hostCache, 0, sizeof(this->hostCache));
+        memset(this->pageCache, 0, sizeof(this->pageCache));
+    }
+
+    BlockCache::~BlockCache() {
+        FreeRetired();
+
+        for (auto& it : this->pages) {
+            for (Block* block : it.second->blocks) {
+                delete block;
+            }
+            delete it.second;
+        }
+    }
+
+    void BlockCache::SetMMU(Memory::MMU* r) {
+        this->ram = r;
+    }
+
+    Block* BlockCache::Miss(Word pc, const Byte* host) {
+        Byte index = pc >> PAGE_SHIFT;
+
+        // Not cacheable, run it one op at a time
+        if (host == nullptr) {
+            Decode(pc, pc + 3, 1, this->scratch);
+            return &this->scratch;
+        }
+
+        if (this->hostCache[index] != host) {
+            this->hostCache[index] = host;
+            this->pageCache[index] = GetPage(host);
+        }
+
+        CodePage* page = this->pageCache[index];
+        Block* found = page->entry[pc & PAGE_MASK];
+        if (found != nullptr) {
+            return found;
+        }
+
+        // Blocks never run past the end of their page, so a write to one page can't leave a stale op
+        // behind in a block owned by another. IE (FFFF) isn't code.
+        unsigned int end = ((unsigned int)index + 1) << PAGE_SHIFT;
+        if (end > 0xFFFF) {
+            end = 0xFFFF;
+        }
+
+        Block* block = new Block();
+        if (!Decode(pc, end, BLOCK_MAX_OPS, *block)) {
+            // The first op straddles the end of the page
+            delete block;
+            Decode(pc, pc + 3, 1, this->scratch);
+            return &this->scratch;
+        }
+
+        page->entry[pc & PAGE_MASK] = block;
+        page->blocks.push_back(block);
+
+        // Have the MMU tell us when the page is written
+        this->ram->WatchCode(pc);
+
+        return block;
+    }
+
+    bool BlockCache::Decode(Word pc, unsigned int end, unsigned int maxOps, Block& block) const {
+        unsigned int address = pc;
+
+        block.pc = pc;
+        block.ops.clear();
+        block.hits = 0;
+        block.native = nullptr;
+
+        while (block.ops.size() < maxOps) {
+            Byte op = this->ram->ReadByte(address);
+            Byte info = opInfo[op];
+            unsigned int length = info & OP_LENGTH;
+
+            if (address + length > end) {
+                break;
+            }
+
+            DecodedOp decoded;
+            decoded.length = length;
+            if (op == 0xCB) {
+                decoded.op = this->ram->ReadByte(address + 1);
+                decoded.handler = Z80::cbTable[decoded.op];
+                decoded.imm = 0;
+                decoded.prefix = 2;
+            }
+            else {
+                decoded.op = op;
+                decoded.handler = Z80::opTable[op];
+                decoded.prefix = 1;
+
+                if (length == 3) {
+                    decoded.imm = this->ram->ReadWord(address + 1);
+                }
+                else if (length == 2) {
+                    decoded.imm = this->ram->ReadByte(address + 1);
+                }
+                else {
+                    decoded.imm = 0;
+                }
+            }
+
+            block.ops.push_back(decoded);
+            address += length;
+
+            if (info & OP_END) {
+                break;
+            }
+        }
+
+        if (block.ops.empty()) {
+            return false;
+        }
+
+        block.cycles = (unsigned int)block.ops.size() * BLOCK_MAX_OP_CYCLES;
+        block.idle = (block.ops.back().prefix == 1) ? ClassifyIdle(block) : 0;
+
+        return true;
+    }
+
+    void BlockCache::Invalidate(const Byte* host) {
+        auto it = this->pages.find(host);
+        if (it == this->pages.end()) {
+            return;
+        }
+
+        CodePage* page = it->second;
+        memset(page->entry, 0, sizeof(page->entry));
+        this->retired.insert(this->retired.end(), page->blocks.begin(), page->blocks.end());
+        page->blocks.clear();
+    }
+
+    void BlockCache::DropNative() {
+        for (auto& it : this->pages) {
+            for (Block* block : it.second->blocks) {
+                block->hits = 0;
+                block->native = nullptr;
+            }
+        }
+    }
+
+    void BlockCache::FreeRetired() {
+        for (Block* block : this->retired) {
+            delete block;
+        }
+        this->retired.clear();
+    }
+
+    BlockCache::CodePage* BlockCache::GetPage(const Byte* host) {
+        CodePage*& page = this->pages[host];
+        if (page == nullptr) {
+            page = new CodePage();
+        }
+        return page;
+    }
+}
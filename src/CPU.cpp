@@ -1,25 +1,59 @@
 #include "../include/CPU.h"
+#include "../include/Config.h"
+#include "../include/Opcodes.h"
+#include "../include/ALUTables.h"
+#include "../include/Timer.h"
 
 #include <iostream>
+#include <climits>
+#if defined(_WIN32)
 #include <windows.h>
-#include <map>
+#endif
 
-#include <chrono>
-#include <thread>
+// Reference for comments above each function http://imrannazar.com/content/files/jsgb.z80.js
 
-using std::chrono::duration_cast;
-using std::chrono::nanoseconds;
-using std::chrono::high_resolution_clock;
-using std::chrono::duration;
+// Expansions of the opcode tables in Opcodes.h for each dispatch engine.
+// The handler call is variadic because template argument lists contain commas.
+#define OP_CASE(code, ...) case code: __VA_ARGS__; break;
+#define OP_HANDLER(code, ...) [](Z80* cpu) { __VA_ARGS__; },
+#define OP_LABEL(code, ...) &&op_##code,
+#define OP_THREADED(code, ...) op_##code: __VA_ARGS__; DISPATCH_NEXT();
+
+// Count the op just executed in the profile. For CB xx, op is the CB prefix and the second byte is
+// just behind PC.
+#if FEIGN_PROFILE
+#define PROFILE_OP(op) this->profiler.Record((op) == 0xCB, ((op) == 0xCB) ? this->ram->ReadByte(this->PC - 1) : (op), this->T)
+#else
+#define PROFILE_OP(op)
+#endif
+
+// Tail of every threaded handler: account for the op just executed and jump straight to the next one.
+#define DISPATCH_NEXT() \
+    PROFILE_OP(op); \
+    this->total_M += this->M; \
+    this->total_T += this->T; \
+    executed += this->T; \
+    if (executed >= cycles || this->total_T >= this->events.GetDeadline()) { \
+        return executed; \
+    } \
+    if (this->halt || this->stop) { \
+        return executed + Idle(cycles - executed); \
+    } \
+    op = this->ram->ReadByte(this->PC); \
+    ++this->numInstructions; \
+    ++this->PC; \
+    goto *labels[op];
 
-high_resolution_clock::time_point start;
-high_resolution_clock::time_point end;
-std::map<Byte, long long> timings;
-std::map<Byte, int> calls;
+namespace Processor {
+    // Bit number of the lowest set bit of a pending mask, the source serviced first
+    static const Byte interruptSource[32] = {
+        0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+        4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    };
 
-// Reference for comments above each function http://imrannazar.com/content/files/jsgb.z80.js
+    const Z80::OP_FUNC Z80::opTable[256] = { Z80_OPCODES(OP_HANDLER) };
+    const Z80::OP_FUNC Z80::cbTable[256] = { Z80_CB_OPCODES(OP_HANDLER) };
 
-namespace Processor {
     Z80::Z80() {
         this->PC = 0; this->SP.word = 0xFFFE;
         this->HL.word = 0x014D; this->BC.last = 0x13;
@@ -30,17 +64,39 @@ namespace Processor {
 
         this->stop = false;
         this->halt = false;
+        this->cgb = false;
+        this->speedArmed = false;
         this->IME = true;
+        this->pending = 0;
 
         this->numInstructions = 0;
+
+#if FEIGN_LAZY_FLAGS
+        this->lazy.op = LAZY_NONE;
+#endif
+#if FEIGN_BLOCK_CACHE
+        this->imm = 0;
+        this->blockDirty = false;
+#endif
+#if FEIGN_JIT
+        this->jit.SetCPU(this);
+#endif
+
+        this->idleSkip = true;
+        ResetIdleLoopStats();
     }
 
     Z80::~Z80() {
-
+#if FEIGN_PROFILE
+        this->profiler.Report(std::cout);
+#endif
     }
 
     void Z80::SetMMU(Memory::MMU* r) {
         this->ram = r;
+#if FEIGN_BLOCK_CACHE
+        this->blocks.SetMMU(r);
+#endif
 
         this->ram->WriteByte(0xFFFF, 0);
         this->ram->WriteByte(0xFF0F, 0);
@@ -58,364 +114,277 @@ namespace Processor {
         return this->T;
     }
 
-    int Z80::GetTotalT() {
+    Timing::Cycles Z80::GetTotalT() const {
         return this->total_T;
     }
 
+    Timing::Scheduler& Z80::GetScheduler() {
+        return this->events;
+    }
+
+    void Z80::RequestInterrupt(Byte mask) {
+        this->ram->WriteByte(0xFF0F, this->ram->ReadByte(0xFF0F) | mask);
+    }
+
+    void Z80::CheckInterrupts() {
+        this->events.Schedule(Timing::EVENT_INTERRUPT_CHECK, this->total_T);
+
+        // An interrupt can be taken right after this op, not at the end of the block
+        EndBlock();
+    }
+
+    void Z80::UpdateInterrupts() {
+        this->pending = this->ram->ReadByte(0xFFFF) & this->ram->ReadByte(0xFF0F) & 0x1F;
+
+        // Nothing to do until IME is set or the CPU halts, and those look at pending themselves
+        if (this->pending != 0 && (this->IME || this->halt)) {
+            CheckInterrupts();
+        }
+    }
+
+    void Z80::SetCGB(bool enable) {
+        this->cgb = enable;
+        this->speedArmed = false;
+        this->events.SetDoubleSpeed(false);
+
+        // What the CGB boot ROM leaves in A, games look at it to tell the models apart
+        if (enable) {
+            this->AF.first = 0x11;
+        }
+    }
+
+    Byte Z80::ReadKEY1() const {
+        if (!this->cgb) {
+            return 0xFF;
+        }
+        return 0x7E | (this->events.IsDoubleSpeed() ? BIT7 : 0) | (this->speedArmed ? BIT0 : 0);
+    }
+
+    void Z80::WriteKEY1(Byte val) {
+        this->speedArmed = this->cgb && (val & BIT0);
+    }
+
+    void Z80::Stall(int cycles) {
+        this->total_M += cycles / 4;
+        this->total_T += cycles;
+    }
+
+    bool Z80::IsHalted() const {
+        return this->halt || this->stop;
+    }
+
+    void Z80::InvalidateCode(const Byte* host) {
+#if FEIGN_BLOCK_CACHE
+        this->blocks.Invalidate(host);
+        this->blockDirty = true;
+#endif
+    }
+
+    void Z80::EndBlock() {
+#if FEIGN_BLOCK_CACHE
+        this->blockDirty = true;
+#endif
+    }
+
     void Z80::DoInterrupts() {
-        Byte interrupts = this->ram->ReadByte(0xFFFF);
-        Byte interruptsFlag = this->ram->ReadByte(0xFF0F);
-        //std::cout << this->IME << " " << interrupts << " " << interruptsFlag << std::endl;
+        if (this->pending == 0) {
+            return;
+        }
+
+        if (this->IME) {
+            Byte source = interruptSource[this->pending];
 
-        if (this->IME) { // && interrupts && interruptsFlag) {
-            if (interrupts == 0) {
-                return;
-            }
-            unsigned char fire = interruptsFlag & interrupts; // mask enabled interrupt(s)
             this->IME = false;
+            this->halt = false;
+
+            // Push the PC and jump to the source's vector at 0040-0060
+            this->SP.word -= 2;
+            this->ram->WriteWord(this->SP.word, this->PC);
+            this->PC = 0x40 + source * 8;
 
+            // 2 wait M-cycles, 2 to push the PC and 1 to set it
+            this->total_M += 5;
+            this->total_T += 20;
+
+            // Acknowledge it, which recomputes pending and schedules another check for the rest
+            this->ram->WriteByte(0xFF0F, this->ram->ReadByte(0xFF0F) & ~(1 << source));
+        }
+        else if (this->halt) {
+            // A pending interrupt ends HALT even when it can't be serviced
             this->halt = false;
+        }
+    }
 
-            if (fire & VBLANK) {
-                interruptsFlag &= ~VBLANK;
-                // draw screen
-                RST_N(40);
-            }
-            else if (fire & LCDC_STATUS) {
-                interruptsFlag &= ~LCDC_STATUS;
+    int Z80::Idle(int cycles) {
+        // Nothing happens until the next event, so skip straight to it or to the end of the budget,
+        // in whole M-cycles and at least one
+        Timing::Cycles deadline = this->events.GetDeadline();
+        Timing::Cycles until = (deadline > this->total_T) ? deadline - this->total_T : 0;
+        Timing::Cycles skip = (until < (Timing::Cycles)cycles) ? until : (Timing::Cycles)cycles;
+        int steps = (int)((skip + 3) >> 2);
+
+        if (steps == 0) {
+            steps = 1;
+        }
+
+        this->total_M += steps;
+        this->total_T += steps << 2;
+
+        return steps << 2;
+    }
+
+    int Z80::Run(int cycles) {
+        int executed = 0;
+        Z80* const cpu = this;
+
+        if (this->halt || this->stop) {
+            return Idle(cycles);
+        }
 
-                RST_N(48);
+#if FEIGN_PROFILE
+        this->profiler.StartRun();
+#endif
+
+#if FEIGN_BLOCK_CACHE
+        do {
+            // Nothing is being replayed here, so dropped blocks can be freed
+            this->blocks.Collect();
+
+            Block* block = this->blocks.Lookup(this->PC);
+            const DecodedOp* op = &block->ops[0];
+            const DecodedOp* last = op + block->ops.size();
+
+            // When the whole block fits before the budget and the next event the per-op checks can be skipped
+            Timing::Cycles end = this->total_T + block->cycles;
+            bool bounded = (executed + (int)block->cycles < cycles) && (end < this->events.GetDeadline());
+
+            // An event scheduled up to the block's last cycle, e.g. by a timer write, stops it like a
+            // deadline check would
+            this->events.Fence(bounded ? end + 1 : 0, &this->blockDirty);
+            this->blockDirty = false;
+
+#if FEIGN_IDLE_LOOPS
+            // Candidate idle loop, remember the state to see if an iteration changes anything
+            bool idleWatch = (block->idle & IDLE_LOOP) && bounded && this->idleSkip;
+            IdleSnapshot idleBefore;
+            Timing::Cycles idleStartT = this->total_T;
+            Timing::Cycles idleStartM = this->total_M;
+            if (idleWatch) {
+                TakeIdleSnapshot(idleBefore);
+            }
+#endif
+
+#if FEIGN_JIT
+            // Compiled code never checks deadlines, so it only runs blocks that fit
+            if (bounded && block->native == nullptr && ++block->hits == JIT_HOT_THRESHOLD) {
+                if (!this->jit.Compile(*block)) {
+                    // Out of code space, start over
+                    this->blocks.DropNative();
+                    this->jit.Reset();
+                    this->jit.Compile(*block);
+                }
             }
-            else if (fire & TIMER_OVERFLOW) {
-                interruptsFlag &= ~TIMER_OVERFLOW;
 
-                RST_N(50);
+            if (bounded && block->native != nullptr) {
+                executed += ((NATIVE_BLOCK)block->native)(cpu);
+                op = last;
             }
-            else if (fire & SERIAL_LINK) {
-                interruptsFlag &= ~SERIAL_LINK;
+#endif
+
+            for (; op != last; ++op) {
+                this->PC += op->prefix;
+                this->imm = op->imm;
+                ++this->numInstructions;
+
+                op->handler(cpu);
+
+#if FEIGN_PROFILE
+                this->profiler.Record(op->prefix == 2, op->op, this->T);
+#endif
+
+                this->total_M += this->M;
+                this->total_T += this->T;
+                executed += this->T;
 
-                RST_N(58);
+                if (this->blockDirty) {
+                    break;
+                }
+
+                if (!bounded && (executed >= cycles || this->total_T >= this->events.GetDeadline())) {
+                    return executed;
+                }
             }
-            else if (fire & JOYPAD_LINK) {
-                interruptsFlag &= ~JOYPAD_LINK;
 
-                RST_N(60);
+#if FEIGN_IDLE_LOOPS
+            if (idleWatch && !this->blockDirty) {
+                executed += SkipIdleLoop(block, idleBefore, executed, cycles, this->total_T - idleStartT, this->total_M - idleStartM);
             }
-            else {
-                this->IME = true;
+#endif
+
+            if (this->halt || this->stop) {
+                if (executed < cycles && this->total_T < this->events.GetDeadline()) {
+                    executed += Idle(cycles - executed);
+                }
+                break;
             }
-        }
+        } while (executed < cycles && this->total_T < this->events.GetDeadline());
+#elif FEIGN_DISPATCH == FEIGN_DISPATCH_THREADED
+        static void* const labels[256] = { Z80_OPCODES(OP_LABEL) };
+        Byte op;
 
-        this->ram->WriteByte(0xFFFF, interrupts);
-        this->ram->WriteByte(0xFF0F, interruptsFlag);
+        op = this->ram->ReadByte(this->PC);
+        ++this->numInstructions;
+        ++this->PC;
+        goto *labels[op];
 
-        this->T += 12;
-        this->total_T += this->T;
-    }
+        Z80_OPCODES(OP_THREADED)
+#else
+        do {
+            Byte op = this->ram->ReadByte(this->PC);
 
-    bool Z80::DoNextOp() {
-        start = high_resolution_clock::now();
+            ++this->numInstructions;
+            ++this->PC;
 
-        Byte op = this->ram->ReadByte(this->PC);
+#if FEIGN_DISPATCH == FEIGN_DISPATCH_TABLE
+            opTable[op](cpu);
+#else
+            switch (op) {
+                Z80_OPCODES(OP_CASE)
+            default:
+            break;
+            }
+#endif
 
-        ++this->numInstructions;
-        ++this->PC;
+            PROFILE_OP(op);
 
-        switch (op) {
-            // 00-0F
-        case 0x00: NOP(); break;
-        case 0x01: LD_RR_NN(&this->BC); break;
-        case 0x02: LD_BCm_A(); break;
-        case 0x03: INC_RR(&this->BC); break;
-        case 0x04: INC_R(&this->BC.first); break;
-        case 0x05: DEC_R(&this->BC.first); break;
-        case 0x06: LD_R_N(&this->BC.first); break;
-        case 0x07: RLCA(); break;
-        case 0x08: LD_NNm_SP(); break;
-        case 0x09: ADD_HL_RR(&this->BC); break;
-        case 0x0A: LD_A_BCm(); break;
-        case 0x0B: DEC_RR(&this->BC); break;
-        case 0x0C: INC_R(&this->BC.last); break;
-        case 0x0D: DEC_R(&this->BC.last); break;
-        case 0x0E: LD_R_N(&this->BC.last); break;
-        case 0x0F: RRCA(); break;
-
-            // 10-1F
-        case 0x10: STOP(); break;
-        case 0x11: LD_RR_NN(&this->DE); break;
-        case 0x12: LD_DEm_A(); break;
-        case 0x13: INC_RR(&this->DE); break;
-        case 0x14: INC_R(&this->DE.first); break;
-        case 0x15: DEC_R(&this->DE.first); break;
-        case 0x16: LD_R_N(&this->DE.first); break;
-        case 0x17: RLA(); break;
-        case 0x18: JR_PCdd(); break;
-        case 0x19: ADD_HL_RR(&this->DE); break;
-        case 0x1A: LD_A_DEm(); break;
-        case 0x1B: DEC_RR(&this->DE); break;
-        case 0x1C: INC_R(&this->DE.last); break;
-        case 0x1D: DEC_R(&this->DE.last); break;
-        case 0x1E: LD_R_N(&this->DE.last); break;
-        case 0x1F: RRA(); break;
-
-            // 20-2F
-        case 0x20: JR_NOTF_PCdd(zf); break;
-        case 0x21: LD_RR_NN(&this->HL); break;
-        case 0x22: LDInc_HLm_A(); break;
-        case 0x23: INC_RR(&this->HL); break;
-        case 0x24: INC_R(&this->HL.first); break;
-        case 0x25: DEC_R(&this->HL.first); break;
-        case 0x26: LD_R_N(&this->HL.first); break;
-        case 0x27: DAA(); break;
-        case 0x28: JR_F_PCdd(zf); break;
-        case 0x29: ADD_HL_RR(&this->HL); break;
-        case 0x2A: LDInc_A_HLm(); break;
-        case 0x2B: DEC_RR(&this->HL); break;
-        case 0x2C: INC_R(&this->HL.last); break;
-        case 0x2D: DEC_R(&this->HL.last); break;
-        case 0x2E: LD_R_N(&this->HL.last); break;
-        case 0x2F: CPL(); break;
-
-            // 30-3F
-        case 0x30: JR_NOTF_PCdd(cy); break;
-        case 0x31: LD_RR_NN(&this->SP); break;
-        case 0x32: LDDec_HLm_A(); break;
-        case 0x33: INC_RR(&this->SP); break;
-        case 0x34: INC_HLm(); break;
-        case 0x35: DEC_HLm(); break;
-        case 0x36: LD_HLm_N(); break;
-        case 0x37: SCF(); break;
-        case 0x38: JR_F_PCdd(cy); break;
-        case 0x39: ADD_HL_RR(&this->SP); break;
-        case 0x3A: LDDec_A_HLm(); break;
-        case 0x3B: DEC_RR(&this->SP); break;
-        case 0x3C: INC_R(&this->AF.first); break;
-        case 0x3D: DEC_R(&this->AF.first); break;
-        case 0x3E: LD_R_N(&this->AF.first); break;
-        case 0x3F: CCF(); break;
-
-            // 40-4F
-        case 0x40: LD_R_R(&this->BC.first, &this->BC.first); break;
-        case 0x41: LD_R_R(&this->BC.first, &this->BC.last); break;
-        case 0x42: LD_R_R(&this->BC.first, &this->DE.first); break;
-        case 0x43: LD_R_R(&this->BC.first, &this->DE.last); break;
-        case 0x44: LD_R_R(&this->BC.first, &this->HL.first); break;
-        case 0x45: LD_R_R(&this->BC.first, &this->HL.last); break;
-        case 0x46: LD_R_HLm(&this->BC.first); break;
-        case 0x47: LD_R_R(&this->BC.first, &this->AF.first); break;
-        case 0x48: LD_R_R(&this->BC.last, &this->BC.first); break;
-        case 0x49: LD_R_R(&this->BC.last, &this->BC.last); break;
-        case 0x4A: LD_R_R(&this->BC.last, &this->DE.first); break;
-        case 0x4B: LD_R_R(&this->BC.last, &this->DE.last); break;
-        case 0x4C: LD_R_R(&this->BC.last, &this->HL.first); break;
-        case 0x4D: LD_R_R(&this->BC.last, &this->HL.last); break;
-        case 0x4E: LD_R_HLm(&this->BC.last); break;
-        case 0x4F: LD_R_R(&this->BC.last, &this->AF.first); break;
-
-            // 50-5F
-        case 0x50: LD_R_R(&this->DE.first, &this->BC.first); break;
-        case 0x51: LD_R_R(&this->DE.first, &this->BC.last); break;
-        case 0x52: LD_R_R(&this->DE.first, &this->DE.first); break;
-        case 0x53: LD_R_R(&this->DE.first, &this->DE.last); break;
-        case 0x54: LD_R_R(&this->DE.first, &this->HL.first); break;
-        case 0x55: LD_R_R(&this->DE.first, &this->HL.last); break;
-        case 0x56: LD_R_HLm(&this->DE.first); break;
-        case 0x57: LD_R_R(&this->DE.first, &this->AF.first); break;
-        case 0x58: LD_R_R(&this->DE.last, &this->BC.first); break;
-        case 0x59: LD_R_R(&this->DE.last, &this->BC.last); break;
-        case 0x5A: LD_R_R(&this->DE.last, &this->DE.first); break;
-        case 0x5B: LD_R_R(&this->DE.last, &this->DE.last); break;
-        case 0x5C: LD_R_R(&this->DE.last, &this->HL.first); break;
-        case 0x5D: LD_R_R(&this->DE.last, &this->HL.last); break;
-        case 0x5E: LD_R_HLm(&this->DE.last); break;
-        case 0x5F: LD_R_R(&this->DE.last, &this->AF.first); break;
-
-            // 60-6F
-        case 0x60: LD_R_R(&this->HL.first, &this->BC.first); break;
-        case 0x61: LD_R_R(&this->HL.first, &this->BC.last); break;
-        case 0x62: LD_R_R(&this->HL.first, &this->DE.first); break;
-        case 0x63: LD_R_R(&this->HL.first, &this->DE.last); break;
-        case 0x64: LD_R_R(&this->HL.first, &this->HL.first); break;
-        case 0x65: LD_R_R(&this->HL.first, &this->HL.last); break;
-        case 0x66: LD_R_HLm(&this->HL.first); break;
-        case 0x67: LD_R_R(&this->HL.first, &this->AF.first); break;
-        case 0x68: LD_R_R(&this->HL.last, &this->BC.first); break;
-        case 0x69: LD_R_R(&this->HL.last, &this->BC.last); break;
-        case 0x6A: LD_R_R(&this->HL.last, &this->DE.first); break;
-        case 0x6B: LD_R_R(&this->HL.last, &this->DE.last); break;
-        case 0x6C: LD_R_R(&this->HL.last, &this->HL.first); break;
-        case 0x6D: LD_R_R(&this->HL.last, &this->HL.last); break;
-        case 0x6E: LD_R_HLm(&this->HL.last); break;
-        case 0x6F: LD_R_R(&this->HL.last, &this->AF.first); break;
-
-            // 70-7F
-        case 0x70: LD_HLm_R(&this->BC.first); break;
-        case 0x71: LD_HLm_R(&this->BC.last); break;
-        case 0x72: LD_HLm_R(&this->DE.first); break;
-        case 0x73: LD_HLm_R(&this->DE.last); break;
-        case 0x74: LD_HLm_R(&this->HL.first); break;
-        case 0x75: LD_HLm_R(&this->HL.last); break;
-        case 0x76: HALT(); break;
-        case 0x77: LD_HLm_R(&this->AF.first); break;
-        case 0x78: LD_R_R(&this->AF.first, &this->BC.first); break;
-        case 0x79: LD_R_R(&this->AF.first, &this->BC.last); break;
-        case 0x7A: LD_R_R(&this->AF.first, &this->DE.first); break;
-        case 0x7B: LD_R_R(&this->AF.first, &this->DE.last); break;
-        case 0x7C: LD_R_R(&this->AF.first, &this->HL.first); break;
-        case 0x7D: LD_R_R(&this->AF.first, &this->HL.last); break;
-        case 0x7E: LD_R_HLm(&this->AF.first); break;
-        case 0x7F: LD_R_R(&this->AF.first, &this->HL.first); break;
-
-
-            // 80-8F
-        case 0x80: ADD_A_R(&this->BC.first); break;
-        case 0x81: ADD_A_R(&this->BC.last); break;
-        case 0x82: ADD_A_R(&this->DE.first); break;
-        case 0x83: ADD_A_R(&this->DE.last); break;
-        case 0x84: ADD_A_R(&this->HL.first); break;
-        case 0x85: ADD_A_R(&this->HL.last); break;
-        case 0x86: ADD_A_HLm(); break;
-        case 0x87: ADD_A_R(&this->HL.first); break;
-        case 0x88: ADC_A_R(&this->BC.first); break;
-        case 0x89: ADC_A_R(&this->BC.last); break;
-        case 0x8A: ADC_A_R(&this->DE.first); break;
-        case 0x8B: ADC_A_R(&this->DE.last); break;
-        case 0x8C: ADC_A_R(&this->HL.first); break;
-        case 0x8D: ADC_A_R(&this->HL.last); break;
-        case 0x8E: ADC_A_HLm(); break;
-        case 0x8F: ADC_A_R(&this->AF.first); break;
-
-            // 90-9F
-        case 0x90: SUB_A_R(&this->BC.first); break;
-        case 0x91: SUB_A_R(&this->BC.last); break;
-        case 0x92: SUB_A_R(&this->DE.first); break;
-        case 0x93: SUB_A_R(&this->DE.last); break;
-        case 0x94: SUB_A_R(&this->HL.first); break;
-        case 0x95: SUB_A_R(&this->HL.last); break;
-        case 0x96: SUB_A_HLm(); break;
-        case 0x97: SUB_A_R(&this->HL.first); break;
-        case 0x98: SBC_A_R(&this->BC.first); break;
-        case 0x99: SBC_A_R(&this->BC.last); break;
-        case 0x9A: SBC_A_R(&this->DE.first); break;
-        case 0x9B: SBC_A_R(&this->DE.last); break;
-        case 0x9C: SBC_A_R(&this->HL.first); break;
-        case 0x9D: SBC_A_R(&this->HL.last); break;
-        case 0x9E: SBC_A_HLm(); break;
-        case 0x9F: SBC_A_R(&this->AF.first); break;
-
-            // A0-AF
-        case 0xA0: AND_A_R(&this->BC.first); break;
-        case 0xA1: AND_A_R(&this->BC.last); break;
-        case 0xA2: AND_A_R(&this->DE.first); break;
-        case 0xA3: AND_A_R(&this->DE.last); break;
-        case 0xA4: AND_A_R(&this->HL.first); break;
-        case 0xA5: AND_A_R(&this->HL.last); break;
-        case 0xA6: AND_A_HLm(); break;
-        case 0xA7: AND_A_R(&this->HL.first); break;
-        case 0xA8: XOR_A_R(&this->BC.first); break;
-        case 0xA9: XOR_A_R(&this->BC.last); break;
-        case 0xAA: XOR_A_R(&this->DE.first); break;
-        case 0xAB: XOR_A_R(&this->DE.last); break;
-        case 0xAC: XOR_A_R(&this->HL.first); break;
-        case 0xAD: XOR_A_R(&this->HL.last); break;
-        case 0xAE: XOR_A_HLm(); break;
-        case 0xAF: XOR_A_R(&this->AF.first); break;
-
-            // B0-BF
-        case 0xB0: OR_A_R(&this->BC.first); break;
-        case 0xB1: OR_A_R(&this->BC.last); break;
-        case 0xB2: OR_A_R(&this->DE.first); break;
-        case 0xB3: OR_A_R(&this->DE.last); break;
-        case 0xB4: OR_A_R(&this->HL.first); break;
-        case 0xB5: OR_A_R(&this->HL.last); break;
-        case 0xB6: OR_A_HLm(); break;
-        case 0xB7: OR_A_R(&this->HL.first); break;
-        case 0xB8: CP_A_R(&this->BC.first); break;
-        case 0xB9: CP_A_R(&this->BC.last); break;
-        case 0xBA: CP_A_R(&this->DE.first); break;
-        case 0xBB: CP_A_R(&this->DE.last); break;
-        case 0xBC: CP_A_R(&this->HL.first); break;
-        case 0xBD: CP_A_R(&this->HL.last); break;
-        case 0xBE: CP_A_HLm(); break;
-        case 0xBF: CP_A_R(&this->AF.first); break;
-
-            // C0-CF
-        case 0xC0: RET_NOTF(zf); break;
-        case 0xC1: POP_RR(&this->BC); break;
-        case 0xC2: JP_NOTF_NN(zf); break;
-        case 0xC3: JP_NN(); break;
-        case 0xC4: CALL_NOTF_NN(zf); break;
-        case 0xC5: PUSH_RR(&this->BC); break;
-        case 0xC6: ADD_A_N(); break;
-        case 0xC7: RST_N(0x00); break;
-        case 0xC8: RET_F(zf); break;
-        case 0xC9: RET(); break;
-        case 0xCA: JP_F_NN(zf); break;
-        case 0xCB: DoCBOp(); break;
-        case 0xCC: CALL_F_NN(zf); break;
-        case 0xCD: CALL_NN(); break;
-        case 0xCE: ADC_A_N(); break;
-        case 0xCF: RST_N(0x08); break;
-
-            // D0-DF
-        case 0xD0: RET_NOTF(cy); break;
-        case 0xD1: POP_RR(&this->DE); break;
-        case 0xD2: JP_NOTF_NN(cy); break;
-        case 0xD3: NOP(); break;
-        case 0xD4: CALL_NOTF_NN(cy); break;
-        case 0xD5: PUSH_RR(&this->DE); break;
-        case 0xD6: SUB_A_N(); break;
-        case 0xD7: RST_N(0x10); break;
-        case 0xD8: RET_F(cy); break;
-        case 0xD9: RETI(); break;
-        case 0xDA: JP_F_NN(cy); break;
-        case 0xDB: NOP(); break;
-        case 0xDC: CALL_F_NN(cy); break;
-        case 0xDD: NOP(); break;
-        case 0xDE: SBC_A_N(); break;
-        case 0xDF: RST_N(0x18); break;
-
-            // E0-EF
-        case 0xE0: LD_IONm_A(); break;
-        case 0xE1: POP_RR(&this->HL); break;
-        case 0xE2: LD_IOCm_A(); break;
-        case 0xE3: NOP(); break;
-        case 0xE4: NOP(); break;
-        case 0xE5: PUSH_RR(&this->HL); break;
-        case 0xE6: AND_A_N(); break;
-        case 0xE7: RST_N(0x20); break;
-        case 0xE8: ADD_SP_dd(); break;
-        case 0xE9: JP_HL(); break;
-        case 0xEA: LD_NNm_A(); break;
-        case 0xEB: NOP(); break;
-        case 0xEC: NOP(); break;
-        case 0xED: NOP(); break;
-        case 0xEE: XOR_A_N(); break;
-        case 0xEF: RST_N(0x28); break;
-
-            // F0-FF
-        case 0xF0: LD_A_IONm(); break;
-        case 0xF1: POP_RR(&this->AF); break;
-        case 0xF2: LD_A_IOCm(); break;
-        case 0xF3: DI(); break;
-        case 0xF4: NOP(); break;
-        case 0xF5: PUSH_RR(&this->AF); break;
-        case 0xF6: OR_A_N(); break;
-        case 0xF7: RST_N(0x30); break;
-        case 0xF8: LD_HL_SPdd(); break;
-        case 0xF9: LD_SP_HL(); break;
-        case 0xFA: LD_A_NNm(); break;
-        case 0xFB: EI(); break;
-        case 0xFC: NOP(); break;
-        case 0xFD: NOP(); break;
-        case 0xFE: CP_A_N(); break;
-        case 0xFF: RST_N(0x38); break;
+            this->total_M += this->M;
+            this->total_T += this->T;
+            executed += this->T;
 
-        default:
-        break;
-        }
+            if (this->total_T >= this->events.GetDeadline()) {
+                break;
+            }
+
+            if (this->halt || this->stop) {
+                if (executed < cycles) {
+                    executed += Idle(cycles - executed);
+                }
+                break;
+            }
+        } while (executed < cycles);
+#endif
+
+        return executed;
+    }
 
-        end = high_resolution_clock::now();
+    bool Z80::DoNextOp() {
+        if (this->halt || this->stop) {
+            // Fast-forward to whatever wakes the CPU
+            Idle(INT_MAX);
+        }
+        else {
+            Run(1);
+        }
 
         if (this->halt) {
             return false;
@@ -425,9 +394,6 @@ namespace Processor {
             return false;
         }
 
-        this->total_M += this->M;
-        this->total_T += this->T;
-
         return true;
     }
 
@@ -436,302 +402,20 @@ namespace Processor {
 
         ++this->PC;
 
-        switch (op) {
-            // 00-0F
-        case 0x00: RLC(&this->BC.first); break;
-        case 0x01: RLC(&this->BC.last); break;
-        case 0x02: RLC(&this->DE.first); break;
-        case 0x03: RLC(&this->DE.last); break;
-        case 0x04: RLC(&this->HL.first); break;
-        case 0x05: RLC(&this->HL.last); break;
-        case 0x06: RLC_HL(); break;
-        case 0x07: RLC(&this->AF.first); break;
-        case 0x08: RRC(&this->BC.first); break;
-        case 0x09: RRC(&this->BC.last); break;
-        case 0x0A: RRC(&this->DE.first); break;
-        case 0x0B: RRC(&this->DE.last); break;
-        case 0x0C: RRC(&this->HL.first); break;
-        case 0x0D: RRC(&this->HL.last); break;
-        case 0x0E: RRC_HL(); break;
-        case 0x0F: RRC(&this->AF.first); break;
-
-            // 10-1F
-        case 0x10: RL(&this->BC.first); break;
-        case 0x11: RL(&this->BC.last); break;
-        case 0x12: RL(&this->DE.first); break;
-        case 0x13: RL(&this->DE.last); break;
-        case 0x14: RL(&this->HL.first); break;
-        case 0x15: RL(&this->HL.last); break;
-        case 0x16: RL_HL(); break;
-        case 0x17: RL(&this->AF.first); break;
-        case 0x18: RR(&this->BC.first); break;
-        case 0x19: RR(&this->BC.last); break;
-        case 0x1A: RR(&this->DE.first); break;
-        case 0x1B: RR(&this->DE.last); break;
-        case 0x1C: RR(&this->HL.first); break;
-        case 0x1D: RR(&this->HL.last); break;
-        case 0x1E: RR_HL(); break;
-        case 0x1F: RR(&this->AF.first); break;
-
-            // 20-2F
-        case 0x20: SLA(&this->BC.first); break;
-        case 0x21: SLA(&this->BC.last); break;
-        case 0x22: SLA(&this->DE.first); break;
-        case 0x23: SLA(&this->DE.last); break;
-        case 0x24: SLA(&this->HL.first); break;
-        case 0x25: SLA(&this->HL.last); break;
-        case 0x26: SLA_HL(); break;
-        case 0x27: SRA(&this->AF.first); break;
-        case 0x28: SRA(&this->BC.first); break;
-        case 0x29: SRA(&this->BC.last); break;
-        case 0x2A: SRA(&this->DE.first); break;
-        case 0x2B: SRA(&this->DE.last); break;
-        case 0x2C: SRA(&this->HL.first); break;
-        case 0x2D: SRA(&this->HL.last); break;
-        case 0x2E: SRA_HL(); break;
-        case 0x2F: SRA(&this->AF.first); break;
-
-            // 30-3F
-        case 0x30: SWAP(&this->BC.first); break;
-        case 0x31: SWAP(&this->BC.last); break;
-        case 0x32: SWAP(&this->DE.first); break;
-        case 0x33: SWAP(&this->DE.last); break;
-        case 0x34: SWAP(&this->HL.first); break;
-        case 0x35: SWAP(&this->HL.last); break;
-        case 0x36: SWAP_HL(); break;
-        case 0x37: SRL(&this->AF.first); break;
-        case 0x38: SRL(&this->BC.first); break;
-        case 0x39: SRL(&this->BC.last); break;
-        case 0x3A: SRL(&this->DE.first); break;
-        case 0x3B: SRL(&this->DE.last); break;
-        case 0x3C: SRL(&this->HL.first); break;
-        case 0x3D: SRL(&this->HL.last); break;
-        case 0x3E: SRL_HL(); break;
-        case 0x3F: SRL(&this->AF.first); break;
-
-            // 40-4F
-        case 0x40: BITTEST(&this->BC.first, 0); break;
-        case 0x41: BITTEST(&this->BC.last, 0); break;
-        case 0x42: BITTEST(&this->DE.first, 0); break;
-        case 0x43: BITTEST(&this->DE.last, 0); break;
-        case 0x44: BITTEST(&this->HL.first, 0); break;
-        case 0x45: BITTEST(&this->HL.last, 0); break;
-        case 0x46: BITTEST_HL(0); break;
-        case 0x47: BITTEST(&this->AF.first, 0); break;
-        case 0x48: BITTEST(&this->BC.first, 1); break;
-        case 0x49: BITTEST(&this->BC.last, 1); break;
-        case 0x4A: BITTEST(&this->DE.first, 1); break;
-        case 0x4B: BITTEST(&this->DE.last, 1); break;
-        case 0x4C: BITTEST(&this->HL.first, 1); break;
-        case 0x4D: BITTEST(&this->HL.last, 1); break;
-        case 0x4E: BITTEST_HL(1); break;
-        case 0x4F: BITTEST(&this->AF.first, 1); break;
-
-            // 50-5F
-        case 0x50: BITTEST(&this->BC.first, 2); break;
-        case 0x51: BITTEST(&this->BC.last, 2); break;
-        case 0x52: BITTEST(&this->DE.first, 2); break;
-        case 0x53: BITTEST(&this->DE.last, 2); break;
-        case 0x54: BITTEST(&this->HL.first, 2); break;
-        case 0x55: BITTEST(&this->HL.last, 2); break;
-        case 0x56: BITTEST_HL(2); break;
-        case 0x57: BITTEST(&this->AF.first, 2); break;
-        case 0x58: BITTEST(&this->BC.first, 3); break;
-        case 0x59: BITTEST(&this->BC.last, 3); break;
-        case 0x5A: BITTEST(&this->DE.first, 3); break;
-        case 0x5B: BITTEST(&this->DE.last, 3); break;
-        case 0x5C: BITTEST(&this->HL.first, 3); break;
-        case 0x5D: BITTEST(&this->HL.last, 3); break;
-        case 0x5E: BITTEST_HL(3); break;
-        case 0x5F: BITTEST(&this->AF.first, 3); break;
-
-            // 60-6F
-        case 0x60: BITTEST(&this->BC.first, 4); break;
-        case 0x61: BITTEST(&this->BC.last, 4); break;
-        case 0x62: BITTEST(&this->DE.first, 4); break;
-        case 0x63: BITTEST(&this->DE.last, 4); break;
-        case 0x64: BITTEST(&this->HL.first, 4); break;
-        case 0x65: BITTEST(&this->HL.last, 4); break;
-        case 0x66: BITTEST_HL(4); break;
-        case 0x67: BITTEST(&this->AF.first, 4); break;
-        case 0x68: BITTEST(&this->BC.first, 5); break;
-        case 0x69: BITTEST(&this->BC.last, 5); break;
-        case 0x6A: BITTEST(&this->DE.first, 5); break;
-        case 0x6B: BITTEST(&this->DE.last, 5); break;
-        case 0x6C: BITTEST(&this->HL.first, 5); break;
-        case 0x6D: BITTEST(&this->HL.last, 5); break;
-        case 0x6E: BITTEST_HL(5); break;
-        case 0x6F: BITTEST(&this->AF.first, 5); break;
-
-            // 70-7F
-        case 0x70: BITTEST(&this->BC.first, 6); break;
-        case 0x71: BITTEST(&this->BC.last, 6); break;
-        case 0x72: BITTEST(&this->DE.first, 6); break;
-        case 0x73: BITTEST(&this->DE.last, 6); break;
-        case 0x74: BITTEST(&this->HL.first, 6); break;
-        case 0x75: BITTEST(&this->HL.last, 6); break;
-        case 0x76: BITTEST_HL(6); break;
-        case 0x77: BITTEST(&this->AF.first, 6); break;
-        case 0x78: BITTEST(&this->BC.first, 7); break;
-        case 0x79: BITTEST(&this->BC.last, 7); break;
-        case 0x7A: BITTEST(&this->DE.first, 7); break;
-        case 0x7B: BITTEST(&this->DE.last, 7); break;
-        case 0x7C: BITTEST(&this->HL.first, 7); break;
-        case 0x7D: BITTEST(&this->HL.last, 7); break;
-        case 0x7E: BITTEST_HL(7); break;
-        case 0x7F: BITTEST(&this->AF.first, 7); break;
-
-
-            // 80-8F
-        case 0x80: CLEARBIT(&this->BC.first, 0); break;
-        case 0x81: CLEARBIT(&this->BC.last, 0); break;
-        case 0x82: CLEARBIT(&this->DE.first, 0); break;
-        case 0x83: CLEARBIT(&this->DE.last, 0); break;
-        case 0x84: CLEARBIT(&this->HL.first, 0); break;
-        case 0x85: CLEARBIT(&this->HL.last, 0); break;
-        case 0x86: CLEARBIT_HL(0); break;
-        case 0x87: CLEARBIT(&this->AF.first, 0); break;
-        case 0x88: CLEARBIT(&this->BC.first, 1); break;
-        case 0x89: CLEARBIT(&this->BC.last, 1); break;
-        case 0x8A: CLEARBIT(&this->DE.first, 1); break;
-        case 0x8B: CLEARBIT(&this->DE.last, 1); break;
-        case 0x8C: CLEARBIT(&this->HL.first, 1); break;
-        case 0x8D: CLEARBIT(&this->HL.last, 1); break;
-        case 0x8E: CLEARBIT_HL(1); break;
-        case 0x8F: CLEARBIT(&this->AF.first, 1); break;
-
-            // 90-9F
-        case 0x90: CLEARBIT(&this->BC.first, 2); break;
-        case 0x91: CLEARBIT(&this->BC.last, 2); break;
-        case 0x92: CLEARBIT(&this->DE.first, 2); break;
-        case 0x93: CLEARBIT(&this->DE.last, 2); break;
-        case 0x94: CLEARBIT(&this->HL.first, 2); break;
-        case 0x95: CLEARBIT(&this->HL.last, 2); break;
-        case 0x96: CLEARBIT_HL(2); break;
-        case 0x97: CLEARBIT(&this->AF.first, 2); break;
-        case 0x98: CLEARBIT(&this->BC.first, 3); break;
-        case 0x99: CLEARBIT(&this->BC.last, 3); break;
-        case 0x9A: CLEARBIT(&this->DE.first, 3); break;
-        case 0x9B: CLEARBIT(&this->DE.last, 3); break;
-        case 0x9C: CLEARBIT(&this->HL.first, 3); break;
-        case 0x9D: CLEARBIT(&this->HL.last, 3); break;
-        case 0x9E: CLEARBIT_HL(3); break;
-        case 0x9F: CLEARBIT(&this->AF.first, 3); break;
-
-            // A0-AF
-        case 0xA0: CLEARBIT(&this->BC.first, 4); break;
-        case 0xA1: CLEARBIT(&this->BC.last, 4); break;
-        case 0xA2: CLEARBIT(&this->DE.first, 4); break;
-        case 0xA3: CLEARBIT(&this->DE.last, 4); break;
-        case 0xA4: CLEARBIT(&this->HL.first, 4); break;
-        case 0xA5: CLEARBIT(&this->HL.last, 4); break;
-        case 0xA6: CLEARBIT_HL(4); break;
-        case 0xA7: CLEARBIT(&this->AF.first, 4); break;
-        case 0xA8: CLEARBIT(&this->BC.first, 5); break;
-        case 0xA9: CLEARBIT(&this->BC.last, 5); break;
-        case 0xAA: CLEARBIT(&this->DE.first, 5); break;
-        case 0xAB: CLEARBIT(&this->DE.last, 5); break;
-        case 0xAC: CLEARBIT(&this->HL.first, 5); break;
-        case 0xAD: CLEARBIT(&this->HL.last, 5); break;
-        case 0xAE: CLEARBIT_HL(5); break;
-        case 0xAF: CLEARBIT(&this->AF.first, 5); break;
-
-            // B0-BF
-        case 0xB0: CLEARBIT(&this->BC.first, 6); break;
-        case 0xB1: CLEARBIT(&this->BC.last, 6); break;
-        case 0xB2: CLEARBIT(&this->DE.first, 6); break;
-        case 0xB3: CLEARBIT(&this->DE.last, 6); break;
-        case 0xB4: CLEARBIT(&this->HL.first, 6); break;
-        case 0xB5: CLEARBIT(&this->HL.last, 6); break;
-        case 0xB6: CLEARBIT_HL(6); break;
-        case 0xB7: CLEARBIT(&this->AF.first, 6); break;
-        case 0xB8: CLEARBIT(&this->BC.first, 7); break;
-        case 0xB9: CLEARBIT(&this->BC.last, 7); break;
-        case 0xBA: CLEARBIT(&this->DE.first, 7); break;
-        case 0xBB: CLEARBIT(&this->DE.last, 7); break;
-        case 0xBC: CLEARBIT(&this->HL.first, 7); break;
-        case 0xBD: CLEARBIT(&this->HL.last, 7); break;
-        case 0xBE: CLEARBIT_HL(7); break;
-        case 0xBF: CLEARBIT(&this->AF.first, 7); break;
-
-            // C0-CF
-        case 0xC0: SETBIT(&this->BC.first, 0); break;
-        case 0xC1: SETBIT(&this->BC.last, 0); break;
-        case 0xC2: SETBIT(&this->DE.first, 0); break;
-        case 0xC3: SETBIT(&this->DE.last, 0); break;
-        case 0xC4: SETBIT(&this->HL.first, 0); break;
-        case 0xC5: SETBIT(&this->HL.last, 0); break;
-        case 0xC6: SETBIT_HL(0); break;
-        case 0xC7: SETBIT(&this->AF.first, 0); break;
-        case 0xC8: SETBIT(&this->BC.first, 1); break;
-        case 0xC9: SETBIT(&this->BC.last, 1); break;
-        case 0xCA: SETBIT(&this->DE.first, 1); break;
-        case 0xCB: SETBIT(&this->DE.last, 1); break;
-        case 0xCC: SETBIT(&this->HL.first, 1); break;
-        case 0xCD: SETBIT(&this->HL.last, 1); break;
-        case 0xCE: SETBIT_HL(1); break;
-        case 0xCF: SETBIT(&this->AF.first, 1); break;
-
-            // D0-DF
-        case 0xD0: SETBIT(&this->BC.first, 2); break;
-        case 0xD1: SETBIT(&this->BC.last, 2); break;
-        case 0xD2: SETBIT(&this->DE.first, 2); break;
-        case 0xD3: SETBIT(&this->DE.last, 2); break;
-        case 0xD4: SETBIT(&this->HL.first, 2); break;
-        case 0xD5: SETBIT(&this->HL.last, 2); break;
-        case 0xD6: SETBIT_HL(2); break;
-        case 0xD7: SETBIT(&this->AF.first, 2); break;
-        case 0xD8: SETBIT(&this->BC.first, 3); break;
-        case 0xD9: SETBIT(&this->BC.last, 3); break;
-        case 0xDA: SETBIT(&this->DE.first, 3); break;
-        case 0xDB: SETBIT(&this->DE.last, 3); break;
-        case 0xDC: SETBIT(&this->HL.first, 3); break;
-        case 0xDD: SETBIT(&this->HL.last, 3); break;
-        case 0xDE: SETBIT_HL(3); break;
-        case 0xDF: SETBIT(&this->AF.first, 3); break;
-
-            // E0-EF
-        case 0xE0: SETBIT(&this->BC.first, 4); break;
-        case 0xE1: SETBIT(&this->BC.last, 4); break;
-        case 0xE2: SETBIT(&this->DE.first, 4); break;
-        case 0xE3: SETBIT(&this->DE.last, 4); break;
-        case 0xE4: SETBIT(&this->HL.first, 4); break;
-        case 0xE5: SETBIT(&this->HL.last, 4); break;
-        case 0xE6: SETBIT_HL(4); break;
-        case 0xE7: SETBIT(&this->AF.first, 4); break;
-        case 0xE8: SETBIT(&this->BC.first, 5); break;
-        case 0xE9: SETBIT(&this->BC.last, 5); break;
-        case 0xEA: SETBIT(&this->DE.first, 5); break;
-        case 0xEB: SETBIT(&this->DE.last, 5); break;
-        case 0xEC: SETBIT(&this->HL.first, 5); break;
-        case 0xED: SETBIT(&this->HL.last, 5); break;
-        case 0xEE: SETBIT_HL(5); break;
-        case 0xEF: SETBIT(&this->AF.first, 5); break;
-
-            // F0-FF
-        case 0xF0: SETBIT(&this->BC.first, 6); break;
-        case 0xF1: SETBIT(&this->BC.last, 6); break;
-        case 0xF2: SETBIT(&this->DE.first, 6); break;
-        case 0xF3: SETBIT(&this->DE.last, 6); break;
-        case 0xF4: SETBIT(&this->HL.first, 6); break;
-        case 0xF5: SETBIT(&this->HL.last, 6); break;
-        case 0xF6: SETBIT_HL(6); break;
-        case 0xF7: SETBIT(&this->AF.first, 6); break;
-        case 0xF8: SETBIT(&this->BC.first, 7); break;
-        case 0xF9: SETBIT(&this->BC.last, 7); break;
-        case 0xFA: SETBIT(&this->DE.first, 7); break;
-        case 0xFB: SETBIT(&this->DE.last, 7); break;
-        case 0xFC: SETBIT(&this->HL.first, 7); break;
-        case 0xFD: SETBIT(&this->HL.last, 7); break;
-        case 0xFE: SETBIT_HL(7); break;
-        case 0xFF: SETBIT(&this->AF.first, 7); break;
+#if FEIGN_DISPATCH == FEIGN_DISPATCH_SWITCH
+        Z80* const cpu = this;
 
+        switch (op) {
+            Z80_CB_OPCODES(OP_CASE)
         default:
         break;
         }
+#else
+        cbTable[op](this);
+#endif
     }
 
-    void Z80::RLC(Byte* target_register) {
+    template <REGISTER8 R> void Z80::RLC() {
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -743,7 +427,7 @@ namespace Processor {
         this->M = 2; this->T = 8;
     }
 
-    void Z80::RRC(Byte* target_register) {
+    template <REGISTER8 R> void Z80::RRC() {
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -755,7 +439,7 @@ namespace Processor {
         this->M = 2; this->T = 8;
     }
 
-    void Z80::RL(Byte* target_register) {
+    template <REGISTER8 R> void Z80::RL() {
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -767,7 +451,7 @@ namespace Processor {
         this->M = 2; this->T = 8;
     }
 
-    void Z80::RR(Byte* target_register) {
+    template <REGISTER8 R> void Z80::RR() {
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -779,7 +463,7 @@ namespace Processor {
         this->M = 2; this->T = 8;
     }
 
-    void Z80::SLA(Byte* target_register) {
+    template <REGISTER8 R> void Z80::SLA() {
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -791,7 +475,7 @@ namespace Processor {
         this->M = 2; this->T = 8;
     }
 
-    void Z80::SRA(Byte* target_register) {
+    template <REGISTER8 R> void Z80::SRA() {
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -803,7 +487,7 @@ namespace Processor {
         this->M = 2; this->T = 8;
     }
 
-    void Z80::SWAP(Byte* target_register) {
+    template <REGISTER8 R> void Z80::SWAP() {
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -815,10 +499,10 @@ namespace Processor {
         this->M = 2; this->T = 8;
     }
 
-    void Z80::SRL(Byte* target_register) {
-        Byte old_LSB = *target_register & BIT0;
-        *target_register = (*target_register >> 1);
-        this->AF.last = ((*target_register == 0) ? zf : 0) + old_LSB;
+    template <REGISTER8 R> void Z80::SRL() {
+        Byte old_LSB = this->Reg<R>() & BIT0;
+        this->Reg<R>() = (this->Reg<R>() >> 1);
+        SetF(((this->Reg<R>() == 0) ? zf : 0) + old_LSB);
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -828,63 +512,65 @@ namespace Processor {
         Byte temp = this->ram->ReadByte(this->HL.word);
         Byte old_LSB = temp & BIT0;
         temp = (temp >> 1) & (0 << 7);
-        this->AF.last = ((temp == 0) ? zf : 0) + old_LSB;
+        SetF(((temp == 0) ? zf : 0) + old_LSB);
         this->ram->WriteByte(this->HL.word, temp);
 
         // Update clocks
         this->M = 4; this->T = 16;
     }
 
-    void Z80::BITTEST(Byte * target_register, unsigned int bit_index) {
-        Byte temp = (this->AF.last & cy) ? 0 : cy; // preserve carry
-        this->AF.last = h + temp;
-        if (*target_register & (1 << bit_index)) {
-            this->AF.last += zf;
+    template <unsigned int B, REGISTER8 R> void Z80::BITTEST() {
+        Byte temp = (GetF() & cy) ? 0 : cy; // preserve carry
+        Byte f = h + temp;
+        if (this->Reg<R>() & (1 << B)) {
+            f += zf;
         }
+        SetF(f);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
-    void Z80::BITTEST_HL(unsigned int bit_index) {
-        Byte temp = (this->AF.last & cy) ? 0 : cy; // preserve carry
-        this->AF.last = h + temp;
-        if (this->ram->ReadByte(this->HL.word) & (1 << bit_index)) {
-            this->AF.last += zf;
+    template <unsigned int B> void Z80::BITTEST_HL() {
+        Byte temp = (GetF() & cy) ? 0 : cy; // preserve carry
+        Byte f = h + temp;
+        if (this->ram->ReadByte(this->HL.word) & (1 << B)) {
+            f += zf;
         }
+        SetF(f);
 
         // Update clocks
         this->M = 4; this->T = 16;
     }
 
-    void Z80::CLEARBIT(Byte * target_register, unsigned int bit_index) {
-        Byte temp = *target_register;
-        *target_register = temp & (0 << bit_index);
+    template <unsigned int B, REGISTER8 R> void Z80::CLEARBIT() {
+        Byte temp = this->Reg<R>();
+        this->Reg<R>() = temp & (0 << B);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
-    void Z80::CLEARBIT_HL(unsigned int bit_index) {
+    template <unsigned int B> void Z80::CLEARBIT_HL() {
         Byte temp = this->ram->ReadByte(this->HL.word);
-        temp &= (0 << bit_index);
+        temp &= (0 << B);
         this->ram->WriteByte(this->HL.word, temp);
 
         // Update clocks
         this->M = 4; this->T = 16;
     }
 
-    void Z80::SETBIT(Byte * target_register, unsigned int bit_index) {
-        Byte temp = *target_register;
-        *target_register = temp | (1 << bit_index);
+    template <unsigned int B, REGISTER8 R> void Z80::SETBIT() {
+        Byte temp = this->Reg<R>();
+        this->Reg<R>() = temp | (1 << B);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
-    void Z80::SETBIT_HL(unsigned int bit_index) {
+    template <unsigned int B> void Z80::SETBIT_HL() {
         Byte temp = this->ram->ReadByte(this->HL.word);
-        temp |= 1 << bit_index;
+        temp |= 1 << B;
         this->ram->WriteByte(this->HL.word, temp);
 
         // Update clocks
@@ -893,8 +579,9 @@ namespace Processor {
 
     // CCF: function() { var ci=Z80._r.f&0x10?0:0x10; Z80._r.f=(Z80._r.f&0xEF)+ci; Z80._r.m=1; Z80._r.t=4; }
     void Z80::CCF() {
-        Byte temp = (this->AF.last & cy) ? 0 : cy;
-        this->AF.last = (this->AF.last & 0x80) + temp;
+        Byte f = GetF();
+        Byte temp = (f & cy) ? 0 : cy;
+        SetF((f & 0x80) + temp);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -902,7 +589,7 @@ namespace Processor {
 
     // SCF: function() { Z80._r.f|=0x10; Z80._r.m=1; Z80._r.t=4; },
     void Z80::SCF() {
-        this->AF.last |= cy;
+        SetF(GetF() | cy);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -917,20 +604,32 @@ namespace Processor {
     // HALT: function() { Z80._halt=1; Z80._r.m=1; Z80._r.t=4; },
     void Z80::HALT() {
         this->halt = true;
+        if (this->pending != 0) {
+            CheckInterrupts();
+        }
 
         // Update clocks
         this->M = 1; this->T = 4;
     }
 
     void Z80::STOP() {
-        this->stop = true;
+        // An armed KEY1 makes STOP a speed switch. Everything timed on the base clock goes through the
+        // scheduler, which is all that needs to know.
+        if (this->speedArmed) {
+            this->speedArmed = false;
+            this->events.SetDoubleSpeed(!this->events.IsDoubleSpeed());
+        }
+        else {
+            this->stop = true;
+        }
 
         // Update clocks
         this->M = 1; this->T = 4;
     }
 
     void Z80::DI() {
-        //this->IME = false;
+        this->IME = false;
+        UpdateInterrupts();
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -938,23 +637,26 @@ namespace Processor {
 
     void Z80::EI() {
         this->IME = true;
+        if (this->pending != 0) {
+            CheckInterrupts();
+        }
 
         // Update clocks
         this->M = 1; this->T = 4;
     }
 
     // LDrr_bb: function() { Z80._r.b=Z80._r.b; Z80._r.m=1; Z80._r.t=4; },
-    void Z80::LD_R_R(Byte* dest_register, Byte* src_register) {
-        *dest_register = *src_register;
+    template <REGISTER8 D, REGISTER8 S> void Z80::LD_R_R() {
+        this->Reg<D>() = this->Reg<S>();
 
         // Update clocks
         this->M = 1; this->T = 4;
     }
 
     // LDrn_b: function() { Z80._r.b=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._r.m=2; Z80._r.t=8; },
-    void Z80::LD_R_N(Byte* dest_register) {
+    template <REGISTER8 D> void Z80::LD_R_N() {
         // Get address from immediate value at PC
-        *dest_register = this->ram->ReadByte(this->PC);
+        this->Reg<D>() = Imm8();
 
         ++this->PC;
 
@@ -963,18 +665,18 @@ namespace Processor {
     }
 
     // LDrHLm_b: function() { Z80._r.b=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._r.m=2; Z80._r.t=8; },
-    void Z80::LD_R_HLm(Byte* dest_register) {
+    template <REGISTER8 D> void Z80::LD_R_HLm() {
         // Write src_register into the address pointed at by HL
-        *dest_register = this->ram->ReadByte(this->HL.word);
+        this->Reg<D>() = this->ram->ReadByte(this->HL.word);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
     // LDHLmr_b: function() { MMU.wb((Z80._r.h<<8)+Z80._r.l,Z80._r.b); Z80._r.m=2; Z80._r.t=8; },
-    void Z80::LD_HLm_R(Byte* src_register) {
+    template <REGISTER8 S> void Z80::LD_HLm_R() {
         // Write src_register into the address pointed at by HL
-        this->ram->WriteByte(this->HL.word, *src_register);
+        this->ram->WriteByte(this->HL.word, this->Reg<S>());
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -983,7 +685,7 @@ namespace Processor {
     // LDHLmn: function() { MMU.wb((Z80._r.h<<8)+Z80._r.l, MMU.rb(Z80._r.pc)); Z80._r.pc++; Z80._r.m=3; Z80._r.t=12; },
     void Z80::LD_HLm_N() {
         // Write the immediate value at PC into the address pointed at by HL
-        this->ram->WriteByte(this->HL.word, this->ram->ReadByte(this->PC));
+        this->ram->WriteByte(this->HL.word, Imm8());
 
         ++this->PC;
 
@@ -1012,7 +714,7 @@ namespace Processor {
     // LDAmm: function() { Z80._r.a=MMU.rb(MMU.rw(Z80._r.pc)); Z80._r.pc+=2; Z80._r.m=4; Z80._r.t=16; },
     void Z80::LD_A_NNm() {
         // Write the value at the address described by an immediate value into A
-        this->AF.first = this->ram->ReadByte(this->ram->ReadWord(this->PC));
+        this->AF.first = this->ram->ReadByte(Imm16());
 
         // Move the PC
         this->PC += 2;
@@ -1043,7 +745,7 @@ namespace Processor {
     // LDmmA: function() { MMU.wb(MMU.rw(Z80._r.pc), Z80._r.a); Z80._r.pc+=2; Z80._r.m=4; Z80._r.t=16; },
     void Z80::LD_NNm_A() {
         // Write A into the address described by an immediate value 
-        this->ram->WriteByte(this->ram->ReadWord(this->PC), this->AF.first);
+        this->ram->WriteByte(Imm16(), this->AF.first);
 
         // Move the PC
         this->PC += 2;
@@ -1055,7 +757,7 @@ namespace Processor {
     // LDAIOn: function() { Z80._r.a=MMU.rb(0xFF00+MMU.rb(Z80._r.pc)); Z80._r.pc++; Z80._r.m=3; Z80._r.t=12; },
     void Z80::LD_A_IONm() {
         // Get A from value 0xFF + offset from immediate value at PC
-        this->AF.first = this->ram->ReadByte(0xFF00 + this->ram->ReadByte(this->PC));
+        this->AF.first = this->ram->ReadByte(0xFF00 + Imm8());
 
         ++this->PC;
 
@@ -1066,7 +768,7 @@ namespace Processor {
     // LDIOnA: function() { MMU.wb(0xFF00+MMU.rb(Z80._r.pc),Z80._r.a); Z80._r.pc++; Z80._r.m=3; Z80._r.t=12; },
     void Z80::LD_IONm_A() {
         // Write A at 0xFF00 + offset from immediate value at PC
-        this->ram->WriteByte(0xFF00 + this->ram->ReadByte(this->PC), this->AF.first);
+        this->ram->WriteByte(0xFF00 + Imm8(), this->AF.first);
 
         ++this->PC;
 
@@ -1133,9 +835,9 @@ namespace Processor {
     }
 
     // LDBCnn: function() { Z80._r.c=MMU.rb(Z80._r.pc); Z80._r.b=MMU.rb(Z80._r.pc+1); Z80._r.pc+=2; Z80._r.m=3; Z80._r.t=12; }
-    void Z80::LD_RR_NN(Register* dest_register) {
+    template <REGISTER16 D> void Z80::LD_RR_NN() {
         // Get address from memory
-        dest_register->word = this->ram->ReadWord(this->PC);
+        this->Reg16<D>().word = Imm16();
 
         // Move the PC
         this->PC += 2;
@@ -1156,7 +858,7 @@ namespace Processor {
     // LDmmHL: function() { var i=MMU.rw(Z80._r.pc); Z80._r.pc+=2; MMU.ww(i,(Z80._r.h<<8)+Z80._r.l); Z80._r.m=5; Z80._r.t=20; },
     void Z80::LD_NNm_SP() {
         // Get the destination address from the immediate value at PC
-        Word temp = this->ram->ReadWord(this->PC);
+        Word temp = Imm16();
 
         // Increment PC
         this->PC += 2;
@@ -1169,240 +871,341 @@ namespace Processor {
     }
 
     // PUSHBC: function() { Z80._r.sp--; MMU.wb(Z80._r.sp,Z80._r.b); Z80._r.sp--; MMU.wb(Z80._r.sp,Z80._r.c); Z80._r.m=3; Z80._r.t=12; }
-    void Z80::PUSH_RR(Register* src_register) {
+    template <REGISTER16 S> void Z80::PUSH_RR() {
+        // Bring F up to date before it goes on the stack
+        if (S == REG_AF) {
+            GetF();
+        }
+
         // Decrement the stack pointer 
         this->SP.word -= 2;
 
         // Write src_register
-        this->ram->WriteWord(this->SP.word, src_register->word);
+        this->ram->WriteWord(this->SP.word, this->Reg16<S>().word);
 
         // Update clocks
         this->M = 4; this->T = 16;
     }
 
     // POPBC: function() { Z80._r.c=MMU.rb(Z80._r.sp); Z80._r.sp++; Z80._r.b=MMU.rb(Z80._r.sp); Z80._r.sp++; Z80._r.m=3; Z80._r.t=12; },
-    void Z80::POP_RR(Register* dest_register) {
+    template <REGISTER16 D> void Z80::POP_RR() {
         // Read src_register
-        dest_register->word = this->ram->ReadWord(this->SP.word);
+        this->Reg16<D>().word = this->ram->ReadWord(this->SP.word);
 
         // Increment the stack pointer and read dest_register
         this->SP.word += 2;
 
+        // Any deferred flags are replaced by the popped F
+        if (D == REG_AF) {
+            SetF(this->AF.last);
+        }
+
         // Update clocks
         this->M = 3; this->T = 12;
     }
 
-    // ADDr_b: function() { Z80._r.a+=Z80._r.b; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=1; Z80._r.t=4; },
-    void Z80::ADD_A_R(Byte* src_register) {
-        // Reset the flags
-        this->AF.last = 0;
+    Word Z80::GetAF() {
+        GetF();
+
+        return this->AF.word;
+    }
+
+    void Z80::SetIdleLoopSkip(bool enable) {
+        this->idleSkip = enable;
+    }
 
-        // Check if the operation resulted in 0
-        if ((this->AF.first + *src_register) == 0) {
-            this->AF.last |= zf;
+    const IdleLoopStats& Z80::GetIdleLoopStats() const {
+        return this->idleStats;
+    }
+
+    void Z80::ResetIdleLoopStats() {
+        this->idleStats.loops = 0;
+        this->idleStats.skipped = 0;
+    }
+
+#if FEIGN_BLOCK_CACHE && FEIGN_IDLE_LOOPS
+    void Z80::TakeIdleSnapshot(IdleSnapshot& snapshot) {
+        snapshot.af = GetAF();
+        snapshot.bc = this->BC.word;
+        snapshot.de = this->DE.word;
+        snapshot.hl = this->HL.word;
+        snapshot.sp = this->SP.word;
+    }
+
+    int Z80::SkipIdleLoop(const Block* block, const IdleSnapshot& before, int executed, int cycles, Timing::Cycles iterT, Timing::Cycles iterM) {
+        if (this->PC != block->pc || this->halt || this->stop || iterT == 0) {
+            return 0;
         }
 
-        // Check if there is a carry
-        if ((this->AF.first + *src_register) > 0xFF) {
-            this->AF.last |= cy;
+        // The timer registers count on their own
+        if ((block->idle & IDLE_LOOP_READS_HL) && (this->HL.word == Timing::DIV || this->HL.word == Timing::TIMA)) {
+            return 0;
         }
 
-        // Check if there is a half carry
-        if (((this->AF.first & 0x0F) + (*src_register & 0x0F)) > 0x0F) {
-            this->AF.last |= h;
+        IdleSnapshot after;
+        TakeIdleSnapshot(after);
+        if (memcmp(&before, &after, sizeof(IdleSnapshot)) != 0) {
+            return 0;
         }
 
-        // Store the masked first byte in A
-        this->AF.first += *src_register;
+        // Every further iteration does the same until an event changes what the loop reads. Skip the
+        // ones the run loop would execute as whole bounded blocks, the rest run normally.
+        Timing::Cycles room = (Timing::Cycles)(cycles - executed);
+        Timing::Cycles deadline = this->events.GetDeadline();
+        if (deadline != CYCLES_NEVER) {
+            Timing::Cycles untilEvent = (deadline > this->total_T) ? deadline - this->total_T : 0;
+            if (untilEvent < room) {
+                room = untilEvent;
+            }
+        }
+        if (room <= block->cycles) {
+            return 0;
+        }
 
-        // Update clocks
-        this->M = 1; this->T = 4;
-    }
+        Timing::Cycles iterations = (room - block->cycles - 1) / iterT;
+        if (iterations == 0) {
+            return 0;
+        }
 
-    // ADDn: function() { Z80._r.a+=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
-    void Z80::ADD_A_N() {
-        // Get N
-        Byte temp = this->ram->ReadByte(this->PC);
+        this->total_T += iterations * iterT;
+        this->total_M += iterations * iterM;
+        this->numInstructions += (unsigned int)(iterations * block->ops.size());
 
-        ++this->PC;
+        this->idleStats.loops += 1;
+        this->idleStats.skipped += iterations * iterT;
 
-        // Reset the flags
-        this->AF.last = 0;
+        return (int)(iterations * iterT);
+    }
+#endif
 
-        // Zero
-        if ((this->AF.first + temp) == 0) {
-            this->AF.last |= zf;
+    Byte Z80::GetF() {
+#if FEIGN_LAZY_FLAGS
+        if (this->lazy.op != LAZY_NONE) {
+            this->AF.last = LazyF();
+            this->lazy.op = LAZY_NONE;
         }
+#endif
+        return this->AF.last;
+    }
 
-        // Carry
-        if ((this->AF.first + temp) > 0xFF) {
-            this->AF.last |= cy;
-        }
+    void Z80::SetF(Byte f) {
+#if FEIGN_LAZY_FLAGS
+        this->lazy.op = LAZY_NONE;
+#endif
+        this->AF.last = f;
+    }
 
-        // Half carry
-        if (((this->AF.first & 0x0F) + (temp & 0x0F)) > 0x0F) {
-            this->AF.last |= h;
+    Byte Z80::CarryIn() {
+#if FEIGN_LAZY_FLAGS
+        // Only the carry is needed, so don't materialize the whole of F
+        switch (this->lazy.op) {
+        case LAZY_ADD: return (this->lazy.a + this->lazy.b + this->lazy.carry) >> 8;
+        case LAZY_SUB: return ((this->lazy.a - this->lazy.b - this->lazy.carry) >> 8) & 1;
+        case LAZY_AND: case LAZY_LOGIC: return 0;
+        case LAZY_INC: case LAZY_DEC: return this->lazy.carry;
+        default: break;
         }
+#endif
+        return (this->AF.last & cy) ? 1 : 0;
+    }
 
-        // Store the masked first byte in A
-        this->AF.first += temp;
+#if FEIGN_LAZY_FLAGS
+    void Z80::DeferFlags(Byte op, Byte a, Byte b, Byte carry) {
+        this->lazy.op = op;
+        this->lazy.a = a;
+        this->lazy.b = b;
+        this->lazy.carry = carry;
+    }
 
-        // Update clocks
-        this->M = 2; this->T = 8;
+    Byte Z80::LazyF() const {
+        switch (this->lazy.op) {
+        case LAZY_ADD:
+        return ALU_ENTRY_FLAGS(addTable.entry[ALU_BINARY_INDEX(this->lazy.a, this->lazy.b, this->lazy.carry)]);
+        case LAZY_SUB:
+        return ALU_ENTRY_FLAGS(subTable.entry[ALU_BINARY_INDEX(this->lazy.a, this->lazy.b, this->lazy.carry)]);
+        case LAZY_AND:
+        return ((this->lazy.a == 0) ? zf : 0) | h;
+        case LAZY_LOGIC:
+        return (this->lazy.a == 0) ? zf : 0;
+        case LAZY_INC:
+        return ALU_ENTRY_FLAGS(incTable.entry[this->lazy.a]) | (this->lazy.carry << 4);
+        case LAZY_DEC:
+        return ALU_ENTRY_FLAGS(decTable.entry[this->lazy.a]) | (this->lazy.carry << 4);
+        default:
+        return this->AF.last;
+        }
     }
+#endif
 
-    // ADDHL: function() { Z80._r.a+=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
-    void Z80::ADD_A_HLm() {
-        // Get HL
-        Byte temp = this->ram->ReadByte(this->HL.word);
+#if !FEIGN_LAZY_FLAGS
+    void Z80::EagerFlags(Byte f) {
+        this->AF.last = f;
+    }
+#endif
 
-        // Reset the flags
-        this->AF.last = 0;
+    void Z80::ADD8(Byte value, Byte carry) {
+        Byte a = this->AF.first;
 
-        // Zero
-        if (!(this->AF.first + (temp & 0xFF))) {
-            this->AF.last |= zf;
-        }
+#if FEIGN_LAZY_FLAGS
+        this->AF.first = a + value + carry;
+        DeferFlags(LAZY_ADD, a, value, carry);
+#else
+        // Result and flags in one load
+        Word entry = addTable.entry[ALU_BINARY_INDEX(a, value, carry)];
+
+        this->AF.first = ALU_ENTRY_RESULT(entry);
+        EagerFlags(ALU_ENTRY_FLAGS(entry));
+#endif
+    }
+
+    void Z80::SUB8(Byte value, Byte carry, bool store) {
+        Byte a = this->AF.first;
 
-        // Carry
-        if ((this->AF.first + temp) > 0xFF) {
-            this->AF.last |= cy;
+#if FEIGN_LAZY_FLAGS
+        if (store) {
+            this->AF.first = a - value - carry;
         }
+        DeferFlags(LAZY_SUB, a, value, carry);
+#else
+        // Result and flags in one load
+        Word entry = subTable.entry[ALU_BINARY_INDEX(a, value, carry)];
 
-        // Half carry
-        if (((this->AF.first & 0x0F) + (temp & 0x0F)) > 0x0F) {
-            this->AF.last |= h;
+        if (store) {
+            this->AF.first = ALU_ENTRY_RESULT(entry);
         }
+        EagerFlags(ALU_ENTRY_FLAGS(entry));
+#endif
+    }
 
-        // Store the masked first byte in A
-        this->AF.first += temp;
+    void Z80::AND8(Byte value) {
+        this->AF.first &= value;
 
-        // Update clocks
-        this->M = 2; this->T = 8;
+#if FEIGN_LAZY_FLAGS
+        DeferFlags(LAZY_AND, this->AF.first, 0, 0);
+#else
+        EagerFlags(((this->AF.first == 0) ? zf : 0) | h);
+#endif
     }
 
-    // ADCr_b: function() { Z80._r.a+=Z80._r.b; Z80._r.a+=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=1; Z80._r.t=4; }
-    void Z80::ADC_A_R(Byte* src_register) {
-        // Determine the carry flag
-        Byte carry = (this->AF.last & cy) ? 1 : 0;
+    void Z80::XOR8(Byte value) {
+        this->AF.first ^= value;
 
-        // Reset the flags
-        this->AF.last = 0;
+#if FEIGN_LAZY_FLAGS
+        DeferFlags(LAZY_LOGIC, this->AF.first, 0, 0);
+#else
+        EagerFlags((this->AF.first == 0) ? zf : 0);
+#endif
+    }
 
-        // Zero
-        if ((this->AF.first + *src_register + carry) == 0) {
-            this->AF.last |= zf;
-        }
+    void Z80::OR8(Byte value) {
+        this->AF.first |= value;
 
-        // Carry
-        if ((this->AF.first + *src_register + carry) > 0xFF) {
-            this->AF.last |= cy;
-        }
+#if FEIGN_LAZY_FLAGS
+        DeferFlags(LAZY_LOGIC, this->AF.first, 0, 0);
+#else
+        EagerFlags((this->AF.first == 0) ? zf : 0);
+#endif
+    }
 
-        // Half carry
-        if (((this->AF.first & 0x0F) + (*src_register & 0x0F) + carry) > 0x0F) {
-            this->AF.last |= h;
-        }
+    void Z80::INC8(Byte& target) {
+        // INC leaves the carry alone
+        Byte carry = CarryIn();
+        Byte old = target;
 
-        // Store the masked first byte in A
-        this->AF.first = this->AF.first + *src_register + carry;
+#if FEIGN_LAZY_FLAGS
+        ++target;
+        DeferFlags(LAZY_INC, old, 0, carry);
+#else
+        Word entry = incTable.entry[old];
 
-        // Update clocks
-        this->M = 1; this->T = 4;
+        target = ALU_ENTRY_RESULT(entry);
+        EagerFlags(ALU_ENTRY_FLAGS(entry) | (carry ? cy : 0));
+#endif
     }
 
-    // ADCn: function() { Z80._r.a+=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._r.a+=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
-    void Z80::ADC_A_N() {
-        // Get N
-        Byte temp = this->ram->ReadByte(this->PC);
+    void Z80::DEC8(Byte& target) {
+        // DEC leaves the carry alone
+        Byte carry = CarryIn();
+        Byte old = target;
 
-        ++this->PC;
+#if FEIGN_LAZY_FLAGS
+        --target;
+        DeferFlags(LAZY_DEC, old, 0, carry);
+#else
+        Word entry = decTable.entry[old];
 
-        // Determine the carry flag
-        Byte carry = (this->AF.last & cy) ? 1 : 0;
+        target = ALU_ENTRY_RESULT(entry);
+        EagerFlags(ALU_ENTRY_FLAGS(entry) | (carry ? cy : 0));
+#endif
+    }
 
-        // Reset the flags
-        this->AF.last = 0;
+    // ADDr_b: function() { Z80._r.a+=Z80._r.b; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=1; Z80._r.t=4; },
+    template <REGISTER8 S> void Z80::ADD_A_R() {
+        ADD8(this->Reg<S>(), 0);
 
-        // Zero
-        if ((this->AF.first + temp + carry) == 0) {
-            this->AF.last |= zf;
-        }
+        // Update clocks
+        this->M = 1; this->T = 4;
+    }
 
-        // Carry
-        if ((this->AF.first + temp + carry) > 0xFF) {
-            this->AF.last |= cy;
-        }
+    // ADDn: function() { Z80._r.a+=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
+    void Z80::ADD_A_N() {
+        // Get N
+        Byte temp = Imm8();
 
-        // Half carry
-        if (((this->AF.first & 0x0F) + (temp & 0x0F) + carry) > 0x0F) {
-            this->AF.last |= h;
-        }
+        ++this->PC;
 
-        // Store the masked first byte in A
-        this->AF.first = this->AF.first + temp + carry;
+        ADD8(temp, 0);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
-    // ADCHL: function() { Z80._r.a+=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._r.a+=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
-    void Z80::ADC_A_HLm() {
+    // ADDHL: function() { Z80._r.a+=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
+    void Z80::ADD_A_HLm() {
+        // Get the value at HL
         Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Determine the carry flag
-        Byte carry = (this->AF.last & cy) ? 1 : 0;
+        ADD8(temp, 0);
 
-        // Reset the flags
-        this->AF.last = 0;
+        // Update clocks
+        this->M = 2; this->T = 8;
+    }
 
-        // Zero
-        if ((this->AF.first + temp + carry) == 0) {
-            this->AF.last |= zf;
-        }
+    // ADCr_b: function() { Z80._r.a+=Z80._r.b; Z80._r.a+=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=1; Z80._r.t=4; }
+    template <REGISTER8 S> void Z80::ADC_A_R() {
+        ADD8(this->Reg<S>(), CarryIn());
 
-        // Carry
-        if ((this->AF.first + temp + carry) > 0xFF) {
-            this->AF.last |= cy;
-        }
+        // Update clocks
+        this->M = 1; this->T = 4;
+    }
 
-        // Half carry
-        if (((this->AF.first & 0x0F) + (temp & 0x0F) + carry) > 0x0F) {
-            this->AF.last |= h;
-        }
+    // ADCn: function() { Z80._r.a+=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._r.a+=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
+    void Z80::ADC_A_N() {
+        // Get N
+        Byte temp = Imm8();
 
-        // Store the masked first byte in A
-        this->AF.first = this->AF.first + temp + carry;
+        ++this->PC;
+
+        ADD8(temp, CarryIn());
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
-    // SUBr_b: function() { Z80._r.a-=Z80._r.b; Z80._ops.fz(Z80._r.a,1); if(Z80._r.a<0) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=1; Z80._r.t=4; },
-    void Z80::SUB_A_R(Byte* src_register) {
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Zero
-        if ((this->AF.first - *src_register) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Subtraction
-        this->AF.last |= n;
+    // ADCHL: function() { Z80._r.a+=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._r.a+=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a); if(Z80._r.a>255) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
+    void Z80::ADC_A_HLm() {
+        // Get the value at HL
+        Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Carry
-        if (this->AF.first < *src_register) {
-            this->AF.last |= cy;
-        }
+        ADD8(temp, CarryIn());
 
-        // Half carry
-        if ((this->AF.first & 0x0F) < (*src_register & 0x0F)) {
-            this->AF.last |= cy;
-        }
+        // Update clocks
+        this->M = 2; this->T = 8;
+    }
 
-        // Store the masked first byte in A
-        this->AF.first -= *src_register;
+    // SUBr_b: function() { Z80._r.a-=Z80._r.b; Z80._ops.fz(Z80._r.a,1); if(Z80._r.a<0) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=1; Z80._r.t=4; },
+    template <REGISTER8 S> void Z80::SUB_A_R() {
+        SUB8(this->Reg<S>(), 0, true);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1411,33 +1214,11 @@ namespace Processor {
     // SUBn: function() { Z80._r.a-=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._ops.fz(Z80._r.a,1); if(Z80._r.a<0) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
     void Z80::SUB_A_N() {
         // Get N
-        Byte temp = this->ram->ReadByte(this->PC);
+        Byte temp = Imm8();
 
         ++this->PC;
 
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Zero
-        if ((this->AF.first - temp) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Subtraction
-        this->AF.last |= n;
-
-        // Carry
-        if (this->AF.first < temp) {
-            this->AF.last |= cy;
-        }
-
-        // Half carry
-        if ((this->AF.first & 0x0F) < (temp & 0x0F)) {
-            this->AF.last |= cy;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first -= temp;
+        SUB8(temp, 0, true);
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -1445,64 +1226,18 @@ namespace Processor {
 
     // SUBHL: function() { Z80._r.a-=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._ops.fz(Z80._r.a,1); if(Z80._r.a<0) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
     void Z80::SUB_A_HLm() {
-        // Get N
+        // Get the value at HL
         Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Zero
-        if ((this->AF.first - temp) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Subtraction
-        this->AF.last |= n;
-
-        // Carry
-        if (this->AF.first < temp) {
-            this->AF.last |= cy;
-        }
-
-        // Half carry
-        if ((this->AF.first & 0x0F) < (temp & 0x0F)) {
-            this->AF.last |= cy;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first -= temp;
+        SUB8(temp, 0, true);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
     // SBCr_b: function() { Z80._r.a-=Z80._r.b; Z80._r.a-=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a,1); if(Z80._r.a<0) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=1; Z80._r.t=4; },
-    void Z80::SBC_A_R(Byte* src_register) {
-        Byte carry = (this->AF.last & cy) ? 1 : 0;
-
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Zero
-        if ((this->AF.first - *src_register - carry) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Subtraction
-        this->AF.last |= n;
-
-        // Carry
-        if (this->AF.first < (*src_register - carry)) {
-            this->AF.last |= cy;
-        }
-
-        // Half carry
-        if ((this->AF.first & 0x0F) < ((*src_register & 0x0F) - carry)) {
-            this->AF.last |= cy;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first -= *src_register - carry;
+    template <REGISTER8 S> void Z80::SBC_A_R() {
+        SUB8(this->Reg<S>(), CarryIn(), true);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1510,35 +1245,12 @@ namespace Processor {
 
     // SBCn: function() { Z80._r.a-=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._r.a-=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a,1); if(Z80._r.a<0) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
     void Z80::SBC_A_N() {
-        Byte temp = this->ram->ReadByte(this->PC);
+        // Get N
+        Byte temp = Imm8();
 
         ++this->PC;
 
-        Byte carry = (this->AF.last & cy) ? 1 : 0;
-
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Zero
-        if ((this->AF.first - temp - carry) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Subtraction
-        this->AF.last |= n;
-
-        // Carry
-        if (this->AF.first < (temp - carry)) {
-            this->AF.last |= cy;
-        }
-
-        // Half carry
-        if ((this->AF.first & 0x0F) < ((temp & 0x0F) - carry)) {
-            this->AF.last |= cy;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first -= temp - carry;
+        SUB8(temp, CarryIn(), true);
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -1546,50 +1258,18 @@ namespace Processor {
 
     // SBCHL: function() { Z80._r.a-=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._r.a-=(Z80._r.f&0x10)?1:0; Z80._ops.fz(Z80._r.a,1); if(Z80._r.a<0) Z80._r.f|=0x10; Z80._r.a&=255; Z80._r.m=2; Z80._r.t=8; },
     void Z80::SBC_A_HLm() {
+        // Get the value at HL
         Byte temp = this->ram->ReadByte(this->HL.word);
 
-        Byte carry = (this->AF.last & cy) ? 1 : 0;
-
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Zero
-        if ((this->AF.first - temp - carry) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Subtraction
-        this->AF.last |= n;
-
-        // Carry
-        if (this->AF.first < (temp - carry)) {
-            this->AF.last |= cy;
-        }
-
-        // Half carry
-        if ((this->AF.first & 0x0F) < ((temp & 0x0F) - carry)) {
-            this->AF.last |= cy;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first -= temp - carry;
+        SUB8(temp, CarryIn(), true);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
     // ANDr_b: function() { Z80._r.a&=Z80._r.b; Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=1; Z80._r.t=4; },
-    void Z80::AND_A_R(Byte* src_register) {
-        // Reset the flags
-        this->AF.last = h;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first & *src_register) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first &= *src_register;
+    template <REGISTER8 S> void Z80::AND_A_R() {
+        AND8(this->Reg<S>());
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1597,21 +1277,12 @@ namespace Processor {
 
     // ANDn: function() { Z80._r.a&=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=2; Z80._r.t=8; }
     void Z80::AND_A_N() {
-        // Binary AND A and src_register
-        Byte temp = this->ram->ReadByte(this->PC);
+        // Get N
+        Byte temp = Imm8();
 
         ++this->PC;
 
-        // Reset the flags
-        this->AF.last = h;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first & temp) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first &= temp;
+        AND8(temp);
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -1619,33 +1290,18 @@ namespace Processor {
 
     // ANDHL: function() { Z80._r.a&=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=2; Z80._r.t=8; },
     void Z80::AND_A_HLm() {
-        // Binary AND A and src_register
+        // Get the value at HL
         Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Reset the flags
-        this->AF.last = h;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first & temp) == 0) {
-            this->AF.last |= zf;
-        }
-
-        // Store the masked first byte in A
-        this->AF.first &= temp;
+        AND8(temp);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
     // XORr_b: function() { Z80._r.a^=Z80._r.b; Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=1; Z80._r.t=4; },
-    void Z80::XOR_A_R(Byte* src_register) {
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first ^= *src_register) == 0) {
-            this->AF.last |= zf;
-        }
+    template <REGISTER8 S> void Z80::XOR_A_R() {
+        XOR8(this->Reg<S>());
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1653,18 +1309,12 @@ namespace Processor {
 
     // XORn: function() { Z80._r.a^=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=2; Z80._r.t=8; },
     void Z80::XOR_A_N() {
-        // Binary XOR A and the value at PC
-        Byte temp = this->ram->ReadByte(this->PC);
+        // Get N
+        Byte temp = Imm8();
 
         ++this->PC;
 
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first ^= temp) == 0) {
-            this->AF.last |= zf;
-        }
+        XOR8(temp);
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -1672,30 +1322,18 @@ namespace Processor {
 
     // XORHL: function() { Z80._r.a^=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=2; Z80._r.t=8; },
     void Z80::XOR_A_HLm() {
-        // Binary XOR A and the value at PC
+        // Get the value at HL
         Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first ^= temp) == 0) {
-            this->AF.last |= zf;
-        }
+        XOR8(temp);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
     // ORr_b: function() { Z80._r.a|=Z80._r.b; Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=1; Z80._r.t=4; },
-    void Z80::OR_A_R(Byte* src_register) {
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first |= *src_register) == 0) {
-            this->AF.last |= zf;
-        }
+    template <REGISTER8 S> void Z80::OR_A_R() {
+        OR8(this->Reg<S>());
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1703,18 +1341,12 @@ namespace Processor {
 
     // ORn: function() { Z80._r.a|=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=2; Z80._r.t=8; },
     void Z80::OR_A_N() {
-        // Binary XOR A and the value at PC
-        Byte temp = this->ram->ReadByte(this->PC);
+        // Get N
+        Byte temp = Imm8();
 
         ++this->PC;
 
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first |= temp) == 0) {
-            this->AF.last |= zf;
-        }
+        OR8(temp);
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -1722,39 +1354,18 @@ namespace Processor {
 
     // ORHL: function() { Z80._r.a|=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._r.a&=255; Z80._ops.fz(Z80._r.a); Z80._r.m=2; Z80._r.t=8; },
     void Z80::OR_A_HLm() {
-        // Binary XOR A and the value at PC
+        // Get the value at HL
         Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Reset the flags
-        this->AF.last = 0;
-
-        // Check if the operation resulted in 0
-        if ((this->AF.first |= temp) == 0) {
-            this->AF.last |= zf;
-        }
+        OR8(temp);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
     // CPr_b: function() { var i=Z80._r.a; i-=Z80._r.b; Z80._ops.fz(i,1); if(i<0) Z80._r.f|=0x10; i&=255; Z80._r.m=1; Z80._r.t=4; },
-    void Z80::CP_A_R(Byte* src_register) {
-        // Reset the flags
-        this->AF.last = n;
-
-        // Check if the operation resulted in 0
-        if (this->AF.first == *src_register) {
-            this->AF.last |= zf;
-        }
-
-        // Check if there is a carry
-        if (this->AF.first < *src_register) {
-            this->AF.last |= cy;
-        }
-
-        if ((this->AF.first & 0x0F) < (*src_register & 0x0F)) {
-            this->AF.last |= h;
-        }
+    template <REGISTER8 S> void Z80::CP_A_R() {
+        SUB8(this->Reg<S>(), 0, false);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1762,27 +1373,12 @@ namespace Processor {
 
     // CPn: function() { var i=Z80._r.a; i-=MMU.rb(Z80._r.pc); Z80._r.pc++; Z80._ops.fz(i,1); if(i<0) Z80._r.f|=0x10; i&=255; Z80._r.m=2; Z80._r.t=8; },
     void Z80::CP_A_N() {
-        // Store A in a temp variable
-        Byte temp = this->ram->ReadByte(this->PC);
+        // Get N
+        Byte temp = Imm8();
 
         ++this->PC;
 
-        // Reset the flags
-        this->AF.last = n;
-
-        // Subtract the value at PC
-        if (temp == this->AF.first) {
-            this->AF.last |= zf;
-        }
-
-        // Check if there is a carry
-        if (this->AF.first < temp) {
-            this->AF.last |= cy;
-        }
-
-        if ((this->AF.first & 0x0F) < (temp & 0x0F)) {
-            this->AF.last |= h;
-        }
+        SUB8(temp, 0, false);
 
         // Update clocks
         this->M = 2; this->T = 8;
@@ -1790,43 +1386,18 @@ namespace Processor {
 
     // CPHL: function() { var i=Z80._r.a; i-=MMU.rb((Z80._r.h<<8)+Z80._r.l); Z80._ops.fz(i,1); if(i<0) Z80._r.f|=0x10; i&=255; Z80._r.m=2; Z80._r.t=8; },
     void Z80::CP_A_HLm() {
-        // Store A in a temp variable
+        // Get the value at HL
         Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Reset the flags
-        this->AF.last = n;
-
-        // Subtract the value at PC
-        if (temp == this->AF.first) {
-            this->AF.last |= zf;
-        }
-
-        // Check if there is a carry
-        if (this->AF.first < temp) {
-            this->AF.last |= cy;
-        }
-
-        if ((this->AF.first & 0x0F) < (temp & 0x0F)) {
-            this->AF.last |= h;
-        }
+        SUB8(temp, 0, false);
 
         // Update clocks
         this->M = 2; this->T = 8;
     }
 
     // INCr_b: function() { Z80._r.b++; Z80._r.b&=255; Z80._ops.fz(Z80._r.b); Z80._r.m=1; Z80._r.t=4; },
-    void Z80::INC_R(Byte* sd_register) {
-        // Reset the flags
-        this->AF.last &= cy;
-
-        if ((*sd_register & 0x0F + 1) == 0x0F) {
-            this->AF.last |= h;
-        }
-
-        // Check if the operation resulted in 0
-        if (++*sd_register == 0) {
-            this->AF.last |= zf;
-        }
+    template <REGISTER8 R> void Z80::INC_R() {
+        INC8(this->Reg<R>());
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1834,20 +1405,10 @@ namespace Processor {
 
     // INCHLm: function() { var i=MMU.rb((Z80._r.h<<8)+Z80._r.l)+1; i&=255; MMU.wb((Z80._r.h<<8)+Z80._r.l,i); Z80._ops.fz(i); Z80._r.m=3; Z80._r.t=12; },
     void Z80::INC_HLm() {
-        // Increment sd_register and store it in a temp
-        Byte temp = this->ram->ReadByte(this->HL.word) + 1;
-
-        // Reset the flags
-        this->AF.last &= cy;
+        Byte temp = this->ram->ReadByte(this->HL.word);
 
-        if ((temp & 0x0F + 1) == 0x0F) {
-            this->AF.last |= h;
-        }
+        INC8(temp);
 
-        // Check if the operation resulted in 0
-        if (++temp == 0) {
-            this->AF.last |= zf;
-        }
         this->ram->WriteByte(this->HL.word, temp);
 
         // Update clocks
@@ -1855,20 +1416,8 @@ namespace Processor {
     }
 
     // DECr_b: function() { Z80._r.b--; Z80._r.b&=255; Z80._ops.fz(Z80._r.b); Z80._r.m=1; Z80._r.t=4; },
-    void Z80::DEC_R(Byte* sd_register) {
-        // Reset the flags
-        this->AF.last &= cy;
-
-        this->AF.last |= n;
-
-        if ((*sd_register & 0x0F - 1) == 0x00) {
-            this->AF.last |= h;
-        }
-
-        // Check if the operation resulted in 0
-        if (--*sd_register == 0) {
-            this->AF.last |= zf;
-        }
+    template <REGISTER8 R> void Z80::DEC_R() {
+        DEC8(this->Reg<R>());
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1876,32 +1425,22 @@ namespace Processor {
 
     // DECHLm: function() { var i=MMU.rb((Z80._r.h<<8)+Z80._r.l)-1; i&=255; MMU.wb((Z80._r.h<<8)+Z80._r.l,i); Z80._ops.fz(i); Z80._r.m=3; Z80._r.t=12; },
     void Z80::DEC_HLm() {
-        // Increment sd_register and store it in a temp
-        Byte temp = this->ram->ReadByte(this->HL.word) - 1;
-
-        // Reset the flags
-        this->AF.last &= cy;
-
-        this->AF.last |= n;
-
-        if ((temp & 0x0F - 1) == 0x00) {
-            this->AF.last |= h;
-        }
+        Byte temp = this->ram->ReadByte(this->HL.word);
 
-        // Check if the operation resulted in 0
-        if (--temp == 0) {
-            this->AF.last |= zf;
-        }
+        DEC8(temp);
 
-        // Store the masked first byte in sd_register
         this->ram->WriteByte(this->HL.word, temp);
 
         // Update clocks
         this->M = 3; this->T = 12;
     }
 
-    // XX
+    // DAA: BCD adjust A after an add or subtract, using N, H and C from that op.
     void Z80::DAA() {
+        Word entry = daaTable.entry[ALU_DAA_INDEX(this->AF.first, GetF())];
+
+        this->AF.first = ALU_ENTRY_RESULT(entry);
+        SetF(ALU_ENTRY_FLAGS(entry));
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1911,29 +1450,31 @@ namespace Processor {
     void Z80::CPL() {
         this->AF.first ^= 0xFF;
 
-        this->AF.last |= n | h;
+        SetF(GetF() | n | h);
 
         // Update clocks
         this->M = 1; this->T = 4;
     }
 
     // ADDHLBC: function() { var hl=(Z80._r.h<<8)+Z80._r.l; hl+=(Z80._r.b<<8)+Z80._r.c; if(hl>65535) Z80._r.f|=0x10; else Z80._r.f&=0xEF; Z80._r.h=(hl>>8)&255; Z80._r.l=hl&255; Z80._r.m=3; Z80._r.t=12; }
-    void Z80::ADD_HL_RR(Register* src_register) {
+    template <REGISTER16 S> void Z80::ADD_HL_RR() {
         // Reset the flags
-        this->AF.last &= zf;
+        Byte f = GetF() & zf;
 
         // Check if there was a half carry
-        if (((this->HL.word & 0xFFF) + (src_register->word & 0xFFF)) > 0xFFF) {
-            this->AF.last |= h;
+        if (((this->HL.word & 0xFFF) + (this->Reg16<S>().word & 0xFFF)) > 0xFFF) {
+            f |= h;
         }
 
         // Set the carry flag
-        if ((this->HL.word + src_register->word) > 0xFFFF) {
-            this->AF.last |= cy;
+        if ((this->HL.word + this->Reg16<S>().word) > 0xFFFF) {
+            f |= cy;
         }
 
+        SetF(f);
+
         // Store the masked first word in HL
-        this->HL.word += src_register->word;
+        this->HL.word += this->Reg16<S>().word;
 
         // Update clocks
         this->M = 3; this->T = 12;
@@ -1942,23 +1483,25 @@ namespace Processor {
     // ADDSPn: function() { var i=MMU.rb(Z80._r.pc); if(i>127) i=-((~i+1)&255); Z80._r.pc++; Z80._r.sp+=i; Z80._r.m=4; Z80._r.t=16; },
     void Z80::ADD_SP_dd() {
         // Get D
-        char temp = this->ram->ReadByte(this->PC);
+        char temp = Imm8();
 
         ++this->PC;
 
         // Reset the flags
-        this->AF.last = 0;
+        Byte f = 0;
 
         // Check if there was a half carry
         if (((this->SP.word & 0xFFF) + (temp & 0xFFF)) > 0xFFF) {
-            this->AF.last |= h;
+            f |= h;
         }
 
         // Set the carry flag
         if (((int)this->SP.word + temp) > 0xFFFF) {
-            this->AF.last |= cy;
+            f |= cy;
         }
 
+        SetF(f);
+
         // Add d to SP
         this->SP.word += temp;
 
@@ -1967,16 +1510,16 @@ namespace Processor {
     }
 
     // INCBC: function() { Z80._r.c=(Z80._r.c+1)&255; if(!Z80._r.c) Z80._r.b=(Z80._r.b+1)&255; Z80._r.m=1; Z80._r.t=4; },
-    void Z80::INC_RR(Register* sd_register) {
-        ++sd_register->word;
+    template <REGISTER16 R> void Z80::INC_RR() {
+        ++this->Reg16<R>().word;
 
         // Update clocks
         this->M = 1; this->T = 4;
     }
 
     // DECBC: function() { Z80._r.c=(Z80._r.c-1)&255; if(Z80._r.c==255) Z80._r.b=(Z80._r.b-1)&255; Z80._r.m=1; Z80._r.t=4; },
-    void Z80::DEC_RR(Register* sd_register) {
-        --sd_register->word;
+    template <REGISTER16 R> void Z80::DEC_RR() {
+        --this->Reg16<R>().word;
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -1985,23 +1528,25 @@ namespace Processor {
     //LDHLSPn: function() { var i=MMU.rb(Z80._r.pc); if(i>127) i=-((~i+1)&255); Z80._r.pc++; i+=Z80._r.sp; Z80._r.h=(i>>8)&255; Z80._r.l=i&255; Z80._r.m=3; Z80._r.t=12; },
     void Z80::LD_HL_SPdd() {
         // Get d
-        char temp = this->ram->ReadByte(this->PC);
+        char temp = Imm8();
 
         ++this->PC;
 
         // Reset the flags
-        this->AF.last = 0;
+        Byte f = 0;
 
         // Check if there was a half carry
         if (((this->HL.word & 0x0F) + (temp & 0x0F) + (this->SP.word & 0x0F)) > 0x0F) {
-            this->AF.last |= h;
+            f |= h;
         }
 
         // Set the carry flag
         if (((int)this->SP.word + temp + (int)this->HL.word) > 0xFF) {
-            this->AF.last |= cy;
+            f |= cy;
         }
 
+        SetF(f);
+
         // Store SP in HL
         this->HL.word = this->SP.word + temp;
 
@@ -2016,7 +1561,7 @@ namespace Processor {
 
         this->AF.first = ((this->AF.first << 1) + ci) & 0xFF;
 
-        this->AF.last = co;
+        SetF(co);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -2024,12 +1569,12 @@ namespace Processor {
 
     // RLA: function() { var ci=Z80._r.f&0x10?1:0; var co=Z80._r.a&0x80?0x10:0; Z80._r.a=(Z80._r.a<<1)+ci; Z80._r.a&=255; Z80._r.f=(Z80._r.f&0xEF)+co; Z80._r.m=1; Z80._r.t=4; },
     void Z80::RLA() {
-        Byte ci = (this->AF.last & BIT4) ? 1 : 0;
+        Byte ci = CarryIn();
         Byte co = (this->AF.first & BIT7) ? 0x10 : 0;
 
         this->AF.first = ((this->AF.first << 1) + ci) & 0xFF;
 
-        this->AF.last = co;
+        SetF(co);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -2042,7 +1587,7 @@ namespace Processor {
 
         this->AF.first = ((this->AF.first >> 1) + ci) & 0xFF;
 
-        this->AF.last = co;
+        SetF(co);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -2050,12 +1595,12 @@ namespace Processor {
 
     // RRA: function() { var ci=Z80._r.f&0x10?0x80:0; var co=Z80._r.a&1?0x10:0; Z80._r.a=(Z80._r.a>>1)+ci; Z80._r.a&=255; Z80._r.f=(Z80._r.f&0xEF)+co; Z80._r.m=1; Z80._r.t=4; },
     void Z80::RRA() {
-        Byte ci = (this->AF.last & BIT4) ? 0x80 : 0;
+        Byte ci = CarryIn() ? 0x80 : 0;
         Byte co = (this->AF.first & 1) ? 0x10 : 0;
 
         this->AF.first = ((this->AF.first >> 1) + ci) & 0xFF;
 
-        this->AF.last = co;
+        SetF(co);
 
         // Update clocks
         this->M = 1; this->T = 4;
@@ -2063,7 +1608,7 @@ namespace Processor {
 
     // JPnn: function() { Z80._r.pc = MMU.rw(Z80._r.pc); Z80._r.m=3; Z80._r.t=12; },
     void Z80::JP_NN() {
-        this->PC = this->ram->ReadWord(this->PC);
+        this->PC = Imm16();
 
         // Update clocks
         this->M = 4; this->T = 16;
@@ -2078,9 +1623,9 @@ namespace Processor {
     }
 
     // JPZnn: function()  { Z80._r.m=3; Z80._r.t=12; if((Z80._r.f&0x80)==0x80) { Z80._r.pc=MMU.rw(Z80._r.pc); Z80._r.m++; Z80._r.t+=4; } else Z80._r.pc+=2; },
-    void Z80::JP_F_NN(FLAGS_REGISTER flag) {
-        if ((this->AF.last & flag) == flag) {
-            this->PC = this->ram->ReadWord(this->PC);
+    template <FLAGS_REGISTER F> void Z80::JP_F_NN() {
+        if ((GetF() & F) == F) {
+            this->PC = Imm16();
 
             // Update clocks
             this->M = 4; this->T = 16;
@@ -2092,9 +1637,9 @@ namespace Processor {
     }
 
     // JPNZnn: function() { Z80._r.m=3; Z80._r.t=12; if((Z80._r.f&0x80)==0x00) { Z80._r.pc=MMU.rw(Z80._r.pc); Z80._r.m++; Z80._r.t+=4; } else Z80._r.pc+=2; },
-    void Z80::JP_NOTF_NN(FLAGS_REGISTER flag) {
-        if ((this->AF.last & flag) == 0) {
-            this->PC = this->ram->ReadWord(this->PC);
+    template <FLAGS_REGISTER F> void Z80::JP_NOTF_NN() {
+        if ((GetF() & F) == 0) {
+            this->PC = Imm16();
 
             // Update clocks
             this->M = 4; this->T = 16;
@@ -2108,7 +1653,7 @@ namespace Processor {
 
     // JRn: function() { var i=MMU.rb(Z80._r.pc); if(i>127) i=-((~i+1)&255); Z80._r.pc++; Z80._r.m=2; Z80._r.t=8; Z80._r.pc+=i; Z80._r.m++; Z80._r.t+=4; },
     void Z80::JR_PCdd() {
-        this->PC += (char)this->ram->ReadByte(this->PC);
+        this->PC += (char)Imm8();
 
         ++this->PC;
 
@@ -2117,9 +1662,9 @@ namespace Processor {
     }
 
     // JRZn: function()  { var i=MMU.rb(Z80._r.pc); if(i>127) i=-((~i+1)&255); Z80._r.pc++; Z80._r.m=2; Z80._r.t=8; if((Z80._r.f&0x80)==0x80) { Z80._r.pc+=i; Z80._r.m++; Z80._r.t+=4; } },
-    void Z80::JR_F_PCdd(FLAGS_REGISTER flag) {
-        if ((this->AF.last & flag) == flag) {
-            this->PC += (char)this->ram->ReadByte(this->PC);
+    template <FLAGS_REGISTER F> void Z80::JR_F_PCdd() {
+        if ((GetF() & F) == F) {
+            this->PC += (char)Imm8();
 
             ++this->PC;
 
@@ -2135,9 +1680,9 @@ namespace Processor {
     }
 
     // JRNZn: function() { var i=MMU.rb(Z80._r.pc); if(i>127) i=-((~i+1)&255); Z80._r.pc++; Z80._r.m=2; Z80._r.t=8; if((Z80._r.f&0x80)==0x00) { Z80._r.pc+=i; Z80._r.m++; Z80._r.t+=4; } },
-    void Z80::JR_NOTF_PCdd(FLAGS_REGISTER flag) {
-        if ((this->AF.last & flag) == 0) {
-            this->PC += (char)this->ram->ReadByte(this->PC);
+    template <FLAGS_REGISTER F> void Z80::JR_NOTF_PCdd() {
+        if ((GetF() & F) == 0) {
+            this->PC += (char)Imm8();
 
             ++this->PC;
 
@@ -2158,20 +1703,20 @@ namespace Processor {
 
         this->ram->WriteWord(this->SP.word, this->PC + 2);
 
-        this->PC = this->ram->ReadWord(this->PC);
+        this->PC = Imm16();
 
         // Update clocks
         this->M = 6; this->T = 24;
     }
 
     // CALLZnn: function() { Z80._r.m=3; Z80._r.t=12; if((Z80._r.f&0x80)==0x80) { Z80._r.sp-=2; MMU.ww(Z80._r.sp,Z80._r.pc+2); Z80._r.pc=MMU.rw(Z80._r.pc); Z80._r.m+=2; Z80._r.t+=8; } else Z80._r.pc+=2; },
-    void Z80::CALL_F_NN(FLAGS_REGISTER flag) {
-        if ((this->AF.last & flag) == flag) {
+    template <FLAGS_REGISTER F> void Z80::CALL_F_NN() {
+        if ((GetF() & F) == F) {
             this->SP.word -= 2;
 
             this->ram->WriteWord(this->SP.word, this->PC + 2);
 
-            this->PC = this->ram->ReadWord(this->PC);
+            this->PC = Imm16();
 
             // Update clocks
             this->M = 6; this->T = 24;
@@ -2185,13 +1730,13 @@ namespace Processor {
     }
 
     // CALLNZnn: function() { Z80._r.m=3; Z80._r.t=12; if((Z80._r.f&0x80)==0x00) { Z80._r.sp-=2; MMU.ww(Z80._r.sp,Z80._r.pc+2); Z80._r.pc=MMU.rw(Z80._r.pc); Z80._r.m+=2; Z80._r.t+=8; } else Z80._r.pc+=2; },
-    void Z80::CALL_NOTF_NN(FLAGS_REGISTER flag) {
-        if ((this->AF.last & flag) == 0) {
+    template <FLAGS_REGISTER F> void Z80::CALL_NOTF_NN() {
+        if ((GetF() & F) == 0) {
             this->SP.word -= 2;
 
             this->ram->WriteWord(this->SP.word, this->PC + 2);
 
-            this->PC = this->ram->ReadWord(this->PC);
+            this->PC = Imm16();
 
             // Update clocks
             this->M = 6; this->T = 24;
@@ -2216,8 +1761,8 @@ namespace Processor {
     }
 
     // RETZ: function() { Z80._r.m=1; Z80._r.t=4; if((Z80._r.f&0x80)==0x80) { Z80._r.pc=MMU.rw(Z80._r.sp); Z80._r.sp+=2; Z80._r.m+=2; Z80._r.t+=8; } },
-    void Z80::RET_F(FLAGS_REGISTER flag) {
-        if ((this->AF.last & flag) == flag) {
+    template <FLAGS_REGISTER F> void Z80::RET_F() {
+        if ((GetF() & F) == F) {
             // Restore the PC from the address in SP
             this->PC = this->ram->ReadWord(this->SP.word);
 
@@ -2234,9 +1779,9 @@ namespace Processor {
     }
 
     // RETNZ: function() { Z80._r.m=1; Z80._r.t=4; if((Z80._r.f&0x80)==0x00) { Z80._r.pc=MMU.rw(Z80._r.sp); Z80._r.sp+=2; Z80._r.m+=2; Z80._r.t+=8; } },
-    void Z80::RET_NOTF(FLAGS_REGISTER flag) {
+    template <FLAGS_REGISTER F> void Z80::RET_NOTF() {
 
-        if ((this->AF.last & flag) == 0) {
+        if ((GetF() & F) == 0) {
             // Restore the PC from the address in SP
             this->PC = this->ram->ReadWord(this->SP.word);
 
@@ -2257,6 +1802,9 @@ namespace Processor {
     void Z80::RETI() {
         // Enable all interrupts
         this->IME = true;
+        if (this->pending != 0) {
+            CheckInterrupts();
+        }
 
         // Restore the PC from the address in SP
         this->PC = this->ram->ReadWord(this->SP.word);
@@ -2269,7 +1817,7 @@ namespace Processor {
     }
 
     // RST00: function() { Z80._r.sp-=2; MMU.ww(Z80._r.sp,Z80._r.pc); Z80._r.pc=0x00; Z80._r.m=3; Z80._r.t=12; },
-    void Z80::RST_N(Word nextPC) {
+    template <Word N> void Z80::RST_N() {
         // Move the stack up 2
         this->SP.word -= 2;
 
@@ -2277,7 +1825,7 @@ namespace Processor {
         this->ram->WriteWord(this->SP.word, this->PC);
 
         // Set the PC to the provided value
-        this->PC = nextPC;
+        this->PC = N;
 
         // Update clocks
         this->M = 3; this->T = 12;
@@ -0,0 +1,934 @@
+#include "../include/JIT.h"
+
+#include "../include/CPU.h"
+
+#if FEIGN_JIT
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace Processor {
+    // x86-64 general purpose registers by encoding.
+    enum HOST_REGISTER {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+    };
+
+    // Integer argument registers of the host calling convention.
+#if defined(_WIN32)
+#define HOST_ARG1 RCX
+#define HOST_ARG2 RDX
+#define HOST_ARG3 R8
+#else
+#define HOST_ARG1 RDI
+#define HOST_ARG2 RSI
+#define HOST_ARG3 RDX
+#endif
+
+    // Register assignment inside a compiled block. RBX holds the Z80*, R11 the carry flag (0 or 1) when
+    // the translator knows it, RAX/RCX/RDX are scratch.
+    static const int hostReg[8] = {
+        R13, // REG_B
+        R14, // REG_C
+        R15, // REG_D
+        RBP, // REG_E
+        RSI, // REG_H
+        RDI, // REG_L
+        -1, // (HL)
+        R12, // REG_A
+    };
+
+#define HOST_CPU RBX
+#define HOST_CARRY R11
+
+    // Stack frame below the saved registers: shadow space for calls, a spill slot for the carry and the
+    // total_T the block started at. Keeps RSP 16-byte aligned at calls.
+#define FRAME_SIZE 56
+#define FRAME_CARRY 32
+#define FRAME_START_T 40
+
+    // Room reserved per op and for the prologue, more than the longest sequence either emits.
+#define MAX_OP_CODE 768
+#define MAX_BLOCK_CODE 256
+
+    // ALU opcodes, reg/rm form (op r/m32, r32)
+#define X86_ADD 0x01
+#define X86_OR 0x09
+#define X86_AND 0x21
+#define X86_SUB 0x29
+#define X86_XOR 0x31
+
+    // Group 1 (0x81) and shift (0xC1) extensions
+#define X86_EXT_ADD 0
+#define X86_EXT_AND 4
+#define X86_EXT_SUB 5
+#define X86_EXT_SHL 4
+#define X86_EXT_SHR 5
+
+    // Condition codes
+#define X86_JE 0x4
+
+    // Minimal x86-64 encoder, only the forms the translator uses. Memory operands are always
+    // [base + disp32] or [base + index * scale].
+    class Emitter {
+    public:
+        Emitter(Byte* start) : p(start) {
+        }
+
+        Byte* p;
+
+        void Emit8(Byte b) {
+            *this->p++ = b;
+        }
+
+        void Emit16(Word w) {
+            memcpy(this->p, &w, 2);
+            this->p += 2;
+        }
+
+        void Emit32(unsigned int d) {
+            memcpy(this->p, &d, 4);
+            this->p += 4;
+        }
+
+        void Emit64(unsigned long long q) {
+            memcpy(this->p, &q, 8);
+            this->p += 8;
+        }
+
+        // REX prefix. force is for byte registers 4-7, which mean SPL-DIL only with a REX prefix.
+        void Rex(bool w, int reg, int index, int base, bool force = false) {
+            Byte rex = 0x40 | (w ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((index & 8) ? 0x02 : 0) | ((base & 8) ? 0x01 : 0);
+            if (rex != 0x40 || force) {
+                Emit8(rex);
+            }
+        }
+
+        void ModRMReg(int reg, int rm) {
+            Emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+        }
+
+        void ModRMDisp(int reg, int base, int disp) {
+            Emit8(0x80 | ((reg & 7) << 3) | (base & 7));
+            if ((base & 7) == RSP) {
+                Emit8(0x24);
+            }
+            Emit32(disp);
+        }
+
+        // base must not be RBP/R13, index must not be RSP
+        void ModRMIndex(int reg, int base, int index, int scale) {
+            Emit8(0x04 | ((reg & 7) << 3));
+            Emit8((scale << 6) | ((index & 7) << 3) | (base & 7));
+        }
+
+        // mov r32, imm32
+        void MovRegImm32(int r, unsigned int imm) {
+            Rex(false, 0, 0, r);
+            Emit8(0xB8 + (r & 7));
+            Emit32(imm);
+        }
+
+        // mov r64, imm64
+        void MovRegImm64(int r, const void* imm) {
+            Rex(true, 0, 0, r);
+            Emit8(0xB8 + (r & 7));
+            Emit64((unsigned long long)(size_t)imm);
+        }
+
+        // mov r32, r32
+        void MovRegReg32(int dst, int src) {
+            Rex(false, src, 0, dst);
+            Emit8(0x89);
+            ModRMReg(src, dst);
+        }
+
+        // mov r64, r64
+        void MovRegReg64(int dst, int src) {
+            Rex(true, src, 0, dst);
+            Emit8(0x89);
+            ModRMReg(src, dst);
+        }
+
+        // op r32, r32
+        void AluRegReg32(Byte op, int dst, int src) {
+            Rex(false, src, 0, dst);
+            Emit8(op);
+            ModRMReg(src, dst);
+        }
+
+        // op r32, imm32
+        void AluRegImm32(int ext, int dst, unsigned int imm) {
+            Rex(false, 0, 0, dst);
+            Emit8(0x81);
+            ModRMReg(ext, dst);
+            Emit32(imm);
+        }
+
+        // shl/shr r32, imm8
+        void ShiftRegImm(int ext, int r, Byte imm) {
+            Rex(false, 0, 0, r);
+            Emit8(0xC1);
+            ModRMReg(ext, r);
+            Emit8(imm);
+        }
+
+        // movzx r32, r8
+        void MovzxRegReg8(int dst, int src) {
+            Rex(false, dst, 0, src, src >= 4);
+            Emit8(0x0F);
+            Emit8(0xB6);
+            ModRMReg(dst, src);
+        }
+
+        // movzx r32, byte [base + disp]
+        void MovzxRegMem8(int dst, int base, int disp) {
+            Rex(false, dst, 0, base);
+            Emit8(0x0F);
+            Emit8(0xB6);
+            ModRMDisp(dst, base, disp);
+        }
+
+        // movzx r32, byte [base + index]
+        void MovzxRegIndex8(int dst, int base, int index) {
+            Rex(false, dst, index, base);
+            Emit8(0x0F);
+            Emit8(0xB6);
+            ModRMIndex(dst, base, index, 0);
+        }
+
+        // mov byte [base + disp], r8
+        void MovMem8Reg(int base, int disp, int src) {
+            Rex(false, src, 0, base, src >= 4);
+            Emit8(0x88);
+            ModRMDisp(src, base, disp);
+        }
+
+        // mov byte [base + index], r8
+        void MovIndex8Reg(int base, int index, int src) {
+            Rex(false, src, index, base, src >= 4);
+            Emit8(0x88);
+            ModRMIndex(src, base, index, 0);
+        }
+
+        // mov byte [base + disp], imm8
+        void MovMem8Imm(int base, int disp, Byte imm) {
+            Rex(false, 0, 0, base);
+            Emit8(0xC6);
+            ModRMDisp(0, base, disp);
+            Emit8(imm);
+        }
+
+        // mov byte [base + index], imm8
+        void MovIndex8Imm(int base, int index, Byte imm) {
+            Rex(false, 0, index, base);
+            Emit8(0xC6);
+            ModRMIndex(0, base, index, 0);
+            Emit8(imm);
+        }
+
+        // mov word [base + disp], imm16
+        void MovMem16Imm(int base, int disp, Word imm) {
+            Emit8(0x66);
+            Rex(false, 0, 0, base);
+            Emit8(0xC7);
+            ModRMDisp(0, base, disp);
+            Emit16(imm);
+        }
+
+        // mov r64, [base + disp]
+        void MovRegMem64(int dst, int base, int disp) {
+            Rex(true, dst, 0, base);
+            Emit8(0x8B);
+            ModRMDisp(dst, base, disp);
+        }
+
+        // mov r64, [base + index * 8]
+        void MovRegIndex64(int dst, int base, int index) {
+            Rex(true, dst, index, base);
+            Emit8(0x8B);
+            ModRMIndex(dst, base, index, 3);
+        }
+
+        // mov [base + disp], r64
+        void MovMem64Reg(int base, int disp, int src) {
+            Rex(true, src, 0, base);
+            Emit8(0x89);
+            ModRMDisp(src, base, disp);
+        }
+
+        // movsxd r64, dword [base + disp]
+        void MovsxdRegMem(int dst, int base, int disp) {
+            Rex(true, dst, 0, base);
+            Emit8(0x63);
+            ModRMDisp(dst, base, disp);
+        }
+
+        // add/sub qword [base + disp], imm32
+        void AluMem64Imm(int ext, int base, int disp, int imm) {
+            Rex(true, 0, 0, base);
+            Emit8(0x81);
+            ModRMDisp(ext, base, disp);
+            Emit32(imm);
+        }
+
+        // add/sub dword [base + disp], imm32
+        void AluMem32Imm(int ext, int base, int disp, int imm) {
+            Rex(false, 0, 0, base);
+            Emit8(0x81);
+            ModRMDisp(ext, base, disp);
+            Emit32(imm);
+        }
+
+        // add qword [base + disp], r64
+        void AddMem64Reg(int base, int disp, int src) {
+            Rex(true, src, 0, base);
+            Emit8(0x01);
+            ModRMDisp(src, base, disp);
+        }
+
+        // sub r64, [base + disp]
+        void SubRegMem64(int dst, int base, int disp) {
+            Rex(true, dst, 0, base);
+            Emit8(0x2B);
+            ModRMDisp(dst, base, disp);
+        }
+
+        // cmp byte [base + disp], imm8
+        void CmpMem8Imm(int base, int disp, Byte imm) {
+            Rex(false, 0, 0, base);
+            Emit8(0x80);
+            ModRMDisp(7, base, disp);
+            Emit8(imm);
+        }
+
+        // test r64, r64
+        void TestRegReg64(int a, int b) {
+            Rex(true, b, 0, a);
+            Emit8(0x85);
+            ModRMReg(b, a);
+        }
+
+        // inc/dec r32
+        void IncReg32(int r) {
+            Rex(false, 0, 0, r);
+            Emit8(0xFF);
+            ModRMReg(0, r);
+        }
+
+        void DecReg32(int r) {
+            Rex(false, 0, 0, r);
+            Emit8(0xFF);
+            ModRMReg(1, r);
+        }
+
+        void Push(int r) {
+            Rex(false, 0, 0, r);
+            Emit8(0x50 + (r & 7));
+        }
+
+        void Pop(int r) {
+            Rex(false, 0, 0, r);
+            Emit8(0x58 + (r & 7));
+        }
+
+        // add/sub rsp, imm8
+        void AddRsp(Byte imm) {
+            Emit8(0x48);
+            Emit8(0x83);
+            Emit8(0xC4);
+            Emit8(imm);
+        }
+
+        void SubRsp(Byte imm) {
+            Emit8(0x48);
+            Emit8(0x83);
+            Emit8(0xEC);
+            Emit8(imm);
+        }
+
+        // call r64
+        void CallReg(int r) {
+            Rex(false, 0, 0, r);
+            Emit8(0xFF);
+            ModRMReg(2, r);
+        }
+
+        void Ret() {
+            Emit8(0xC3);
+        }
+
+        // jcc/jmp rel32 to be patched, returns the location of the displacement
+        Byte* Jcc(Byte cc) {
+            Emit8(0x0F);
+            Emit8(0x80 + cc);
+            Emit32(0);
+            return this->p - 4;
+        }
+
+        Byte* Jmp() {
+            Emit8(0xE9);
+            Emit32(0);
+            return this->p - 4;
+        }
+
+        // Point a jump at the current position
+        void Patch(Byte* at) {
+            int rel = (int)(this->p - (at + 4));
+            memcpy(at, &rel, 4);
+        }
+    };
+
+    // Callee-saved registers pushed by the prologue, RSI/RDI are callee-saved on Windows.
+    static const int savedRegs[8] = { RBX, RBP, RSI, RDI, R12, R13, R14, R15 };
+
+    // Emits one block. Keeps track of cycles not yet added to total_T and whether the carry is in R11.
+    class Translator {
+    public:
+        Translator(Recompiler& r, Byte* start) : e(start), off(r.off), mmu(nullptr), pendingT(0), pendingM(0), pendingOps(0), carryKnown(false) {
+        }
+
+        Emitter e;
+        const Recompiler::Offsets& off;
+        Memory::MMU* mmu;
+
+        int pendingT;
+        int pendingM;
+        int pendingOps;
+        bool carryKnown;
+
+        void LoadRegs() {
+            for (int r = 0; r < 8; ++r) {
+                if (hostReg[r] >= 0) {
+                    this->e.MovzxRegMem8(hostReg[r], HOST_CPU, this->off.reg[r]);
+                }
+            }
+        }
+
+        void StoreRegs() {
+            for (int r = 0; r < 8; ++r) {
+                if (hostReg[r] >= 0) {
+                    this->e.MovMem8Reg(HOST_CPU, this->off.reg[r], hostReg[r]);
+                }
+            }
+        }
+
+        // Add (or with ext SUB, take back) cycle and instruction counts
+        void EmitCycles(int ext, int t, int m, int ops) {
+            if (t != 0) {
+                this->e.AluMem64Imm(ext, HOST_CPU, this->off.totalT, t);
+            }
+            if (m != 0) {
+                this->e.AluMem64Imm(ext, HOST_CPU, this->off.totalM, m);
+            }
+            if (ops != 0) {
+                this->e.AluMem32Imm(ext, HOST_CPU, this->off.numInstructions, ops);
+            }
+        }
+
+        void FlushCycles() {
+            EmitCycles(X86_EXT_ADD, this->pendingT, this->pendingM, this->pendingOps);
+            this->pendingT = 0;
+            this->pendingM = 0;
+            this->pendingOps = 0;
+        }
+
+        void Prologue() {
+            for (int i = 0; i < 8; ++i) {
+                this->e.Push(savedRegs[i]);
+            }
+            this->e.SubRsp(FRAME_SIZE);
+
+            this->e.MovRegReg64(HOST_CPU, HOST_ARG1);
+            this->e.MovRegMem64(RAX, HOST_CPU, this->off.totalT);
+            this->e.MovMem64Reg(RSP, FRAME_START_T, RAX);
+
+            LoadRegs();
+        }
+
+        // Leave the block. Adds the extra cycles on top of the pending ones without consuming them, so
+        // early exits can be emitted in the middle of a block.
+        void Exit(bool setPC, Word pc, int t, int m, int ops) {
+            StoreRegs();
+            EmitCycles(X86_EXT_ADD, this->pendingT + t, this->pendingM + m, this->pendingOps + ops);
+
+            if (setPC) {
+                this->e.MovMem16Imm(HOST_CPU, this->off.pc, pc);
+            }
+
+            // Return the T-cycles spent in the block
+            this->e.MovRegMem64(RAX, HOST_CPU, this->off.totalT);
+            this->e.SubRegMem64(RAX, RSP, FRAME_START_T);
+
+            this->e.AddRsp(FRAME_SIZE);
+            for (int i = 7; i >= 0; --i) {
+                this->e.Pop(savedRegs[i]);
+            }
+            this->e.Ret();
+        }
+
+        // Call fn with the guest registers written back and reloaded afterwards, since the call may
+        // clobber any caller-saved host register.
+        void CallHelper(const void* fn) {
+            this->e.MovRegImm64(RAX, fn);
+            this->e.CallReg(RAX);
+        }
+
+        // Fetch the carry flag into R11
+        void EmitCarryIn() {
+            StoreRegs();
+            this->e.MovRegReg64(HOST_ARG1, HOST_CPU);
+            CallHelper((const void*)&Recompiler::CarryInThunk);
+            this->e.MovzxRegReg8(HOST_CARRY, RAX);
+            LoadRegs();
+
+            this->carryKnown = true;
+        }
+
+        // RCX = (hi << 8) | lo
+        void EmitAddress(int hi, int lo) {
+            this->e.MovRegReg32(RCX, hostReg[hi]);
+            this->e.ShiftRegImm(X86_EXT_SHL, RCX, 8);
+            this->e.AluRegReg32(X86_OR, RCX, hostReg[lo]);
+        }
+
+        // EAX = byte at (hi << 8) | lo
+        void EmitRead(int hi, int lo) {
+            EmitAddress(hi, lo);
+
+            this->e.MovRegReg32(RAX, RCX);
+            this->e.ShiftRegImm(X86_EXT_SHR, RAX, PAGE_SHIFT);
+            this->e.MovRegImm64(RDX, this->mmu->GetReadPages());
+            this->e.MovRegIndex64(RDX, RDX, RAX);
+            this->e.TestRegReg64(RDX, RDX);
+            Byte* slow = this->e.Jcc(X86_JE);
+
+            this->e.MovzxRegReg8(RCX, RCX);
+            this->e.MovzxRegIndex8(RAX, RDX, RCX);
+            Byte* done = this->e.Jmp();
+
+            // No host page (IO), ask the MMU. total_T must be current for timer reads.
+            this->e.Patch(slow);
+            EmitCycles(X86_EXT_ADD, this->pendingT, this->pendingM, this->pendingOps);
+            StoreRegs();
+            this->e.MovMem64Reg(RSP, FRAME_CARRY, HOST_CARRY);
+            this->e.MovRegReg32(HOST_ARG2, RCX);
+            this->e.MovRegImm64(HOST_ARG1, this->mmu);
+            CallHelper((const void*)&Recompiler::ReadThunk);
+            this->e.MovzxRegReg8(RAX, RAX);
+            this->e.MovRegMem64(HOST_CARRY, RSP, FRAME_CARRY);
+            LoadRegs();
+            EmitCycles(X86_EXT_SUB, this->pendingT, this->pendingM, this->pendingOps);
+
+            this->e.Patch(done);
+        }
+
+        // Write src (a guest register, or imm when src is -1) to (hi << 8) | lo, then step hi:lo by
+        // step. A write that drops cached code ends the block after this op, which takes t/m cycles
+        // and ends at next.
+        void EmitWrite(int hi, int lo, int src, Byte imm, int step, Word next, int t, int m) {
+            EmitAddress(hi, lo);
+            if (step != 0) {
+                EmitStep16(hi, lo, step > 0);
+            }
+
+            this->e.MovRegReg32(RAX, RCX);
+            this->e.ShiftRegImm(X86_EXT_SHR, RAX, PAGE_SHIFT);
+            this->e.MovRegImm64(RDX, this->mmu->GetWritePages());
+            this->e.MovRegIndex64(RDX, RDX, RAX);
+            this->e.TestRegReg64(RDX, RDX);
+            Byte* slow = this->e.Jcc(X86_JE);
+
+            this->e.MovzxRegReg8(RCX, RCX);
+            if (src >= 0) {
+                this->e.MovIndex8Reg(RDX, RCX, hostReg[src]);
+            }
+            else {
+                this->e.MovIndex8Imm(RDX, RCX, imm);
+            }
+            Byte* done = this->e.Jmp();
+
+            // ROM, IO or a page holding cached code
+            this->e.Patch(slow);
+            EmitCycles(X86_EXT_ADD, this->pendingT, this->pendingM, this->pendingOps);
+            StoreRegs();
+            this->e.MovMem64Reg(RSP, FRAME_CARRY, HOST_CARRY);
+            if (src >= 0) {
+                this->e.MovzxRegReg8(HOST_ARG3, hostReg[src]);
+            }
+            else {
+                this->e.MovRegImm32(HOST_ARG3, imm);
+            }
+            this->e.MovRegReg32(HOST_ARG2, RCX);
+            this->e.MovRegImm64(HOST_ARG1, this->mmu);
+            CallHelper((const void*)&Recompiler::WriteThunk);
+            this->e.MovRegMem64(HOST_CARRY, RSP, FRAME_CARRY);
+            LoadRegs();
+            EmitCycles(X86_EXT_SUB, this->pendingT, this->pendingM, this->pendingOps);
+
+            this->e.CmpMem8Imm(HOST_CPU, this->off.blockDirty, 0);
+            Byte* clean = this->e.Jcc(X86_JE);
+            Exit(true, next, t, m, 1);
+            this->e.Patch(clean);
+
+            this->e.Patch(done);
+        }
+
+        // hi:lo += 1 or -= 1, leaves RCX alone
+        void EmitStep16(int hi, int lo, bool inc) {
+            this->e.MovRegReg32(RAX, hostReg[hi]);
+            this->e.ShiftRegImm(X86_EXT_SHL, RAX, 8);
+            this->e.AluRegReg32(X86_OR, RAX, hostReg[lo]);
+            if (inc) {
+                this->e.IncReg32(RAX);
+            }
+            else {
+                this->e.DecReg32(RAX);
+            }
+            this->e.MovzxRegReg8(hostReg[lo], RAX);
+            this->e.ShiftRegImm(X86_EXT_SHR, RAX, 8);
+            this->e.MovzxRegReg8(hostReg[hi], RAX);
+        }
+
+        // Record the flags of an ALU op for later, the same record Z80::DeferFlags writes
+        void EmitDefer(Byte op, int a, int b, bool carry) {
+            this->e.MovMem8Imm(HOST_CPU, this->off.lazyOp, op);
+            this->e.MovMem8Reg(HOST_CPU, this->off.lazyA, a);
+            if (b >= 0) {
+                this->e.MovMem8Reg(HOST_CPU, this->off.lazyB, b);
+            }
+            else {
+                this->e.MovMem8Imm(HOST_CPU, this->off.lazyB, 0);
+            }
+            if (carry) {
+                this->e.MovMem8Reg(HOST_CPU, this->off.lazyCarry, HOST_CARRY);
+            }
+            else {
+                this->e.MovMem8Imm(HOST_CPU, this->off.lazyCarry, 0);
+            }
+        }
+
+        // ADC and SBC need the carry, fetch it before the operand as the call clobbers scratch registers
+        void EmitAluCarryIn(int kind) {
+            if ((kind == 1 || kind == 3) && !this->carryKnown) {
+                EmitCarryIn();
+            }
+        }
+
+        // 8-bit ALU op on A. kind is bits 3-5 of the opcode (ADD ADC SUB SBC AND XOR OR CP), src a host register.
+        void EmitAlu(int kind, int src) {
+            int a = hostReg[REG_A];
+
+            switch (kind) {
+            case 0: case 1: case 2: case 3: case 7: {
+                bool sub = (kind >= 2);
+                bool carry = (kind == 1 || kind == 3);
+
+                EmitDefer(sub ? LAZY_SUB : LAZY_ADD, a, src, carry);
+
+                // Work in 32 bits, bit 8 of the result is the carry/borrow
+                this->e.MovRegReg32(RAX, a);
+                this->e.AluRegReg32(sub ? X86_SUB : X86_ADD, RAX, src);
+                if (carry) {
+                    this->e.AluRegReg32(sub ? X86_SUB : X86_ADD, RAX, HOST_CARRY);
+                }
+                this->e.MovRegReg32(HOST_CARRY, RAX);
+                this->e.ShiftRegImm(X86_EXT_SHR, HOST_CARRY, 8);
+                this->e.AluRegImm32(X86_EXT_AND, HOST_CARRY, 1);
+
+                if (kind != 7) {
+                    this->e.MovzxRegReg8(a, RAX);
+                }
+                break;
+            }
+            default: {
+                static const Byte logic[3] = { X86_AND, X86_XOR, X86_OR };
+
+                this->e.AluRegReg32(logic[kind - 4], a, src);
+                EmitDefer((kind == 4) ? LAZY_AND : LAZY_LOGIC, a, -1, false);
+                this->e.AluRegReg32(X86_XOR, HOST_CARRY, HOST_CARRY);
+                break;
+            }
+            }
+
+            this->carryKnown = true;
+        }
+
+        // Run the op through its interpreter handler.
+        void EmitFallback(const DecodedOp& op, Word address, bool last) {
+            ++this->pendingOps;
+            FlushCycles();
+            StoreRegs();
+
+            this->e.MovMem16Imm(HOST_CPU, this->off.pc, address + op.prefix);
+            this->e.MovMem16Imm(HOST_CPU, this->off.imm, op.imm);
+            this->e.MovRegReg64(HOST_ARG1, HOST_CPU);
+            CallHelper((const void*)op.handler);
+
+            // The handler sets M/T, including the taken/not taken cost of branches
+            this->e.MovsxdRegMem(RAX, HOST_CPU, this->off.t);
+            this->e.AddMem64Reg(HOST_CPU, this->off.totalT, RAX);
+            this->e.MovsxdRegMem(RAX, HOST_CPU, this->off.m);
+            this->e.AddMem64Reg(HOST_CPU, this->off.totalM, RAX);
+
+            LoadRegs();
+            this->carryKnown = false;
+
+            if (!last) {
+                this->e.CmpMem8Imm(HOST_CPU, this->off.blockDirty, 0);
+                Byte* clean = this->e.Jcc(X86_JE);
+                Exit(false, 0, 0, 0, 0);
+                this->e.Patch(clean);
+            }
+        }
+
+        // Translate op if there is a native version. Returns false if it must fall back.
+        bool EmitNative(const DecodedOp& op, Word next) {
+            Byte code = op.op;
+            int t = 0;
+            int m = 0;
+
+            if (op.prefix != 1) {
+                return false;
+            }
+
+            // LD r, r' / LD r, (HL) / LD (HL), r
+            if (code >= 0x40 && code < 0x80 && code != 0x76) {
+                int dst = (code >> 3) & 7;
+                int src = code & 7;
+
+                if (src == 6) {
+                    EmitRead(REG_H, REG_L);
+                    this->e.MovRegReg32(hostReg[dst], RAX);
+                    t = 8; m = 2;
+                }
+                else if (dst == 6) {
+                    EmitWrite(REG_H, REG_L, src, 0, 0, next, 8, 2);
+                    t = 8; m = 2;
+                }
+                else {
+                    if (dst != src) {
+                        this->e.MovRegReg32(hostReg[dst], hostReg[src]);
+                    }
+                    t = 4; m = 1;
+                }
+            }
+            // ALU A, r / ALU A, (HL)
+            else if (code >= 0x80 && code < 0xC0) {
+                int src = code & 7;
+
+                EmitAluCarryIn((code >> 3) & 7);
+
+                if (src == 6) {
+                    EmitRead(REG_H, REG_L);
+                    this->e.MovRegReg32(RDX, RAX);
+                    EmitAlu((code >> 3) & 7, RDX);
+                    t = 8; m = 2;
+                }
+                else {
+                    EmitAlu((code >> 3) & 7, hostReg[src]);
+                    t = 4; m = 1;
+                }
+            }
+            // ALU A, n
+            else if ((code & 0xC7) == 0xC6) {
+                EmitAluCarryIn((code >> 3) & 7);
+                this->e.MovRegImm32(RDX, op.imm);
+                EmitAlu((code >> 3) & 7, RDX);
+                t = 8; m = 2;
+            }
+            // LD r, n / LD (HL), n
+            else if (code < 0x40 && (code & 0x07) == 0x06) {
+                int dst = (code >> 3) & 7;
+
+                if (dst == 6) {
+                    EmitWrite(REG_H, REG_L, -1, (Byte)op.imm, 0, next, 12, 3);
+                    t = 12; m = 3;
+                }
+                else {
+                    this->e.MovRegImm32(hostReg[dst], op.imm);
+                    t = 8; m = 2;
+                }
+            }
+            // INC r / DEC r, the carry is preserved so it has to be known first
+            else if (code < 0x40 && ((code & 0x07) == 0x04 || (code & 0x07) == 0x05) && ((code >> 3) & 7) != 6) {
+                int r = hostReg[(code >> 3) & 7];
+                bool inc = ((code & 0x07) == 0x04);
+
+                if (!this->carryKnown) {
+                    EmitCarryIn();
+                }
+
+                EmitDefer(inc ? LAZY_INC : LAZY_DEC, r, -1, true);
+                if (inc) {
+                    this->e.IncReg32(r);
+                }
+                else {
+                    this->e.DecReg32(r);
+                }
+                this->e.MovzxRegReg8(r, r);
+                t = 4; m = 1;
+            }
+            else {
+                switch (code) {
+                case 0x00: // NOP
+                t = 4; m = 1;
+                break;
+                case 0x01: case 0x11: case 0x21: { // LD rr, nn
+                    int hi = (code >> 3) & 6;
+                    this->e.MovRegImm32(hostReg[hi], op.imm >> 8);
+                    this->e.MovRegImm32(hostReg[hi + 1], op.imm & 0xFF);
+                    t = 12; m = 3;
+                    break;
+                }
+                case 0x03: case 0x13: case 0x23: // INC rr
+                EmitStep16((code >> 3) & 6, ((code >> 3) & 6) + 1, true);
+                t = 4; m = 1;
+                break;
+                case 0x0B: case 0x1B: case 0x2B: // DEC rr
+                EmitStep16((code >> 3) & 6, ((code >> 3) & 6) + 1, false);
+                t = 4; m = 1;
+                break;
+                case 0x0A: // LD A, (BC)
+                EmitRead(REG_B, REG_C);
+                this->e.MovRegReg32(hostReg[REG_A], RAX);
+                t = 8; m = 2;
+                break;
+                case 0x1A: // LD A, (DE)
+                EmitRead(REG_D, REG_E);
+                this->e.MovRegReg32(hostReg[REG_A], RAX);
+                t = 8; m = 2;
+                break;
+                case 0x02: // LD (BC), A
+                EmitWrite(REG_B, REG_C, REG_A, 0, 0, next, 8, 2);
+                t = 8; m = 2;
+                break;
+                case 0x12: // LD (DE), A
+                EmitWrite(REG_D, REG_E, REG_A, 0, 0, next, 8, 2);
+                t = 8; m = 2;
+                break;
+                case 0x22: case 0x32: // LD (HL+), A / LD (HL-), A
+                EmitWrite(REG_H, REG_L, REG_A, 0, (code == 0x22) ? 1 : -1, next, 8, 2);
+                t = 8; m = 2;
+                break;
+                case 0x2A: case 0x3A: // LD A, (HL+) / LD A, (HL-)
+                EmitRead(REG_H, REG_L);
+                this->e.MovRegReg32(hostReg[REG_A], RAX);
+                EmitStep16(REG_H, REG_L, code == 0x2A);
+                t = 8; m = 2;
+                break;
+                default:
+                return false;
+                }
+            }
+
+            this->pendingT += t;
+            this->pendingM += m;
+            ++this->pendingOps;
+
+            return true;
+        }
+    };
+
+    Recompiler::Recompiler() : cpu(nullptr), code(nullptr), used(0) {
+#if defined(_WIN32)
+        this->code = (Byte*)VirtualAlloc(nullptr, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+        void* mem = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        this->code = (mem != MAP_FAILED) ? (Byte*)mem : nullptr;
+#endif
+    }
+
+    Recompiler::~Recompiler() {
+        if (this->code != nullptr) {
+#if defined(_WIN32)
+            VirtualFree(this->code, 0, MEM_RELEASE);
+#else
+            munmap(this->code, JIT_CODE_SIZE);
+#endif
+        }
+    }
+
+    void Recompiler::SetCPU(Z80* p) {
+        Byte* base = (Byte*)p;
+
+        this->cpu = p;
+
+        this->off.reg[REG_B] = (int)((Byte*)&p->Reg<REG_B>() - base);
+        this->off.reg[REG_C] = (int)((Byte*)&p->Reg<REG_C>() - base);
+        this->off.reg[REG_D] = (int)((Byte*)&p->Reg<REG_D>() - base);
+        this->off.reg[REG_E] = (int)((Byte*)&p->Reg<REG_E>() - base);
+        this->off.reg[REG_H] = (int)((Byte*)&p->Reg<REG_H>() - base);
+        this->off.reg[REG_L] = (int)((Byte*)&p->Reg<REG_L>() - base);
+        this->off.reg[6] = 0;
+        this->off.reg[REG_A] = (int)((Byte*)&p->Reg<REG_A>() - base);
+        this->off.pc = (int)((Byte*)&p->PC - base);
+        this->off.imm = (int)((Byte*)&p->imm - base);
+        this->off.m = (int)((Byte*)&p->M - base);
+        this->off.t = (int)((Byte*)&p->T - base);
+        this->off.totalM = (int)((Byte*)&p->total_M - base);
+        this->off.totalT = (int)((Byte*)&p->total_T - base);
+        this->off.numInstructions = (int)((Byte*)&p->numInstructions - base);
+        this->off.blockDirty = (int)((Byte*)&p->blockDirty - base);
+        this->off.lazyOp = (int)((Byte*)&p->lazy.op - base);
+        this->off.lazyA = (int)((Byte*)&p->lazy.a - base);
+        this->off.lazyB = (int)((Byte*)&p->lazy.b - base);
+        this->off.lazyCarry = (int)((Byte*)&p->lazy.carry - base);
+    }
+
+    bool Recompiler::Compile(Block& block) {
+        size_t worst = MAX_BLOCK_CODE + block.ops.size() * MAX_OP_CODE;
+        if (this->code == nullptr || this->used + worst > JIT_CODE_SIZE) {
+            return false;
+        }
+
+        Byte* start = this->code + this->used;
+        Translator tr(*this, start);
+        tr.mmu = this->cpu->ram;
+
+        tr.Prologue();
+
+        Word address = block.pc;
+        bool native = true;
+        for (size_t i = 0; i < block.ops.size(); ++i) {
+            const DecodedOp& op = block.ops[i];
+            Word next = address + op.length;
+
+            native = tr.EmitNative(op, next);
+            if (!native) {
+                tr.EmitFallback(op, address, i + 1 == block.ops.size());
+            }
+
+            address = next;
+        }
+
+        // After a fallback the handler has already moved PC, including for branches
+        tr.Exit(native, address, 0, 0, 0);
+
+        this->used += tr.e.p - start;
+        block.native = start;
+
+        return true;
+    }
+
+    void Recompiler::Reset() {
+        this->used = 0;
+    }
+
+    Byte Recompiler::ReadThunk(Memory::MMU* mmu, Word address) {
+        return mmu->ReadByte(address);
+    }
+
+    void Recompiler::WriteThunk(Memory::MMU* mmu, Word address, Byte val) {
+        mmu->WriteByte(address, val);
+    }
+
+    Byte Recompiler::CarryInThunk(Z80* cpu) {
+        return cpu->CarryIn();
+    }
+}
+
+#endif
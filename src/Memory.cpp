@@ -3,9 +3,32 @@
 #include <memory>
 
 #include "../include/CPU.h"
+#include "../include/Timer.h"
+#include "../include/TileCache.h"
+#include "../include/SpriteIndex.h"
 
 namespace Memory {
-    MMU::MMU() : _rom(nullptr) {
+    // The RTC counts seconds of the 4.194304MHz CPU clock.
+#define RTC_CYCLES_PER_SECOND 4194304
+
+    // OAM DMA copies one byte per M-cycle.
+#define DMA_CYCLES_PER_BYTE 4
+#define DMA_LENGTH (OAM_END - OAM_START)
+
+    // HDMA moves 16 bytes at a time, taking 32 cycles of the base clock for each.
+#define HDMA_BLOCK_SIZE 16
+#define HDMA_CYCLES_PER_BLOCK 32
+
+    Byte MMU::unmapped[PAGE_SIZE];
+
+    template <> void MMU::WriteMBC<MBC_NONE>(Word address, Byte val);
+    template <> void MMU::WriteMBC<MBC_1>(Word address, Byte val);
+    template <> void MMU::WriteMBC<MBC_2>(Word address, Byte val);
+    template <> void MMU::WriteMBC<MBC_3>(Word address, Byte val);
+    template <> void MMU::WriteMBC<MBC_5>(Word address, Byte val);
+
+    MMU::MMU() : _rom(nullptr), romOwned(false), ROMSize(0), cpu(nullptr), timer(nullptr), tiles(nullptr), sprites(nullptr),
+        dmaActive(false), dmaSource(0), dmaIndex(0), cgb(false), vramBank(0), hdmaActive(false), hdmaSource(0), hdmaDest(0), hdmaBlocks(0) {
         unsigned char bios[] = {
             0x31, 0xFE, 0xFF, 0xAF, 0x21, 0xFF, 0x9F, 0x32, 0xCB, 0x7C, 0x20, 0xFB, 0x21, 0x26, 0xFF, 0x0E,
             0x11, 0x3E, 0x80, 0x32, 0xE2, 0x0C, 0x3E, 0xF3, 0xE2, 0x32, 0x3E, 0x77, 0x77, 0x3E, 0xFC, 0xE0,
@@ -27,16 +50,37 @@ namespace Memory {
 
         memcpy(this->_bios, &bios, 256);
         memset(this->ram, 0, sizeof(this->ram));
+        memset(this->vram1, 0, sizeof(this->vram1));
 
         this->_inbios = false;
 
-        this->romOffset = 0x4000;
-        this->ramOffset = 0x0000;
+        this->cartType = 0;
+        this->mbc = MBC_NONE;
+        this->writeMBC = &MMU::WriteMBC<MBC_NONE>;
 
         this->rombank = 1;
+        this->rombank0 = 0;
         this->rambank = 0;
+        this->bankHigh = 0;
         this->ramOn = false;
         this->mode = 0;
+
+        memset(&this->rtc, 0, sizeof(this->rtc));
+
+        memset(unmapped, 0xFF, sizeof(unmapped));
+        memset(this->codeWatch, 0, sizeof(this->codeWatch));
+        memset(this->io, 0, sizeof(this->io));
+
+        // ROM and the MBC registers behind it (0000-7FFF), nothing is loaded yet.
+        MapPages(0x0000, 0x8000, nullptr, nullptr);
+        // VRAM, external RAM and WRAM (8000-DFFF). External RAM stays unmapped until a cartridge has some.
+        MapPages(0x8000, 0x6000, this->ram, this->ram);
+        MapRAMBank();
+        // Echo of WRAM (E000-FDFF)
+        MapPages(0xE000, 0x1E00, &this->ram[0xC000 - 0x8000], &this->ram[0xC000 - 0x8000]);
+        // OAM, IO and HRAM (FE00-FFFF)
+        MapPages(0xFE00, 0x0200, &this->ram[0xFE00 - 0x8000], &this->ram[0xFE00 - 0x8000]);
+
         WriteByte(0xFF05, 0x00);
         WriteByte(0xFF06, 0x00);
         WriteByte(0xFF07, 0x00);
@@ -59,81 +103,696 @@ namespace Memory {
         WriteByte(0xFF25, 0xF3);
         WriteByte(0xFF26, 0xF1);
         WriteByte(0xFFFF, 0x00);
+
+        // IO registers and HRAM (FF00-FFFF) go through ReadControl/WriteControl so registers can have side effects.
+        this->readPage[0xFF00 >> PAGE_SHIFT] = nullptr;
+        this->writePage[0xFF00 >> PAGE_SHIFT] = nullptr;
     }
 
     MMU::~MMU() {
-        if (this->_rom != nullptr) {
-            delete[] this->_rom;
-        }
+        FreeROM();
+    }
+
+    // IF/IE write, something may now be ready to service.
+    static void WriteInterrupts(void* device, Word address, Byte val) {
+        ((Processor::Z80*)device)->UpdateInterrupts();
+    }
+
+    static Byte ReadTimer(void* device, Word address) {
+        return ((Timing::Timer*)device)->Read(address);
+    }
+
+    static void WriteTimer(void* device, Word address, Byte val) {
+        ((Timing::Timer*)device)->Write(address, val);
+    }
+
+    static Byte ReadKEY1(void* device, Word address) {
+        return ((Processor::Z80*)device)->ReadKEY1();
+    }
+
+    static void WriteKEY1(void* device, Word address, Byte val) {
+        ((Processor::Z80*)device)->WriteKEY1(val);
     }
 
     void MMU::SetCPU(Processor::Z80* p) {
         this->cpu = p;
+
+        MapIO(0xFF0F, nullptr, &WriteInterrupts, p);
+        MapIO(0xFFFF, nullptr, &WriteInterrupts, p);
+
+        // KEY1, CGB speed switch
+        MapIO(0xFF4D, &ReadKEY1, &WriteKEY1, p);
     }
 
-    void MMU::AllocateROM(unsigned int size, unsigned char* data /*= nullptr*/) {
-        this->_rom = new unsigned char[size];
-        this->ROMSize = size;
-        memset(this->_rom, 0, this->ROMSize);
+    void MMU::SetTimer(Timing::Timer* t) {
+        this->timer = t;
+
+        // DIV and TIMA are worked out from the clock when read
+        for (Word address = Timing::DIV; address <= Timing::TAC; ++address) {
+            MapIO(address, &ReadTimer, &WriteTimer, t);
+        }
+    }
+
+    void MMU::SetTileCache(Video::TileCache* t) {
+        this->tiles = t;
+
+        MapVRAMBank();
+
+        if (t != nullptr) {
+            t->SetVRAM(this->ram, this->vram1);
+        }
+    }
+
+    void MMU::SetSpriteIndex(Video::SpriteIndex* s) {
+        this->sprites = s;
+
+        // OAM writes go through WriteControl so the index sees them
+        MapPages(OAM_START, PAGE_SIZE, &this->ram[OAM_START - 0x8000], (s != nullptr) ? nullptr : &this->ram[OAM_START - 0x8000]);
+
+        if (s != nullptr) {
+            s->SetOAM(&this->ram[OAM_START - 0x8000]);
+        }
+    }
+
+    void MMU::MapIO(Word address, IO_READ read, IO_WRITE write, void* device) {
+        IOHandler& reg = this->io[address & PAGE_MASK];
+
+        reg.read = read;
+        reg.write = write;
+        reg.device = device;
+    }
+
+    void MMU::AllocateROM(unsigned int size, const unsigned char* data /*= nullptr*/) {
+        FreeROM();
+
+        Byte* rom = new unsigned char[size];
+        memset(rom, 0, size);
 
         if (data) {
-            memcpy(this->_rom, data, this->ROMSize);
+            memcpy(rom, data, size);
         }
+
+        this->_rom = rom;
+        this->romOwned = true;
+        this->ROMSize = size;
+
+        MapROMBanks();
     }
 
-    void MMU::SetCatridgeType(Byte type) {
+    void MMU::MapROM(const Byte* data, unsigned int size) {
+        FreeROM();
+
+        this->_rom = data;
+        this->romOwned = false;
+        this->ROMSize = size;
+
+        MapROMBanks();
+    }
+
+    void MMU::FreeROM() {
+        // A transfer still running would put the old image's pages back when it ends
+        if (this->dmaActive) {
+            this->cpu->GetScheduler().Cancel(Timing::EVENT_OAM_DMA);
+            UnlockBus();
+        }
+
+        // The host memory may be reused by the next image, so code decoded from it has to go
+        if (this->cpu != nullptr && this->_rom != nullptr) {
+            for (unsigned int offset = 0; offset + PAGE_SIZE <= this->ROMSize; offset += PAGE_SIZE) {
+                this->cpu->InvalidateCode(&this->_rom[offset]);
+            }
+        }
+
+        if (this->romOwned) {
+            delete[] this->_rom;
+        }
+
+        this->_rom = nullptr;
+        this->romOwned = false;
+        this->ROMSize = 0;
+    }
+
+    void MMU::SetCatridgeType(Byte type, unsigned int ramSize /*= 0*/) {
         this->cartType = type;
+
+        switch (type) {
+        case 0x01: case 0x02: case 0x03:
+        this->mbc = MBC_1;
+        this->writeMBC = &MMU::WriteMBC<MBC_1>;
+        break;
+        case 0x05: case 0x06:
+        this->mbc = MBC_2;
+        this->writeMBC = &MMU::WriteMBC<MBC_2>;
+        ramSize = 512;
+        break;
+        case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13:
+        this->mbc = MBC_3;
+        this->writeMBC = &MMU::WriteMBC<MBC_3>;
+        break;
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+        this->mbc = MBC_5;
+        this->writeMBC = &MMU::WriteMBC<MBC_5>;
+        break;
+        default:
+        this->mbc = MBC_NONE;
+        this->writeMBC = &MMU::WriteMBC<MBC_NONE>;
+        break;
+        }
+
+        this->extRam.assign(ramSize, 0);
+
+        this->rombank = 1;
+        this->rombank0 = 0;
+        this->rambank = 0;
+        this->bankHigh = 0;
+        this->mode = 0;
+        // Without an MBC there is nothing to enable the RAM with
+        this->ramOn = (this->mbc == MBC_NONE);
+
+        memset(&this->rtc, 0, sizeof(this->rtc));
+        if (this->cpu != nullptr) {
+            this->rtc.base = this->cpu->GetTotalT();
+        }
+
+        MapROMBanks();
+        MapRAMBank();
+    }
+
+    void MMU::MapPages(Word address, unsigned int size, const Byte* read, Byte* write) {
+        unsigned int first = address >> PAGE_SHIFT;
+        unsigned int count = size >> PAGE_SHIFT;
+
+        const Byte** readTable = MappedRead();
+        Byte** writeTable = MappedWrite();
+
+        for (unsigned int i = 0; i < count; ++i) {
+            readTable[first + i] = (read != nullptr) ? read + (i << PAGE_SHIFT) : unmapped;
+            writeTable[first + i] = (write != nullptr) ? write + (i << PAGE_SHIFT) : nullptr;
+        }
+    }
+
+    void MMU::MapVRAMBank() {
+        Byte* vram = GetVRAMHost();
+
+        // Tile data writes go through WriteControl so the cache sees them, reads stay direct
+        MapPages(TILE_DATA_START, TILE_DATA_END - TILE_DATA_START, vram, (this->tiles != nullptr) ? nullptr : vram);
+        MapPages(TILE_DATA_END, 0xA000 - TILE_DATA_END, &vram[TILE_DATA_END - 0x8000], &vram[TILE_DATA_END - 0x8000]);
+    }
+
+    void MMU::MapROMBanks() {
+        unsigned int count = this->ROMSize / 0x4000;
+        unsigned int banks[2] = { (unsigned int)this->rombank0, (unsigned int)this->rombank };
+        const Byte** readTable = MappedRead();
+
+        // Bank numbers past the end of the ROM wrap, the unused high bits aren't wired
+        if (count > 0) {
+            banks[0] %= count;
+            banks[1] %= count;
+        }
+
+        // Only the page table changes, reads go straight to the bank through it
+        for (unsigned int page = 0; page < (0x8000 >> PAGE_SHIFT); ++page) {
+            unsigned int offset = banks[page >> 6] * 0x4000 + ((page & 0x3F) << PAGE_SHIFT);
+
+            if ((this->_rom != nullptr) && (offset + PAGE_SIZE <= this->ROMSize)) {
+                readTable[page] = &this->_rom[offset];
+            }
+            else {
+                readTable[page] = unmapped;
+            }
+        }
+    }
+
+    void MMU::MapRAMBank() {
+        unsigned int size = (unsigned int)this->extRam.size();
+        unsigned int first = 0xA000 >> PAGE_SHIFT;
+        unsigned int count = 0x2000 >> PAGE_SHIFT;
+        const Byte** readTable = MappedRead();
+        Byte** writeTable = MappedWrite();
+
+        // MBC3 clock registers are read through ReadControl, whether or not the cart has RAM
+        if (this->mbc == MBC_3 && this->ramOn && this->rambank >= 0x08) {
+            for (unsigned int i = 0; i < count; ++i) {
+                readTable[first + i] = nullptr;
+                writeTable[first + i] = nullptr;
+            }
+            return;
+        }
+
+        // Disabled or absent RAM reads as FF and ignores writes
+        if (!this->ramOn || size == 0) {
+            MapPages(0xA000, 0x2000, nullptr, nullptr);
+            return;
+        }
+
+        // Smaller RAMs repeat through the window. MBC2 stores nibbles, so its writes go through WriteMBC.
+        unsigned int base = (this->mbc == MBC_2) ? 0 : ((unsigned int)this->rambank * 0x2000) % size;
+        for (unsigned int i = 0; i < count; ++i) {
+            Byte* page = &this->extRam[(base + (i << PAGE_SHIFT)) % size];
+
+            readTable[first + i] = page;
+            writeTable[first + i] = (this->mbc == MBC_2) ? nullptr : page;
+        }
+    }
+
+    void MMU::StartDMA(Byte source) {
+        // Sources from E000 up read WRAM, the DMA unit can't see OAM, IO or HRAM
+        this->dmaSource = (Word)((source >= 0xE0) ? source - 0x20 : source) << PAGE_SHIFT;
+        this->dmaIndex = 0;
+
+        Timing::Cycles now = this->cpu->GetTotalT();
+
+#if FEIGN_DMA_EXACT
+        if (!this->dmaActive) {
+            LockBus();
+        }
+        this->cpu->GetScheduler().Schedule(Timing::EVENT_OAM_DMA, now + DMA_CYCLES_PER_BYTE);
+#else
+        // All 160 bytes at once
+        CopyBlock(OAM_START, this->dmaSource, DMA_LENGTH);
+
+        // A restart keeps the bus for another 160 M-cycles from now
+        if (!this->dmaActive) {
+            LockBus();
+        }
+        this->cpu->GetScheduler().Schedule(Timing::EVENT_OAM_DMA, now + DMA_LENGTH * DMA_CYCLES_PER_BYTE);
+#endif
+    }
+
+    void MMU::StepDMA(Timing::Cycles when) {
+        if (!this->dmaActive) {
+            return;
+        }
+
+#if FEIGN_DMA_EXACT
+        CopyBlock(OAM_START + this->dmaIndex, this->dmaSource + this->dmaIndex, 1);
+
+        if (++this->dmaIndex < DMA_LENGTH) {
+            this->cpu->GetScheduler().Schedule(Timing::EVENT_OAM_DMA, when + DMA_CYCLES_PER_BYTE);
+            return;
+        }
+#endif
+
+        UnlockBus();
+    }
+
+    void MMU::SetCGB(bool enable) {
+        this->cgb = enable;
+        this->vramBank = 0;
+        this->hdmaActive = false;
+        this->hdmaBlocks = 0;
+
+        memset(this->vram1, 0, sizeof(this->vram1));
+        if (this->tiles != nullptr) {
+            this->tiles->SetVRAM(this->ram, this->vram1);
+        }
+
+        MapVRAMBank();
+    }
+
+    void MMU::SetVRAMBank(Byte bank) {
+        this->vramBank = this->cgb ? (bank & BIT0) : 0;
+
+        MapVRAMBank();
+    }
+
+    void MMU::StartHDMA(Word source, Word dest, unsigned int blocks, bool hblank) {
+        if (!hblank && this->hdmaActive) {
+            this->hdmaActive = false;
+            return;
+        }
+
+        // The transfer ends at the end of VRAM
+        unsigned int room = (0xA000 - dest) / HDMA_BLOCK_SIZE;
+
+        this->hdmaSource = source;
+        this->hdmaDest = dest;
+        this->hdmaBlocks = (blocks < room) ? blocks : room;
+
+        if (hblank) {
+            this->hdmaActive = true;
+            return;
+        }
+
+        // General purpose, all of it now with the CPU stopped for as long as it takes. Replaying the
+        // current block would run ahead of that.
+        CopyBlock(this->hdmaDest, this->hdmaSource, this->hdmaBlocks * HDMA_BLOCK_SIZE);
+        this->cpu->Stall((int)this->cpu->GetScheduler().After(0, this->hdmaBlocks * HDMA_CYCLES_PER_BLOCK));
+        this->cpu->EndBlock();
+
+        this->hdmaBlocks = 0;
+    }
+
+    void MMU::StepHDMA(Timing::Cycles when) {
+        if (!this->hdmaActive) {
+            return;
+        }
+
+        CopyBlock(this->hdmaDest, this->hdmaSource, HDMA_BLOCK_SIZE);
+        this->cpu->Stall((int)this->cpu->GetScheduler().After(0, HDMA_CYCLES_PER_BLOCK));
+
+        this->hdmaSource += HDMA_BLOCK_SIZE;
+        this->hdmaDest += HDMA_BLOCK_SIZE;
+        if (--this->hdmaBlocks == 0) {
+            this->hdmaActive = false;
+        }
+    }
+
+    void MMU::CopyBlock(Word dest, Word source, unsigned int length) {
+        while (length > 0) {
+            // Up to the end of the source or destination page, whichever comes first
+            unsigned int run = PAGE_SIZE - (source & PAGE_MASK);
+            unsigned int room = PAGE_SIZE - (dest & PAGE_MASK);
+            if (run > room) {
+                run = room;
+            }
+            if (run > length) {
+                run = length;
+            }
+
+            const Byte* from = this->dmaActive ? this->lockedRead[source >> PAGE_SHIFT] : this->readPage[source >> PAGE_SHIFT];
+            Byte* to = (dest >= OAM_START) ? &this->ram[dest - 0x8000] : &GetVRAMHost()[dest - 0x8000];
+
+            // A source in VRAM may be the destination page
+            if (from != nullptr) {
+                memmove(to, &from[source & PAGE_MASK], run);
+            }
+            else {
+                for (unsigned int i = 0; i < run; ++i) {
+                    to[i] = ReadControl(source + i);
+                }
+            }
+
+            if (dest >= OAM_START) {
+                if (this->sprites != nullptr) {
+                    this->sprites->MarkDirty();
+                }
+            }
+            else if (this->tiles != nullptr) {
+                for (unsigned int address = dest & ~0x0F; address < dest + run && address < TILE_DATA_END; address += 16) {
+                    this->tiles->MarkDirty(address, this->vramBank);
+                }
+            }
+
+            source += run;
+            dest += run;
+            length -= run;
+        }
+    }
+
+    void MMU::LockBus() {
+        memcpy(this->lockedRead, this->readPage, sizeof(this->lockedRead));
+        memcpy(this->lockedWrite, this->writePage, sizeof(this->lockedWrite));
+
+        // Reads see FF and writes go to WriteControl, which drops them. IO and HRAM are still reachable.
+        for (unsigned int page = 0; page < (0xFF00 >> PAGE_SHIFT); ++page) {
+            this->readPage[page] = unmapped;
+            this->writePage[page] = nullptr;
+        }
+
+        this->dmaActive = true;
+    }
+
+    void MMU::UnlockBus() {
+        memcpy(this->readPage, this->lockedRead, (0xFF00 >> PAGE_SHIFT) * sizeof(this->readPage[0]));
+        memcpy(this->writePage, this->lockedWrite, (0xFF00 >> PAGE_SHIFT) * sizeof(this->writePage[0]));
+
+        this->dmaActive = false;
+    }
+
+    void MMU::WatchCode(Word address) {
+        Byte page = address >> PAGE_SHIFT;
+
+        // WRAM and its echo
+        if (address >= 0xC000 && address < 0xE000) {
+            WatchPage(page);
+            if (page + 0x20 <= 0xFD) {
+                WatchPage(page + 0x20);
+            }
+        }
+        // HRAM already goes through WriteIO
+        else if (address >= 0xFF80) {
+            this->codeWatch[page] = true;
+        }
+    }
+
+    void MMU::WatchPage(Byte page) {
+        if (this->codeWatch[page]) {
+            return;
+        }
+
+        Byte** table = MappedWrite();
+
+        this->codeWatch[page] = true;
+        this->watchedWrite[page] = table[page];
+        table[page] = nullptr;
     }
 
-    void MMU::WriteByte(const Word& address, const Byte& val) {
-        if (address >= 0x8000) {
+    void MMU::UnwatchPage(Byte page) {
+        if (!this->codeWatch[page]) {
+            return;
+        }
+
+        Byte** table = MappedWrite();
+
+        this->codeWatch[page] = false;
+        table[page] = this->watchedWrite[page];
+    }
+
+    Byte MMU::ReadControl(Word address) const {
+        // The selected MBC3 clock register
+        if (address >= 0xA000 && address < 0xC000) {
+            if (this->rambank >= 0x08 && this->rambank < 0x08 + RTC_COUNT) {
+                return this->rtc.latched[this->rambank - 0x08];
+            }
+            return 0xFF;
+        }
+
+        const IOHandler& reg = this->io[address & PAGE_MASK];
+        if (reg.read != nullptr) {
+            return reg.read(reg.device, address);
+        }
+        return this->ram[address - 0x8000];
+    }
+
+    void MMU::WriteIO(Word address, Byte val) {
+        // HRAM holding cached code
+        if (address >= 0xFF80 && address < 0xFFFF && this->codeWatch[0xFF]) {
+            this->codeWatch[0xFF] = false;
+            this->cpu->InvalidateCode(&this->ram[0xFF00 - 0x8000]);
+        }
+
+        this->ram[address - 0x8000] = val;
+
+        const IOHandler& reg = this->io[address & PAGE_MASK];
+        if (reg.write != nullptr) {
+            reg.write(reg.device, address, val);
+        }
+    }
+
+    void MMU::WriteControl(const Word& address, const Byte& val) {
+        Byte page = address >> PAGE_SHIFT;
+
+        // DMA has the bus, only IO and HRAM take writes
+        if (this->dmaActive && page != 0xFF) {
+            return;
+        }
+
+        // WRAM (or its echo) holding cached code. Drop the code, then let the page take writes directly again.
+        if (this->codeWatch[page] && page < 0xFE) {
+            Byte wram = (page >= 0xE0) ? page - 0x20 : page;
+
+            UnwatchPage(wram);
+            if (wram + 0x20 <= 0xFD) {
+                UnwatchPage(wram + 0x20);
+            }
+            this->cpu->InvalidateCode(this->readPage[wram]);
+
+            WriteByte(address, val);
+            return;
+        }
+
+        // MBC registers, the bank behind the running code may change
+        if (address < 0x8000) {
+            this->cpu->EndBlock();
+
+            if (this->_inbios && (address < 0x0100)) {
+                return;
+            }
+
+            (this->*writeMBC)(address, val);
+            return;
+        }
+
+        // Tile data, the decoded copy is out of date
+        if (address >= TILE_DATA_START && address < TILE_DATA_END) {
+            GetVRAMHost()[address - 0x8000] = val;
+            this->tiles->MarkDirty(address, this->vramBank);
+            return;
+        }
+
+        // OAM, the sprite lists are out of date
+        if (page == (OAM_START >> PAGE_SHIFT)) {
             this->ram[address - 0x8000] = val;
-            // Shadow ram write
-            if ((address > 0xC000) && (address < 0xDE00)) {
-                this->ram[address - 0x7000] = val;
+            if (address < OAM_END) {
+                this->sprites->MarkDirty();
             }
             return;
         }
 
-        switch ((address & 0xF000) >> 12) {
-            // BIOS (256b)/ROM0
-        case 0x0:
-        if (this->_inbios && (address < 0x0100)) {
+        // External RAM that isn't directly writable
+        if (address >= 0xA000 && address < 0xC000) {
+            (this->*writeMBC)(address, val);
             return;
         }
-        break;
-        // ROM0
-        case 0x1:
+
+        if (page == 0xFF) {
+            WriteIO(address, val);
+        }
+    }
+
+    // No MBC, the ROM ignores writes and any RAM is always mapped.
+    template <> void MMU::WriteMBC<MBC_NONE>(Word address, Byte val) {
+    }
+
+    template <> void MMU::WriteMBC<MBC_1>(Word address, Byte val) {
+        switch (address >> 13) {
+        case 0: // 0000-1FFF RAM enable
         this->ramOn = ((val & 0x0F) == 0x0A);
         break;
-        case 0x2: case 0x3:
-        if (!(val & 0x1F)) {
-            this->rombank = (val & 1) | (this->rombank & 0xE0);
+        case 1: // 2000-3FFF low 5 bits of the ROM bank, 0 selects 1
+        this->rombank = (this->rombank & ~0x1F) | (((val & 0x1F) == 0) ? 1 : (val & 0x1F));
+        break;
+        case 2: // 4000-5FFF upper ROM bank bits or RAM bank
+        this->bankHigh = val & 0x03;
+        break;
+        case 3: // 6000-7FFF banking mode
+        this->mode = val & 0x01;
+        break;
+        default: // RAM disabled or absent
+        return;
         }
-        else {
-            this->rombank = (val & 0x1F) | (this->rombank & 0xE0);
+
+        // The 2-bit register always drives the upper bits at 4000-7FFF. Mode 1 also applies it to
+        // 0000-3FFF and uses it as the RAM bank.
+        this->rombank = (this->bankHigh << 5) | (this->rombank & 0x1F);
+        this->rombank0 = this->mode ? (this->bankHigh << 5) : 0;
+        this->rambank = this->mode ? this->bankHigh : 0;
+
+        MapROMBanks();
+        MapRAMBank();
+    }
+
+    template <> void MMU::WriteMBC<MBC_2>(Word address, Byte val) {
+        if (address < 0x4000) {
+            // Address bit 8 picks between RAM enable and ROM bank
+            if (address & 0x0100) {
+                this->rombank = ((val & 0x0F) == 0) ? 1 : (val & 0x0F);
+                MapROMBanks();
+            }
+            else {
+                this->ramOn = ((val & 0x0F) == 0x0A);
+                MapRAMBank();
+            }
+        }
+        else if (address >= 0xA000 && this->ramOn) {
+            // 4-bit cells, the upper half reads as 1s
+            this->extRam[address & 0x01FF] = val | 0xF0;
         }
+    }
 
+    template <> void MMU::WriteMBC<MBC_3>(Word address, Byte val) {
+        switch (address >> 13) {
+        case 0: // 0000-1FFF RAM and clock enable
+        this->ramOn = ((val & 0x0F) == 0x0A);
+        MapRAMBank();
         break;
-        // ROM1 (unbanked) (16k)
-        case 0x4: case 0x5:
-        if (this->mode) {
-            this->rambank = val & 0x03;
+        case 1: // 2000-3FFF 7-bit ROM bank, 0 selects 1
+        this->rombank = ((val & 0x7F) == 0) ? 1 : (val & 0x7F);
+        MapROMBanks();
+        break;
+        case 2: // 4000-5FFF RAM bank 0-3 or clock register 08-0C
+        if (val < 0x04 || (val >= 0x08 && val < 0x08 + RTC_COUNT)) {
+            this->rambank = val;
+            MapRAMBank();
         }
-        else {
-            this->rombank = (this->rombank & 0x1F) | ((val & 0x03) << 5);
+        break;
+        case 3: // 6000-7FFF writing 0 then 1 latches the clock
+        if (this->rtc.latch == 0x00 && val == 0x01) {
+            UpdateRTC();
+            memcpy(this->rtc.latched, this->rtc.live, sizeof(this->rtc.latched));
         }
+        this->rtc.latch = val;
         break;
-        case 0x6: case 0x7:
-        this->mode = val & 0x01;
+        default: // A000-BFFF, a clock register when it reaches here
+        if (this->ramOn && this->rambank >= 0x08) {
+            static const Byte masks[RTC_COUNT] = { 0x3F, 0x3F, 0x1F, 0xFF, 0xC1 };
+            int reg = this->rambank - 0x08;
+
+            UpdateRTC();
+            this->rtc.live[reg] = val & masks[reg];
+            this->rtc.latched[reg] = this->rtc.live[reg];
+
+            // Writing the seconds restarts the current second
+            if (reg == RTC_S) {
+                this->rtc.base = this->cpu->GetTotalT();
+            }
+        }
+        break;
+        }
+    }
+
+    template <> void MMU::WriteMBC<MBC_5>(Word address, Byte val) {
+        switch (address >> 12) {
+        case 0x0: case 0x1: // 0000-1FFF RAM enable
+        this->ramOn = ((val & 0x0F) == 0x0A);
+        MapRAMBank();
+        break;
+        case 0x2: // 2000-2FFF low 8 bits of the ROM bank, 0 is allowed
+        this->rombank = (this->rombank & 0x100) | val;
+        MapROMBanks();
+        break;
+        case 0x3: // 3000-3FFF ROM bank bit 8
+        this->rombank = (this->rombank & 0xFF) | ((val & 0x01) << 8);
+        MapROMBanks();
+        break;
+        case 0x4: case 0x5: // 4000-5FFF RAM bank
+        this->rambank = val & 0x0F;
+        MapRAMBank();
         break;
         default:
         break;
         }
     }
 
-    void MMU::WriteWord(const Word& address, const Word& val) {
-        WriteByte(address, val & 0xFF);
-        WriteByte(address + 1, (val >> 8) & 0xFF);
+    void MMU::UpdateRTC() {
+        unsigned long long now = (this->cpu != nullptr) ? this->cpu->GetTotalT() : 0;
+
+        // Halted, time doesn't count
+        if (this->rtc.live[RTC_DH] & BIT6) {
+            this->rtc.base = now;
+            return;
+        }
+
+        unsigned long long seconds = (now - this->rtc.base) / RTC_CYCLES_PER_SECOND;
+        if (seconds == 0) {
+            return;
+        }
+        this->rtc.base += seconds * RTC_CYCLES_PER_SECOND;
+
+        unsigned long long carry = this->rtc.live[RTC_S] + seconds;
+        this->rtc.live[RTC_S] = carry % 60;
+        carry = carry / 60 + this->rtc.live[RTC_M];
+        this->rtc.live[RTC_M] = carry % 60;
+        carry = carry / 60 + this->rtc.live[RTC_H];
+        this->rtc.live[RTC_H] = carry % 24;
+        carry = carry / 24 + (this->rtc.live[RTC_DL] | ((this->rtc.live[RTC_DH] & BIT0) << 8));
+
+        // The day counter is 9 bits with a sticky overflow flag
+        if (carry > 0x1FF) {
+            this->rtc.live[RTC_DH] |= BIT7;
+        }
+        this->rtc.live[RTC_DL] = carry & 0xFF;
+        this->rtc.live[RTC_DH] = (this->rtc.live[RTC_DH] & ~BIT0) | ((carry >> 8) & BIT0);
     }
-}
\ No newline at end of file
+}
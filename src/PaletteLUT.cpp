@@ -0,0 +1,39 @@
+#include "../include/PaletteLUT.h"
+
+namespace Video {
+    PaletteLUT::PaletteLUT(PIXEL_FORMAT f) : format(f), size(Video::GetPixelSize(f)) {
+        // Plain grey levels, lightest first
+        static const Byte levels[4] = { 0xFF, 0xAA, 0x55, 0x00 };
+
+        for (int i = 0; i < 4; i++) {
+            this->shades[i] = Pack(levels[i], levels[i], levels[i], i);
+        }
+
+        for (int palette = 0; palette < PALETTE_COUNT; palette++) {
+            SetRegister(palette, 0xE4);
+        }
+
+        // CGB palettes start out white
+        for (int palette = PALETTE_CGB_BG; palette < PALETTE_TOTAL; palette++) {
+            for (int i = 0; i < 4; i++) {
+                SetColor(palette, i, 0x7FFF);
+            }
+        }
+    }
+
+    unsigned int PaletteLUT::Pack(Byte r, Byte g, Byte b, int index) const {
+        switch (this->format) {
+        case PIXEL_INDEXED8:
+        return (unsigned int)index;
+        case PIXEL_RGB565:
+        return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        default: {
+            // R G B A in memory order whatever the host byte order
+            Byte rgba[4] = { r, g, b, 0xFF };
+            unsigned int pixel;
+            memcpy(&pixel, rgba, sizeof(rgba));
+            return pixel;
+        }
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#include "../include/PixelKernels.h"
+
+#include <cstring>
+
+#if FEIGN_SIMD == FEIGN_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Video {
+    void DecodeRowsScalar(const Byte* data, Byte* out, unsigned int rows) {
+        for (unsigned int row = 0; row < rows; ++row) {
+            Byte lo = data[row * 2];
+            Byte hi = data[row * 2 + 1];
+
+            for (unsigned int x = 0; x < 8; ++x) {
+                unsigned int shift = 7 - x;
+                out[row * 8 + x] = (Byte)(((lo >> shift) & 1) | (((hi >> shift) & 1) << 1));
+            }
+        }
+    }
+
+    void ComposePixelsScalar(const Byte* indices, const unsigned int colors[4], Byte* out, unsigned int count, unsigned int size) {
+        for (unsigned int i = 0; i < count; ++i) {
+            StorePixel(&out[i * size], colors[indices[i] & 0x03], size);
+        }
+    }
+
+#if FEIGN_SIMD == FEIGN_SIMD_SSE2
+    void DecodeRows(const Byte* data, Byte* out, unsigned int rows) {
+        // One bit per lane, leftmost pixel (bit 7) in the first lane
+        const __m128i bits = _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+            0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i two = _mm_set1_epi8(2);
+        unsigned int row = 0;
+
+        // Two rows per pass
+        for (; row + 2 <= rows; row += 2) {
+            int planes;
+            memcpy(&planes, &data[row * 2], sizeof(planes));
+
+            // lo0 hi0 lo1 hi1 -> each byte repeated 4 times -> lo0 x8 lo1 x8 and hi0 x8 hi1 x8
+            __m128i v = _mm_cvtsi32_si128(planes);
+            v = _mm_unpacklo_epi8(v, v);
+            v = _mm_unpacklo_epi16(v, v);
+            __m128i lo = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 0, 0));
+            __m128i hi = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 1, 1));
+
+            // Lanes whose bit is set compare to all ones, keep 1 of those for the low plane and 2 for the high
+            lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lo, bits), bits), one);
+            hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(hi, bits), bits), two);
+
+            _mm_storeu_si128((__m128i*)&out[row * 8], _mm_or_si128(lo, hi));
+        }
+
+        DecodeRowsScalar(&data[row * 2], &out[row * 8], rows - row);
+    }
+
+    // All ones in each size byte lane where a and b are equal.
+    static inline __m128i Equal(__m128i a, __m128i b, unsigned int size) {
+        if (size == 1) {
+            return _mm_cmpeq_epi8(a, b);
+        }
+        if (size == 2) {
+            return _mm_cmpeq_epi16(a, b);
+        }
+        return _mm_cmpeq_epi32(a, b);
+    }
+
+    // Pick colors[index] for each lane of index, where every lane holds 0-3 zero extended to the size
+    // byte lane width and keys/colors are broadcast at that width.
+    static inline __m128i SelectColors(__m128i index, const __m128i keys[3], const __m128i colors[4], unsigned int size) {
+        __m128i is1 = Equal(index, keys[0], size);
+        __m128i is2 = Equal(index, keys[1], size);
+        __m128i is3 = Equal(index, keys[2], size);
+
+        // Index 0 is whatever none of the others matched
+        __m128i pixels = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(is1, is2), is3), colors[0]);
+
+        pixels = _mm_or_si128(pixels, _mm_and_si128(is1, colors[1]));
+        pixels = _mm_or_si128(pixels, _mm_and_si128(is2, colors[2]));
+        return _mm_or_si128(pixels, _mm_and_si128(is3, colors[3]));
+    }
+
+    void ComposePixels(const Byte* indices, const unsigned int colors[4], Byte* out, unsigned int count, unsigned int size) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i mask = _mm_set1_epi8(0x03);
+        __m128i keys[3];
+        __m128i lanes[4];
+
+        // Keys and colours broadcast at the pixel width
+        for (int k = 0; k < 4; ++k) {
+            if (size == 1) {
+                lanes[k] = _mm_set1_epi8((char)colors[k]);
+            }
+            else if (size == 2) {
+                lanes[k] = _mm_set1_epi16((short)colors[k]);
+            }
+            else {
+                lanes[k] = _mm_set1_epi32((int)colors[k]);
+            }
+        }
+        for (int k = 0; k < 3; ++k) {
+            keys[k] = (size == 1) ? _mm_set1_epi8((char)(k + 1)) : (size == 2) ? _mm_set1_epi16((short)(k + 1)) : _mm_set1_epi32(k + 1);
+        }
+
+        unsigned int i = 0;
+
+        // 16 pixels per pass, one to four stores
+        for (; i + 16 <= count; i += 16) {
+            __m128i index = _mm_and_si128(_mm_loadu_si128((const __m128i*)&indices[i]), mask);
+            Byte* dest = &out[i * size];
+
+            if (size == 1) {
+                _mm_storeu_si128((__m128i*)dest, SelectColors(index, keys, lanes, size));
+                continue;
+            }
+
+            __m128i words[2] = { _mm_unpacklo_epi8(index, zero), _mm_unpackhi_epi8(index, zero) };
+
+            if (size == 2) {
+                _mm_storeu_si128((__m128i*)&dest[0], SelectColors(words[0], keys, lanes, size));
+                _mm_storeu_si128((__m128i*)&dest[16], SelectColors(words[1], keys, lanes, size));
+                continue;
+            }
+
+            for (int half = 0; half < 2; ++half) {
+                _mm_storeu_si128((__m128i*)&dest[half * 32], SelectColors(_mm_unpacklo_epi16(words[half], zero), keys, lanes, size));
+                _mm_storeu_si128((__m128i*)&dest[half * 32 + 16], SelectColors(_mm_unpackhi_epi16(words[half], zero), keys, lanes, size));
+            }
+        }
+
+        ComposePixelsScalar(&indices[i], colors, &out[i * size], count - i, size);
+    }
+#else
+    void DecodeRows(const Byte* data, Byte* out, unsigned int rows) {
+        DecodeRowsScalar(data, out, rows);
+    }
+
+    void ComposePixels(const Byte* indices, const unsigned int colors[4], Byte* out, unsigned int count, unsigned int size) {
+        ComposePixelsScalar(indices, colors, out, count, size);
+    }
+#endif
+}
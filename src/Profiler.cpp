@@ -0,0 +1,96 @@
+#include "../include/Profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+
+namespace Processor {
+    // Host clock in nanoseconds.
+    static unsigned long long Now() {
+        return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Profiler::Profiler() : countdown(PROFILE_SAMPLE_INTERVAL), timing(false), sampleStart(0) {
+        memset(this->ops, 0, sizeof(this->ops));
+        memset(this->cbOps, 0, sizeof(this->cbOps));
+
+        // What reading the clock itself costs, taken off every sample
+        this->overhead = ~0ULL;
+        for (int i = 0; i < 100; i++) {
+            unsigned long long first = Now();
+            unsigned long long second = Now();
+
+            this->overhead = std::min(this->overhead, second - first);
+        }
+    }
+
+    void Profiler::Sample(OpProfile& entry) {
+        unsigned long long now = Now();
+
+        if (this->timing) {
+            unsigned long long elapsed = now - this->sampleStart;
+
+            ++entry.samples;
+            entry.sampledNs += (elapsed > this->overhead) ? elapsed - this->overhead : 0;
+
+            this->timing = false;
+            this->countdown = PROFILE_SAMPLE_INTERVAL - 1;
+        }
+        else {
+            // Time the op after this one
+            this->timing = true;
+            this->sampleStart = now;
+            this->countdown = 1;
+        }
+    }
+
+    void Profiler::Report(std::ostream& out) const {
+        std::vector<const OpProfile*> used;
+        unsigned long long count = 0;
+        unsigned long long cycles = 0;
+
+        for (int table = 0; table < 2; table++) {
+            for (int op = 0; op < 256; op++) {
+                const OpProfile* entry = table ? &this->cbOps[op] : &this->ops[op];
+
+                if (entry->count != 0) {
+                    used.push_back(entry);
+                    count += entry->count;
+                    cycles += entry->cycles;
+                }
+            }
+        }
+
+        if (used.empty()) {
+            return;
+        }
+
+        std::sort(used.begin(), used.end(), [](const OpProfile* a, const OpProfile* b) {
+            return a->cycles > b->cycles;
+        });
+
+        out << "Opcode profile: " << count << " ops, " << cycles << " T-cycles" << std::endl;
+        out << "    op     count        %      T-cycles        %   ns/op" << std::endl;
+
+        for (const OpProfile* entry : used) {
+            bool cb = (entry >= this->cbOps && entry < this->cbOps + 256);
+            int op = (int)(entry - (cb ? this->cbOps : this->ops));
+
+            out << (cb ? "  CB " : "     ") << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << op
+                << std::dec << std::nouppercase << std::setfill(' ')
+                << std::setw(10) << entry->count
+                << std::setw(9) << std::fixed << std::setprecision(2) << (entry->count * 100.0 / count)
+                << std::setw(14) << entry->cycles
+                << std::setw(9) << (entry->cycles * 100.0 / cycles);
+
+            // Ops run too rarely to land on a sample have no time
+            if (entry->samples != 0) {
+                out << std::setw(8) << std::setprecision(1) << ((double)entry->sampledNs / entry->samples);
+            }
+            out << std::endl;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#include "../include/ROMStore.h"
+
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Memory {
+    std::mutex ROMStore::lock;
+    std::unordered_map<unsigned long long, std::weak_ptr<const ROMImage>> ROMStore::images;
+
+    ROMImage::ROMImage() : data(nullptr), size(0), hash(0), sum(0) {
+#if defined(_WIN32)
+        this->mapping = nullptr;
+#endif
+    }
+
+    ROMImage::~ROMImage() {
+        if (this->data == nullptr) {
+            return;
+        }
+
+#if defined(_WIN32)
+        UnmapViewOfFile(this->data);
+        CloseHandle(this->mapping);
+#else
+        munmap((void*)this->data, this->size);
+#endif
+    }
+
+    bool ROMImage::Map(const std::string& fname) {
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER length;
+        if (!GetFileSizeEx(file, &length) || length.QuadPart == 0 || length.QuadPart > 0xFFFFFFFF) {
+            CloseHandle(file);
+            return false;
+        }
+
+        // The mapping keeps the file open
+        this->mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (this->mapping == nullptr) {
+            return false;
+        }
+
+        this->data = (const Byte*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+        if (this->data == nullptr) {
+            CloseHandle(this->mapping);
+            this->mapping = nullptr;
+            return false;
+        }
+        this->size = (unsigned int)length.QuadPart;
+#else
+        int fd = open(fname.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0 || (unsigned long long)info.st_size > 0xFFFFFFFFULL) {
+            close(fd);
+            return false;
+        }
+
+        // The mapping keeps the file open
+        void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+
+        this->data = (const Byte*)view;
+        this->size = (unsigned int)info.st_size;
+#endif
+
+        // Hash and byte sum in one pass over the view
+        unsigned long long h = 14695981039346656037ULL;
+        Word s = 0;
+        for (unsigned int i = 0; i < this->size; ++i) {
+            h = (h ^ this->data[i]) * 1099511628211ULL;
+            s += this->data[i];
+        }
+        this->hash = h;
+        this->sum = s;
+
+        return true;
+    }
+
+    std::shared_ptr<const ROMImage> ROMStore::Acquire(const std::string& fname) {
+        std::shared_ptr<ROMImage> mapped(new ROMImage());
+        if (!mapped->Map(fname)) {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        // Same contents already held by someone, drop the new mapping and share that one
+        auto it = images.find(mapped->GetHash());
+        if (it != images.end()) {
+            std::shared_ptr<const ROMImage> held = it->second.lock();
+            if (held != nullptr && held->GetSize() == mapped->GetSize() && memcmp(held->GetData(), mapped->GetData(), held->GetSize()) == 0) {
+                return held;
+            }
+        }
+
+        images[mapped->GetHash()] = mapped;
+
+        // Forget images nobody holds any more
+        for (auto entry = images.begin(); entry != images.end();) {
+            if (entry->second.expired()) {
+                entry = images.erase(entry);
+            }
+            else {
+                ++entry;
+            }
+        }
+
+        return mapped;
+    }
+}
@@ -0,0 +1,61 @@
+#include "../include/SpriteIndex.h"
+
+#include <cstring>
+
+namespace Video {
+    SpriteIndex::SpriteIndex() : dirty(true), height(8), cgb(false), oam(nullptr) {
+        memset(this->lists, 0, sizeof(this->lists));
+        memset(this->counts, 0, sizeof(this->counts));
+    }
+
+    void SpriteIndex::SetOAM(const Byte* o) {
+        this->oam = o;
+        this->dirty = true;
+    }
+
+    void SpriteIndex::Rebuild() {
+        this->dirty = false;
+        memset(this->counts, 0, sizeof(this->counts));
+
+        if (this->oam == nullptr) {
+            return;
+        }
+
+        for (int i = 0; i < OAM_SPRITES; i++) {
+            int y = this->oam[i * 4] - 16;
+            int first = (y < 0) ? 0 : y;
+            int last = y + this->height;
+
+            if (last > SCREEN_LINES) {
+                last = SCREEN_LINES;
+            }
+
+            // Sprites off screen horizontally still use up a slot
+            for (int line = first; line < last; line++) {
+                if (this->counts[line] < SPRITES_PER_LINE) {
+                    this->lists[line][this->counts[line]++] = (Byte)i;
+                }
+            }
+        }
+
+        if (this->cgb) {
+            return;
+        }
+
+        // Lower X wins, OAM order breaks ties. Insertion sort is stable.
+        for (int line = 0; line < SCREEN_LINES; line++) {
+            Byte* list = this->lists[line];
+
+            for (int i = 1; i < this->counts[line]; i++) {
+                Byte sprite = list[i];
+                Byte x = this->oam[sprite * 4 + 1];
+                int j = i;
+
+                for (; j > 0 && this->oam[list[j - 1] * 4 + 1] > x; j--) {
+                    list[j] = list[j - 1];
+                }
+                list[j] = sprite;
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#include "../include/TileCache.h"
+#include "../include/PixelKernels.h"
+
+namespace Video {
+    TileCache::TileCache() : anyDirty(false) {
+        memset(this->pixels, 0, sizeof(this->pixels));
+        memset(this->dirty, 0, sizeof(this->dirty));
+        memset(this->vram, 0, sizeof(this->vram));
+    }
+
+    void TileCache::SetVRAM(const Byte* bank0, const Byte* bank1 /*= nullptr*/) {
+        this->vram[0] = bank0;
+        this->vram[1] = bank1;
+
+        for (unsigned int tile = 0; tile < TILE_COUNT * TILE_BANKS; ++tile) {
+            this->dirty[tile >> 6] |= 1ULL << (tile & 63);
+        }
+        this->anyDirty = true;
+    }
+
+    void TileCache::DecodeDirty() {
+        this->anyDirty = false;
+
+        for (unsigned int word = 0; word < TILE_DIRTY_WORDS; ++word) {
+            unsigned long long bits = this->dirty[word];
+            this->dirty[word] = 0;
+
+            while (bits != 0) {
+                unsigned int bit = 0;
+                while (!(bits & (1ULL << bit))) {
+                    ++bit;
+                }
+                bits &= bits - 1;
+
+                DecodeTile(word * 64 + bit);
+            }
+        }
+    }
+
+    void TileCache::DecodeTile(unsigned int tile) {
+        const Byte* bank = this->vram[tile / TILE_COUNT];
+
+        if (bank != nullptr) {
+            DecodeRows(&bank[(tile % TILE_COUNT) * 16], &this->pixels[tile][0][0], 8);
+        }
+    }
+}
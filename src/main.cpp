@@ -1,5 +1,6 @@
 
 #include <iostream>
+#include <cstdlib>
 #include "../include/GB.h"
 
 int main(int argc, const char* argv[]) {
@@ -7,7 +8,7 @@ int main(int argc, const char* argv[]) {
 	gbemu.LoadROMImage("sml.gb");
 
 	while (1) {
-		gbemu.Update(0);
+		gbemu.RunFrame();
 	}
 
 	system("Pause");
@@ -0,0 +1,96 @@
+#include "../include/ALUTables.h"
+
+#include <cstdio>
+
+// Exhaustive check of the ALU tables against the flag rules written out longhand.
+using namespace Processor;
+
+static int mismatches = 0;
+
+// Report a table entry that doesn't match the expected result and flags.
+static void Check(const char* name, unsigned int index, Word entry, int result, Byte f) {
+    Word expected = (Word)(((result & 0xFF) << 8) | f);
+
+    if (entry == expected) {
+        return;
+    }
+
+    if (mismatches < 16) {
+        std::printf("%s at index %05X: table %04X expected %04X\n", name, index, entry, expected);
+    }
+    ++mismatches;
+}
+
+int main() {
+    for (int carry = 0; carry < 2; ++carry) {
+        for (int a = 0; a < 0x100; ++a) {
+            for (int b = 0; b < 0x100; ++b) {
+                unsigned int index = ALU_BINARY_INDEX(a, b, carry);
+                int result;
+                Byte f;
+
+                // ADD/ADC
+                result = a + b + carry;
+                f = 0;
+                if ((result & 0xFF) == 0) {
+                    f |= zf;
+                }
+                if (((a & 0x0F) + (b & 0x0F) + carry) > 0x0F) {
+                    f |= h;
+                }
+                if (result > 0xFF) {
+                    f |= cy;
+                }
+                Check("ADD", index, addTable.entry[index], result, f);
+
+                // SUB/SBC/CP
+                result = a - b - carry;
+                f = n;
+                if ((result & 0xFF) == 0) {
+                    f |= zf;
+                }
+                if ((a & 0x0F) < ((b & 0x0F) + carry)) {
+                    f |= h;
+                }
+                if (a < (b + carry)) {
+                    f |= cy;
+                }
+                Check("SUB", index, subTable.entry[index], result, f);
+            }
+        }
+    }
+
+    for (int b = 0; b < 0x100; ++b) {
+        int result = (b + 1) & 0xFF;
+        Check("INC", b, incTable.entry[b], result, ((result == 0) ? zf : 0) | (((result & 0x0F) == 0) ? h : 0));
+
+        result = (b - 1) & 0xFF;
+        Check("DEC", b, decTable.entry[b], result, ((result == 0) ? zf : 0) | n | (((result & 0x0F) == 0x0F) ? h : 0));
+    }
+
+    // DAA as one correction value added or subtracted
+    for (int flags = 0; flags < 8; ++flags) {
+        Byte f = (Byte)(flags << 4);
+
+        for (int a = 0; a < 0x100; ++a) {
+            unsigned int index = ALU_DAA_INDEX(a, f);
+            int correction = 0;
+            bool carry = false;
+
+            if ((f & h) || (!(f & n) && (a & 0x0F) > 0x09)) {
+                correction |= 0x06;
+            }
+            if ((f & cy) || (!(f & n) && a > 0x99)) {
+                correction |= 0x60;
+                carry = true;
+            }
+
+            int result = (f & n) ? (a - correction) : (a + correction);
+            Byte expected = (Byte)((((result & 0xFF) == 0) ? zf : 0) | (f & n) | (carry ? cy : 0));
+            Check("DAA", index, daaTable.entry[index], result, expected);
+        }
+    }
+
+    std::printf("ALU tables: %d mismatches\n", mismatches);
+    return (mismatches == 0) ? 0 : 1;
+}
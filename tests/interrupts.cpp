@@ -0,0 +1,86 @@
+#include "../include/CPU.h"
+#include "../include/Memory.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Interrupt dispatch with IME cleared. A timer interrupt requested after DI must wait for EI, and
+// DI;HALT with one pending must wake without calling the handler or acknowledging it.
+static const Byte handler[] = {
+    0xFA, 0x00, 0xC0, // LD A,(C000)
+    0xEA, 0x02, 0xC0, // LD (C002),A     what the program had got to when the handler ran
+    0xFA, 0x03, 0xC0, // LD A,(C003)
+    0x3C, // INC A
+    0xEA, 0x03, 0xC0, // LD (C003),A     handler runs
+    0xD9, // RETI
+};
+
+static const Byte program[] = {
+    0x31, 0xFE, 0xFF, // LD SP,FFFE
+    0x3E, 0x04, 0xE0, 0xFF, // IE = timer
+    0xF3, // DI
+    0x3E, 0x04, 0xE0, 0x0F, // IF = timer
+    0x00, 0x00, 0x00, 0x00,
+    0x3E, 0x01, 0xEA, 0x00, 0xC0, // C000 = 1
+    0xFB, // EI
+    0x00,
+    0x3E, 0x02, 0xEA, 0x01, 0xC0, // C001 = 2
+    0xF3, // DI
+    0x3E, 0x04, 0xE0, 0x0F, // IF = timer
+    0x76, // HALT
+    0x00,
+    0x3E, 0x03, 0xEA, 0x04, 0xC0, // C004 = 3
+    0x18, 0xFE, // JR $
+};
+
+static int mismatches = 0;
+
+static void Expect(const char* what, int value, int expected) {
+    if (value == expected) {
+        return;
+    }
+
+    std::printf("%s: %02X expected %02X\n", what, value, expected);
+    ++mismatches;
+}
+
+int main() {
+    static Byte rom[0x8000];
+    static const Byte start[] = { 0x00, 0xC3, 0x50, 0x01 };
+
+    memcpy(&rom[0x0050], handler, sizeof(handler));
+    memcpy(&rom[0x0100], start, sizeof(start));
+    memcpy(&rom[0x0150], program, sizeof(program));
+
+    Processor::Z80 cpu;
+    Memory::MMU mmu;
+
+    mmu.SetCPU(&cpu);
+    cpu.SetMMU(&mmu);
+    mmu.AllocateROM(sizeof(rom), rom);
+    mmu.SetCatridgeType(0x00);
+    cpu.SetPC(0x0100);
+
+    // Only the interrupt check is ever scheduled, nothing else is attached
+    Timing::Scheduler& events = cpu.GetScheduler();
+    for (int slice = 0; slice < 100; ++slice) {
+        Timing::EVENT_TYPE type;
+        Timing::Cycles when;
+
+        cpu.Run(1000);
+        while (events.PopDue(cpu.GetTotalT(), type, when)) {
+            if (type == Timing::EVENT_INTERRUPT_CHECK) {
+                cpu.DoInterrupts();
+            }
+        }
+    }
+
+    Expect("Handler ran after EI", mmu.ReadByte(0xC002), 0x01);
+    Expect("Handler calls", mmu.ReadByte(0xC003), 0x01);
+    Expect("Program after EI", mmu.ReadByte(0xC001), 0x02);
+    Expect("Program after DI;HALT", mmu.ReadByte(0xC004), 0x03);
+    Expect("IF after DI;HALT", mmu.ReadByte(0xFF0F) & 0x1F, 0x04);
+
+    std::printf("Interrupts: %d mismatches\n", mismatches);
+    return (mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "../include/CPU.h"
+#include "../include/Memory.h"
+
+#include <cstdio>
+
+// MBC3 clock registers: select, write, latch and read them, on a cart with external RAM (type 10h)
+// and one without (type 0Fh), and check they survive an OAM DMA locking the bus.
+#define SECOND 4194304
+
+static int mismatches = 0;
+
+static void Expect(const char* what, int ramSize, int value, int expected) {
+    if (value == expected) {
+        return;
+    }
+
+    std::printf("%s with %d bytes of RAM: %02X expected %02X\n", what, ramSize, value, expected);
+    ++mismatches;
+}
+
+// Read clock register reg (08-0C) through A000
+static int ReadRTC(Memory::MMU& mmu, Byte reg) {
+    mmu.WriteByte(0x4000, reg);
+    return mmu.ReadByte(0xA000);
+}
+
+static void Latch(Memory::MMU& mmu) {
+    mmu.WriteByte(0x6000, 0x00);
+    mmu.WriteByte(0x6000, 0x01);
+}
+
+static void Check(int ramSize) {
+    Processor::Z80 cpu;
+    Memory::MMU mmu;
+
+    mmu.SetCPU(&cpu);
+    cpu.SetMMU(&mmu);
+    mmu.AllocateROM(0x8000);
+    mmu.SetCatridgeType((ramSize != 0) ? 0x10 : 0x0F, ramSize);
+
+    // Disabled, nothing to read
+    mmu.WriteByte(0x4000, 0x08);
+    Expect("Disabled clock", ramSize, mmu.ReadByte(0xA000), 0xFF);
+
+    // Set 00:59:30, then let 45 seconds pass
+    mmu.WriteByte(0x0000, 0x0A);
+    mmu.WriteByte(0x4000, 0x08);
+    mmu.WriteByte(0xA000, 30);
+    mmu.WriteByte(0x4000, 0x09);
+    mmu.WriteByte(0xA000, 59);
+    Expect("Written seconds", ramSize, ReadRTC(mmu, 0x08), 30);
+    Expect("Written minutes", ramSize, ReadRTC(mmu, 0x09), 59);
+
+    cpu.Stall(45 * SECOND);
+    Expect("Seconds before latch", ramSize, ReadRTC(mmu, 0x08), 30);
+
+    Latch(mmu);
+    Expect("Latched seconds", ramSize, ReadRTC(mmu, 0x08), 15);
+    Expect("Latched minutes", ramSize, ReadRTC(mmu, 0x09), 0);
+    Expect("Latched hours", ramSize, ReadRTC(mmu, 0x0A), 1);
+
+    // RAM banks and clock registers share the window
+    if (ramSize != 0) {
+        mmu.WriteByte(0x4000, 0x00);
+        mmu.WriteByte(0xA000, 0x5A);
+        Expect("RAM after clock", ramSize, mmu.ReadByte(0xA000), 0x5A);
+        Expect("Clock after RAM", ramSize, ReadRTC(mmu, 0x08), 15);
+    }
+    else {
+        mmu.WriteByte(0x4000, 0x00);
+        Expect("Absent RAM", ramSize, mmu.ReadByte(0xA000), 0xFF);
+    }
+
+    // The bus is locked during OAM DMA, the clock is back once it ends
+    mmu.WriteByte(0x4000, 0x08);
+    mmu.StartDMA(0xC0);
+    Expect("Clock during DMA", ramSize, mmu.ReadByte(0xA000), 0xFF);
+    for (int i = 0; i < 160; ++i) {
+        mmu.StepDMA(cpu.GetTotalT());
+    }
+    Expect("Clock after DMA", ramSize, mmu.ReadByte(0xA000), 15);
+
+    // Disabling hides the clock again
+    mmu.WriteByte(0x0000, 0x00);
+    Expect("Clock after disable", ramSize, mmu.ReadByte(0xA000), 0xFF);
+}
+
+int main() {
+    Check(0);
+    Check(0x2000);
+
+    std::printf("MBC3 clock: %d mismatches\n", mismatches);
+    return (mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include "../include/PixelKernels.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Bit-exact check of the FEIGN_SIMD kernels against the scalar ones over every tile row, and every
+// DMG palette at every alignment in every pixel size.
+using namespace Video;
+
+static int mismatches = 0;
+
+static void Report(const char* message) {
+    if (mismatches < 16) {
+        std::printf("%s\n", message);
+    }
+    ++mismatches;
+}
+
+int main() {
+    char message[128];
+
+    // Every possible tile row, decoded in runs of odd and even length so both the paired and the
+    // leftover row paths are covered
+    static Byte data[0x20000];
+    static Byte simd[0x80000];
+    static Byte scalar[0x80000];
+
+    for (unsigned int row = 0; row < 0x10000; ++row) {
+        data[row * 2] = (Byte)row;
+        data[row * 2 + 1] = (Byte)(row >> 8);
+    }
+
+    for (unsigned int start = 0; start < 0x10000; start += 7) {
+        unsigned int rows = (start + 7 <= 0x10000) ? 7 : (0x10000 - start);
+
+        DecodeRows(&data[start * 2], &simd[start * 8], rows);
+        DecodeRowsScalar(&data[start * 2], &scalar[start * 8], rows);
+    }
+
+    for (unsigned int i = 0; i < 0x80000; ++i) {
+        if (simd[i] != scalar[i]) {
+            std::snprintf(message, sizeof(message), "Tile row decode mismatch for row %04X pixel %u: %d expected %d",
+                i / 8, i % 8, simd[i], scalar[i]);
+            Report(message);
+        }
+    }
+
+    // Every DMG palette over a line holding every index at every lane, from every fine scroll, in
+    // every pixel size
+    Byte indices[176];
+    Byte simdLine[160 * 4];
+    Byte scalarLine[160 * 4];
+
+    for (unsigned int i = 0; i < sizeof(indices); ++i) {
+        indices[i] = (Byte)((i * 7 + (i >> 4)) & 0x03);
+    }
+
+    for (unsigned int size = 1; size <= 4; size *= 2) {
+        for (unsigned int bgp = 0; bgp < 0x100; ++bgp) {
+            unsigned int colors[4];
+            for (unsigned int c = 0; c < 4; ++c) {
+                colors[c] = ((bgp >> (c * 2)) & 0x03) * 0x01010101u + (c << 8) + (c << 17);
+            }
+
+            for (unsigned int fine = 0; fine < 8; ++fine) {
+                ComposePixels(&indices[fine], colors, simdLine, 160 - fine, size);
+                ComposePixelsScalar(&indices[fine], colors, scalarLine, 160 - fine, size);
+
+                if (memcmp(simdLine, scalarLine, (160 - fine) * size) != 0) {
+                    std::snprintf(message, sizeof(message), "Scanline compose mismatch for palette %02X at fine scroll %u in %u byte pixels",
+                        bgp, fine, size);
+                    Report(message);
+                }
+            }
+        }
+    }
+
+    std::printf("Pixel kernels: %d mismatches\n", mismatches);
+    return (mismatches == 0) ? 0 : 1;
+}
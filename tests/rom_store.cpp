@@ -0,0 +1,99 @@
+#include "../include/GB.h"
+
+#include <cstdio>
+#include <vector>
+
+// Cartridge loading through the ROM store: the image is mapped, parsed and hashed, identical files
+// share one image and a bad global checksum is reported. Also loads and runs one through GBoy.
+static int mismatches = 0;
+
+static void Expect(const char* what, bool ok) {
+    if (ok) {
+        return;
+    }
+
+    std::printf("%s\n", what);
+    ++mismatches;
+}
+
+// 32KB ROM only cart spinning at 0150, with valid header and global checksums
+static std::vector<Byte> MakeROM(Byte fill) {
+    std::vector<Byte> rom(0x8000, fill);
+    static const Byte start[] = { 0x00, 0xC3, 0x50, 0x01 };
+    static const Byte spin[] = { 0x18, 0xFE };
+
+    memcpy(&rom[0x0100], start, sizeof(start));
+    memset(&rom[0x0134], 0, 0x014F - 0x0134 + 1);
+    memcpy(&rom[0x0134], "ROMSTORE", 8);
+    memcpy(&rom[0x0150], spin, sizeof(spin));
+
+    Byte csum = 0;
+    for (int i = 0x0134; i <= 0x014C; ++i) {
+        csum = csum - rom[i] - 1;
+    }
+    rom[0x014D] = csum;
+
+    Word gsum = 0;
+    for (size_t i = 0; i < rom.size(); ++i) {
+        gsum += rom[i];
+    }
+    rom[0x014E] = (Byte)(gsum >> 8);
+    rom[0x014F] = (Byte)gsum;
+
+    return rom;
+}
+
+static void Save(const char* fname, const std::vector<Byte>& rom) {
+    FILE* file = std::fopen(fname, "wb");
+    std::fwrite(rom.data(), 1, rom.size(), file);
+    std::fclose(file);
+}
+
+int main() {
+    std::vector<Byte> rom = MakeROM(0x00);
+    std::vector<Byte> other = MakeROM(0x11);
+
+    // Same contents as rom, but the global checksum is off
+    std::vector<Byte> bad = rom;
+    bad[0x4000] = 0x01;
+
+    Save("rom_store_a.gb", rom);
+    Save("rom_store_b.gb", rom);
+    Save("rom_store_c.gb", other);
+    Save("rom_store_d.gb", bad);
+
+    {
+        Cartridge a, b, c, d, missing;
+
+        Expect("First copy loads", a.LoadFromFile("rom_store_a.gb"));
+        Expect("Second copy loads", b.LoadFromFile("rom_store_b.gb"));
+        Expect("Other ROM loads", c.LoadFromFile("rom_store_c.gb"));
+        Expect("Bad global checksum still loads", d.LoadFromFile("rom_store_d.gb"));
+        Expect("Missing file fails", !missing.LoadFromFile("rom_store_missing.gb"));
+
+        Expect("Size", a.GetSize() == rom.size());
+        Expect("Contents", memcmp(a.GetBuffer(), rom.data(), rom.size()) == 0);
+        Expect("Title", a.GetTitle() == "ROMSTORE");
+        Expect("Identical files share an image", a.GetBuffer() == b.GetBuffer());
+        Expect("Different files don't", a.GetBuffer() != c.GetBuffer() && a.GetBuffer() != d.GetBuffer());
+        Expect("Good global checksum", a.HasValidGlobalChecksum() && c.HasValidGlobalChecksum());
+        Expect("Bad global checksum", !d.HasValidGlobalChecksum());
+    }
+
+    // The image is still held while an emulator runs it
+    {
+        GBoy gb;
+
+        gb.LoadROMImage("rom_store_a.gb");
+        RunResult result = gb.RunFrame();
+        Expect("Frame runs", result.frames == 1);
+    }
+
+    std::remove("rom_store_a.gb");
+    std::remove("rom_store_b.gb");
+    std::remove("rom_store_c.gb");
+    std::remove("rom_store_d.gb");
+
+    std::printf("ROM store: %d mismatches\n", mismatches);
+    return (mismatches == 0) ? 0 : 1;
+}